@@ -0,0 +1,198 @@
+/*
+ * CMatrixCache.cpp
+ *
+ *  Binary cache of a data matrix ready for the search: names, encoded
+ *  statesets with constant columns removed, site weights and the number
+ *  of columns originally read, kept with a checksum of the file they came
+ *  from so that later runs on the same file can skip reading it
+ */
+
+#include "CMatrixCache.h"
+#include "ReadFile.h"
+
+#ifndef WINDOWS_KEY_WORD
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/// first bytes of a cache; change the digit if the layout changes
+static const char sz_cache_magic[8] = "LVBMAT1";
+
+CMatrixCache::CMatrixCache() {
+
+	p_buf = NULL;
+	n_size = 0;
+}
+
+CMatrixCache::~CMatrixCache() {
+	unmap_file();
+}
+
+bool CMatrixCache::map_file(std::string sz_file_name){
+
+#ifdef WINDOWS_KEY_WORD
+	return false;
+#else
+	struct stat file_stat;
+	void *p_map;
+	int fd = open(sz_file_name.c_str(), O_RDONLY);
+	if (fd < 0) return false;
+	if (fstat(fd, &file_stat) != 0 || file_stat.st_size == 0){
+		close(fd);
+		return false;
+	}
+	p_map = mmap(NULL, (size_t) file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (p_map == MAP_FAILED) return false;
+	madvise(p_map, (size_t) file_stat.st_size, MADV_SEQUENTIAL);
+
+	p_buf = (const char *) p_map;
+	n_size = (size_t) file_stat.st_size;
+	return true;
+#endif
+}
+
+void CMatrixCache::unmap_file(){
+
+#ifndef WINDOWS_KEY_WORD
+	if (p_buf != NULL) munmap((void *) p_buf, n_size);
+#endif
+	p_buf = NULL;
+	n_size = 0;
+}
+
+/// a hash of the bytes from p_char up to p_last, a word at a time
+static unsigned long checksum_bytes(const char *p_char, const char *p_last)
+{
+	unsigned long n_checksum = (unsigned long) 0xcbf29ce484222325ULL, n_word;
+
+	for (; p_char + sizeof(n_word) <= p_last; p_char += sizeof(n_word)){
+		memcpy(&n_word, p_char, sizeof(n_word));
+		n_checksum = (n_checksum ^ n_word) * (unsigned long) 0x100000001b3ULL;
+		n_checksum ^= n_checksum >> 29;
+	}
+	for (; p_char < p_last; p_char++)
+		n_checksum = (n_checksum ^ (unsigned char) *p_char) * (unsigned long) 0x100000001b3ULL;
+	return n_checksum;
+}
+
+/// a hash of the whole file, and its size
+bool CMatrixCache::checksum_file(std::string sz_file_name, unsigned long &n_checksum, long &n_source_size){
+
+	if (!map_file(sz_file_name)) return false;
+	n_checksum = checksum_bytes(p_buf, p_buf + n_size);
+	n_source_size = (long) n_size;
+	unmap_file();
+	return true;
+}
+
+bool CMatrixCache::read_cache(std::string sz_cache_name, std::string sz_source_name, long n_options,
+		long n_max_length, struct data *p_lvbmat, long *p_counts, long *p_length_full){
+
+	struct cache_header header;
+	unsigned long n_checksum;
+	long n_source_size, n_names = 0;
+	size_t n_length_name;
+	const char *p_counts_in, *p_names_in, *p_rows_in;
+
+	if (!checksum_file(sz_source_name, n_checksum, n_source_size)) return false;
+	if (!map_file(sz_cache_name)) return false;
+
+	/// the header must match the source and options, and give the size of the file
+	if (n_size < sizeof(header)){
+		unmap_file();
+		return false;
+	}
+	memcpy(&header, p_buf, sizeof(header));
+	if (memcmp(header.sz_magic, sz_cache_magic, sizeof(header.sz_magic)) != 0 ||
+			header.n_sizeof_long != (long) sizeof(long) || header.n_checksum != n_checksum ||
+			header.n_source_size != n_source_size || header.n_options != n_options ||
+			header.n_seqs < 1 || header.n_length_seq < 1 || header.n_length_seq > n_max_length ||
+			header.n_name_bytes < header.n_seqs ||
+			(header.b_counts != 0 && header.b_counts != 1) ||
+			n_size != sizeof(header) + (size_t) (header.b_counts * header.n_length_seq) * sizeof(long) +
+			(size_t) header.n_name_bytes + (size_t) header.n_seqs * (size_t) header.n_length_seq ||
+			checksum_bytes(p_buf + sizeof(header), p_buf + n_size) != header.n_checksum_cache){
+		unmap_file();
+		return false;
+	}
+	p_counts_in = p_buf + sizeof(header);
+	p_names_in = p_counts_in + header.b_counts * header.n_length_seq * sizeof(long);
+	p_rows_in = p_names_in + header.n_name_bytes;
+	for (const char *p_char = p_names_in; p_char < p_rows_in; p_char++)
+		if (*p_char == '\0') n_names += 1;
+	if (n_names != header.n_seqs || p_rows_in[-1] != '\0'){
+		unmap_file();
+		return false;
+	}
+
+	p_lvbmat->n = header.n_seqs;
+	p_lvbmat->m = header.n_length_seq;
+	p_lvbmat->rowtitle = (char **) malloc((size_t) header.n_seqs * sizeof(char *));
+	p_lvbmat->row = (char **) malloc((size_t) header.n_seqs * sizeof(char *));
+	p_lvbmat->rowblock = (char *) malloc((size_t) header.n_seqs * (size_t) (header.n_length_seq + 1));
+	if (p_lvbmat->rowtitle == NULL || p_lvbmat->row == NULL || p_lvbmat->rowblock == NULL)
+		CReadFiles::exit_error(1, "Out of memory reading the matrix cache " + sz_cache_name);
+	for (long i = 0; i < header.n_seqs; i++){
+		n_length_name = strlen(p_names_in);
+		p_lvbmat->rowtitle[i] = (char *) malloc(n_length_name + 1);
+		p_lvbmat->row[i] = p_lvbmat->rowblock + (size_t) i * (size_t) (header.n_length_seq + 1);
+		if (p_lvbmat->rowtitle[i] == NULL)
+			CReadFiles::exit_error(1, "Out of memory reading the matrix cache " + sz_cache_name);
+		memcpy(p_lvbmat->rowtitle[i], p_names_in, n_length_name + 1);
+		memcpy(p_lvbmat->row[i], p_rows_in, (size_t) header.n_length_seq);
+		p_lvbmat->row[i][header.n_length_seq] = '\0';
+		p_names_in += n_length_name + 1;
+		p_rows_in += header.n_length_seq;
+	}
+	if (header.b_counts) memcpy(p_counts, p_counts_in, (size_t) header.n_length_seq * sizeof(long));
+	else for (long k = 0; k < header.n_length_seq; k++) p_counts[k] = 1;
+	*p_length_full = header.n_length_full;
+	unmap_file();
+	return true;
+}
+
+bool CMatrixCache::write_cache(std::string sz_cache_name, std::string sz_source_name, long n_options,
+		const struct data *p_lvbmat, const long *p_counts, long n_length_full){
+
+	struct cache_header header;
+	std::string sz_temp_name = sz_cache_name + ".tmp";
+	FILE *p_file;
+	bool b_ok;
+
+	memset(&header, 0, sizeof(header));
+	if (!checksum_file(sz_source_name, header.n_checksum, header.n_source_size)) return false;
+	memcpy(header.sz_magic, sz_cache_magic, sizeof(header.sz_magic));
+	header.n_sizeof_long = (long) sizeof(long);
+	header.n_options = n_options;
+	header.n_seqs = p_lvbmat->n;
+	header.n_length_seq = p_lvbmat->m;
+	header.n_length_full = n_length_full;
+	for (long i = 0; i < p_lvbmat->n; i++) header.n_name_bytes += (long) strlen(p_lvbmat->rowtitle[i]) + 1;
+	for (long k = 0; k < p_lvbmat->m; k++) if (p_counts[k] != 1) header.b_counts = 1;
+
+	p_file = fopen(sz_temp_name.c_str(), "wb");
+	if (p_file == NULL) return false;
+	b_ok = fwrite(&header, sizeof(header), 1, p_file) == 1;
+	if (b_ok && header.b_counts)
+		b_ok = fwrite(p_counts, sizeof(long), (size_t) p_lvbmat->m, p_file) == (size_t) p_lvbmat->m;
+	for (long i = 0; b_ok && i < p_lvbmat->n; i++)
+		b_ok = fwrite(p_lvbmat->rowtitle[i], strlen(p_lvbmat->rowtitle[i]) + 1, 1, p_file) == 1;
+	for (long i = 0; b_ok && i < p_lvbmat->n; i++)
+		b_ok = fwrite(p_lvbmat->row[i], (size_t) p_lvbmat->m, 1, p_file) == 1;
+	if (fclose(p_file) != 0) b_ok = false;
+
+	/// the checksum of what was written goes in the header
+	if (b_ok && (b_ok = map_file(sz_temp_name))){
+		header.n_checksum_cache = checksum_bytes(p_buf + sizeof(header), p_buf + n_size);
+		unmap_file();
+		p_file = fopen(sz_temp_name.c_str(), "r+b");
+		b_ok = p_file != NULL && fwrite(&header, sizeof(header), 1, p_file) == 1;
+		if (p_file != NULL && fclose(p_file) != 0) b_ok = false;
+	}
+	if (b_ok) b_ok = rename(sz_temp_name.c_str(), sz_cache_name.c_str()) == 0;
+	if (!b_ok) remove(sz_temp_name.c_str());
+	return b_ok;
+}
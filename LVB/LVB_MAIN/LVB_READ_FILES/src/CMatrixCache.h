@@ -0,0 +1,62 @@
+/*
+ * CMatrixCache.h
+ *
+ *  Binary cache of a data matrix ready for the search: names, encoded
+ *  statesets with constant columns removed, site weights and the number
+ *  of columns originally read, kept with a checksum of the file they came
+ *  from so that later runs on the same file can skip reading it
+ */
+
+#ifndef CMATRIXCACHE_H_
+#define CMATRIXCACHE_H_
+
+#include <string>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+struct data;
+
+class CMatrixCache {
+
+public:
+	CMatrixCache();
+	virtual ~CMatrixCache();
+
+	/// returns false, leaving p_lvbmat untouched, if there is no cache, or it
+	/// was made from another version of the source file or with other
+	/// options, or it is damaged; otherwise fills p_lvbmat, p_counts (m
+	/// elements) and *p_length_full; rows longer than n_max_length are refused
+	bool read_cache(std::string sz_cache_name, std::string sz_source_name, long n_options,
+			long n_max_length, struct data *p_lvbmat, long *p_counts, long *p_length_full);
+	/// returns false if the cache cannot be written; a partly written cache
+	/// never replaces an old one
+	bool write_cache(std::string sz_cache_name, std::string sz_source_name, long n_options,
+			const struct data *p_lvbmat, const long *p_counts, long n_length_full);
+
+private:
+	/// start of the file, followed by the site weights unless all are 1, the
+	/// names each ending in '\0', and the rows without terminators
+	struct cache_header {
+		char sz_magic[8];
+		long n_sizeof_long;			/// cache is only read where it was made
+		unsigned long n_checksum;	/// of the source file
+		unsigned long n_checksum_cache;	/// of the rest of the cache
+		long n_source_size;			/// bytes in the source file
+		long n_options;				/// that change the matrix
+		long n_seqs;
+		long n_length_seq;
+		long n_length_full;			/// columns before constant ones were removed
+		long b_counts;				/// site weights are stored
+		long n_name_bytes;
+	};
+
+	const char *p_buf;			/// mapped cache
+	size_t n_size;				/// bytes in p_buf
+
+	bool map_file(std::string sz_file_name);
+	void unmap_file();
+	bool checksum_file(std::string sz_file_name, unsigned long &n_checksum, long &n_source_size);
+};
+
+#endif /* CMATRIXCACHE_H_ */
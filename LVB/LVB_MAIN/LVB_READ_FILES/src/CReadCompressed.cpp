@@ -0,0 +1,227 @@
+/*
+ * CReadCompressed.cpp
+ *
+ *  Decompresses gzip (and, if built with LVB_ZSTD, zstd) files into memory
+ *  for CReadMapped, straight into a single growing buffer
+ */
+
+#include "CReadCompressed.h"
+
+#ifdef LVB_ZLIB
+#include <zlib.h>
+#endif
+#ifdef LVB_ZSTD
+#include <zstd.h>
+#endif
+
+/// least free space in the buffer for each read from the decompressor
+static const size_t n_block_size = 1 << 20;
+
+/// the buffer starts at this many times the size of the compressed file,
+/// if the file does not give the size of its contents
+static const size_t n_ratio_guess = 4;
+
+/// most bytes in the header of a zstd frame
+static const size_t n_zstd_header_max = 18;
+
+CReadCompressed::CReadCompressed() {
+
+	p_buf = NULL;
+	n_size = 0;
+	n_capacity = 0;
+}
+
+CReadCompressed::~CReadCompressed() {
+
+	free(p_buf);
+}
+
+int CReadCompressed::get_compression(std::string sz_file_name){
+
+	unsigned char lst_magic[4];
+	size_t n_read;
+	FILE *p_file = fopen(sz_file_name.c_str(), "rb");
+
+	if (p_file == NULL) return COMPRESSION_NONE;
+	n_read = fread(lst_magic, 1, sizeof(lst_magic), p_file);
+	fclose(p_file);
+	if (n_read >= 2 && lst_magic[0] == 0x1f && lst_magic[1] == 0x8b) return COMPRESSION_GZIP;
+	if (n_read == 4 && lst_magic[0] == 0x28 && lst_magic[1] == 0xb5 && lst_magic[2] == 0x2f &&
+			lst_magic[3] == 0xfd) return COMPRESSION_ZSTD;
+	return COMPRESSION_NONE;
+}
+
+std::string CReadCompressed::strip_suffix(std::string sz_file_name){
+
+	static const char *lst_suffixes[] = { ".gz", ".zst" };
+
+	for (int i = 0; i < 2; i++){
+		size_t n_length = strlen(lst_suffixes[i]);
+		if (sz_file_name.size() > n_length &&
+				sz_file_name.compare(sz_file_name.size() - n_length, n_length, lst_suffixes[i]) == 0)
+			return sz_file_name.substr(0, sz_file_name.size() - n_length);
+	}
+	return sz_file_name;
+}
+
+bool CReadCompressed::reserve(size_t n_bytes){
+
+	size_t n_new_capacity = n_capacity;
+	char *p_temp;
+
+	if (n_capacity - n_size >= n_bytes) return true;
+	while (n_new_capacity - n_size < n_bytes) n_new_capacity += n_new_capacity / 2;
+	if ((p_temp = (char *) realloc(p_buf, n_new_capacity)) == NULL) return false;
+	p_buf = p_temp;
+	n_capacity = n_new_capacity;
+	return true;
+}
+
+size_t CReadCompressed::size_hint(std::string sz_file_name, int n_compression, long n_file_size){
+
+	unsigned char lst_bytes[n_zstd_header_max];
+	size_t n_hint = 0;
+	FILE *p_file = fopen(sz_file_name.c_str(), "rb");
+
+	if (p_file == NULL) return 0;
+	if (n_compression == COMPRESSION_GZIP){
+		/// ISIZE, the last four bytes, is the size of the last member modulo 2^32
+		if (n_file_size >= 4 && fseek(p_file, n_file_size - 4, SEEK_SET) == 0 &&
+				fread(lst_bytes, 1, 4, p_file) == 4){
+			n_hint = (size_t) lst_bytes[0] | (size_t) lst_bytes[1] << 8 |
+					(size_t) lst_bytes[2] << 16 | (size_t) lst_bytes[3] << 24;
+			/// smaller than the file, it has wrapped or is too small to matter
+			if (n_hint < (size_t) n_file_size) n_hint = 0;
+		}
+	}
+	else if (n_compression == COMPRESSION_ZSTD){
+#ifdef LVB_ZSTD
+		unsigned long long n_content;
+		size_t n_read = fread(lst_bytes, 1, sizeof(lst_bytes), p_file);
+		/// only the first frame is counted, and the size may be left out
+		n_content = ZSTD_getFrameContentSize(lst_bytes, n_read);
+		if (n_content != ZSTD_CONTENTSIZE_UNKNOWN && n_content != ZSTD_CONTENTSIZE_ERROR &&
+				n_content < (size_t) -1 - n_block_size)
+			n_hint = (size_t) n_content;
+#endif
+	}
+	fclose(p_file);
+	return n_hint;
+}
+
+bool CReadCompressed::decompress_gzip(std::string sz_file_name){
+
+#ifdef LVB_ZLIB
+	int n_read;
+	gzFile p_gz = gzopen(sz_file_name.c_str(), "rb");
+
+	if (p_gz == NULL) return false;
+	gzbuffer(p_gz, (unsigned) n_block_size);
+	while (true){
+		if (!reserve(n_block_size)){
+			gzclose(p_gz);
+			return false;
+		}
+		n_read = gzread(p_gz, p_buf + n_size, (unsigned) n_block_size);
+		if (n_read <= 0) break;
+		n_size += (size_t) n_read;
+	}
+	/// reports a read error, or a stream cut short
+	return gzclose(p_gz) == Z_OK && n_read == 0;
+#else
+	return false;
+#endif
+}
+
+bool CReadCompressed::decompress_zstd(std::string sz_file_name){
+
+#ifdef LVB_ZSTD
+	FILE *p_file = fopen(sz_file_name.c_str(), "rb");
+	ZSTD_DStream *p_stream;
+	size_t n_in_size, n_read, n_ret = 0;
+	char *p_in;
+	bool b_ok = true;
+
+	if (p_file == NULL) return false;
+	p_stream = ZSTD_createDStream();
+	n_in_size = ZSTD_DStreamInSize();
+	p_in = (char *) malloc(n_in_size);
+	if (p_stream == NULL || p_in == NULL || ZSTD_isError(ZSTD_initDStream(p_stream))){
+		if (p_stream != NULL) ZSTD_freeDStream(p_stream);
+		free(p_in);
+		fclose(p_file);
+		return false;
+	}
+
+	while (b_ok && (n_read = fread(p_in, 1, n_in_size, p_file)) > 0){
+		ZSTD_inBuffer in_buf = { p_in, n_read, 0 };
+		bool b_full;
+		/// a full output buffer may hold back more, so call again after it
+		do {
+			if (!reserve(n_block_size)){
+				b_ok = false;
+				break;
+			}
+			ZSTD_outBuffer out_buf = { p_buf + n_size, n_capacity - n_size, 0 };
+			n_ret = ZSTD_decompressStream(p_stream, &out_buf, &in_buf);
+			if (ZSTD_isError(n_ret)) b_ok = false;
+			else n_size += out_buf.pos;
+			b_full = out_buf.pos == out_buf.size;
+		} while (b_ok && (in_buf.pos < in_buf.size || b_full));
+	}
+
+	/// n_ret is 0 only at the end of a frame
+	if (ferror(p_file) || n_ret != 0) b_ok = false;
+	ZSTD_freeDStream(p_stream);
+	free(p_in);
+	fclose(p_file);
+	return b_ok;
+#else
+	return false;
+#endif
+}
+
+bool CReadCompressed::read_file(std::string sz_file_name, char **pp_buf, size_t *p_size){
+
+	int n_compression = get_compression(sz_file_name);
+	long n_file_size = 0;
+	bool b_ok = false;
+	char *p_temp;
+	FILE *p_file;
+
+	if (n_compression == COMPRESSION_NONE) return false;
+	if ((p_file = fopen(sz_file_name.c_str(), "rb")) != NULL){
+		if (fseek(p_file, 0, SEEK_END) == 0) n_file_size = ftell(p_file);
+		fclose(p_file);
+	}
+	free(p_buf);
+	n_size = 0;
+
+	/// the size the file gives is only a hint, so if there is no room for it
+	/// the buffer starts at the guess instead; the last read needs a block
+	/// more, for the decompressor to find the end
+	n_capacity = size_hint(sz_file_name, n_compression, n_file_size);
+	if (n_capacity > 0) n_capacity += n_block_size;
+	if (n_capacity == 0 || (p_buf = (char *) malloc(n_capacity)) == NULL){
+		n_capacity = n_block_size;
+		if (n_file_size > 0 && (size_t) n_file_size * n_ratio_guess > n_capacity)
+			n_capacity = (size_t) n_file_size * n_ratio_guess;
+		if ((p_buf = (char *) malloc(n_capacity)) == NULL){
+			n_capacity = 0;
+			return false;
+		}
+	}
+
+	if (n_compression == COMPRESSION_GZIP) b_ok = decompress_gzip(sz_file_name);
+	else if (n_compression == COMPRESSION_ZSTD) b_ok = decompress_zstd(sz_file_name);
+	if (!b_ok || n_size == 0) return false;
+
+	/// the caller takes the buffer
+	if ((p_temp = (char *) realloc(p_buf, n_size)) != NULL) p_buf = p_temp;
+	*pp_buf = p_buf;
+	*p_size = n_size;
+	p_buf = NULL;
+	n_size = 0;
+	n_capacity = 0;
+	return true;
+}
@@ -0,0 +1,51 @@
+/*
+ * CReadCompressed.h
+ *
+ *  Decompresses gzip (and, if built with LVB_ZSTD, zstd) files into memory
+ *  for CReadMapped, straight into a single growing buffer
+ */
+
+#ifndef CREADCOMPRESSED_H_
+#define CREADCOMPRESSED_H_
+
+#include <string>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+class CReadCompressed {
+
+public:
+	CReadCompressed();
+	virtual ~CReadCompressed();
+
+	/// kinds of file, told by their first bytes
+	static const int COMPRESSION_NONE = 0;
+	static const int COMPRESSION_GZIP = 1;
+	static const int COMPRESSION_ZSTD = 2;
+
+	static int get_compression(std::string sz_file_name);
+	/// the name without a ".gz" or ".zst" suffix
+	static std::string strip_suffix(std::string sz_file_name);
+
+	/// decompresses the file into a new buffer, which *pp_buf is set to and
+	/// the caller must free(), with *p_size bytes; returns false if the file
+	/// cannot be read, is corrupt or empty, or its compression is not
+	/// supported by this build
+	bool read_file(std::string sz_file_name, char **pp_buf, size_t *p_size);
+
+private:
+	char *p_buf;					/// decompressed data so far
+	size_t n_size;					/// bytes used in p_buf
+	size_t n_capacity;				/// bytes allocated for p_buf
+
+	/// makes room for n_bytes more in p_buf, growing it by half at a time;
+	/// returns false if out of memory
+	bool reserve(size_t n_bytes);
+	/// the size of the contents the file gives, or 0 if it gives none
+	size_t size_hint(std::string sz_file_name, int n_compression, long n_file_size);
+	bool decompress_gzip(std::string sz_file_name);
+	bool decompress_zstd(std::string sz_file_name);
+};
+
+#endif /* CREADCOMPRESSED_H_ */
@@ -20,7 +20,7 @@ CReadFiles::CReadFiles() {
 	/// src/phylip.h:#define nmlngth         10   /* number of characters in species name    */
 	/// src/phylip.h:#define MAXNCH          20   /* must be greater than or equal to nmlngth */
 	n_nmlngth_phylip_names = 10;
-	sz_phylip_accept_chars = "ABCDEFGHIKLMNPQRSTVWXYZ*?-";
+	sz_phylip_accept_chars = "ABCDEFGHIKLMNPQRSTVWXYZabcdefghiklmnpqrstvwxyz*?-";
 
 	b_debug = false;		/// print some messages
 }
@@ -183,6 +183,14 @@ std::string CReadFiles::get_string_from_list(std::vector< std::string > lst_stri
 /// need to remove numbers from the sequences...
 void CReadFiles::read_phylip()
 {
+	/// the file is read once; the layout is found from these lines
+	std::vector< std::string > lst_lines;
+	std::string sz_line = "", error;
+	ifstream filein;
+	filein.open(sz_file_name.c_str());
+	while (std::getline(filein, sz_line)) lst_lines.push_back(trim(sz_line));
+	filein.close();
+
 /// interleaved example, examples from the phylip web site
 //	  5    42
 //	Turkey    AAGCTNGGGC ATTTCAGGGT
@@ -196,7 +204,6 @@ void CReadFiles::read_phylip()
 //	ACAGGTTGGC CGTTCAGGGT AA
 //	AAACCGAGGC CGGGACACTC AT
 //	AAACCATTGC CGGTACGCTT AA
-	bool b_is_interlevead = is_phylip_interleaved();
 
 /// interleaved sequential example, examples from the phylip web site
 //	5    42
@@ -211,18 +218,16 @@ void CReadFiles::read_phylip()
 //	Gorilla   AAACCCTTGC CGGTACGCTT
 //	AAACCATTGC CGGTACGCTT AA
 	int n_total_lines;
-	bool b_is_line_sequencial = is_phylip_line_sequential(n_total_lines);
+	bool b_is_interlevead, b_is_line_sequencial;
+	get_phylip_layout(lst_lines, b_is_interlevead, b_is_line_sequencial, n_total_lines);
 
 	//// get the number of sequences and length of sequences...
 	int n_seqs = 0, n_length_seq = 0, n_count_line = 0, length;
-	std::string sz_line = "", error;
 	bool b_is_start_read = false;
 
-	ifstream filein;
-	filein.open(sz_file_name.c_str());
-	while (std::getline(filein, sz_line)) {
+	for (std::vector< std::string >::iterator it = lst_lines.begin(); it != lst_lines.end(); ++it) {
 
-		sz_line = trim(sz_line);
+		sz_line = *it;
 		if (sz_line.empty()) continue;
 
 		/// try to get the number of sequences and its length
@@ -288,7 +293,6 @@ void CReadFiles::read_phylip()
 	if (n_seqs == 0){
 		error = "Some problem reading the file. Please, check the file format.\nMore information in http://evolution.genetics.washington.edu/phylip/doc/sequence.html";
 		exit_error(1 , error);
-		filein.close();
 		return;
 	}
 	if ((int) lst_names_seq.size() != (int) lst_sequences.size()){
@@ -308,7 +312,6 @@ void CReadFiles::read_phylip()
 			exit_error(1 , error);
 		}
 	}
-	filein.close();
 }
 
 
@@ -321,17 +324,21 @@ std::string CReadFiles::clean_phylip_dna_sequence(std::string sz_sequence){
 }
 
 
-bool CReadFiles::is_phylip_interleaved(){
+/// one scan of the trimmed lines for both layouts; interleaved if a line with
+/// data follows an empty line after the data starts; otherwise line sequential
+/// if the n_total_lines lines of data are a multiple, above one, of the number
+/// of sequences
+void CReadFiles::get_phylip_layout(const std::vector< std::string > &lst_lines, bool &b_interleaved,
+		bool &b_line_sequential, int &n_total_lines){
 
-	std::string sz_line;
 	int n_seqs = 0, n_length_seq = 0;
 	bool b_is_start_read = false, b_empty_line = false;
-	int n_total_lines = 0;
-	ifstream filein;
-	filein.open(sz_file_name.c_str());
-	while (std::getline(filein, sz_line)) {
+	b_interleaved = false;
+	b_line_sequential = false;
+	n_total_lines = 0;
+	for (std::vector< std::string >::const_iterator it = lst_lines.begin(); it != lst_lines.end(); ++it) {
 
-		sz_line = trim(sz_line);
+		const std::string &sz_line = *it;
 		if (sz_line.empty() && !b_is_start_read) continue;
 
 		if (n_seqs == 0 && n_length_seq == 0){
@@ -346,64 +353,21 @@ bool CReadFiles::is_phylip_interleaved(){
 			if (sz_phylip_accept_chars.find(sz_line[sz_line.length() - 1]) != string::npos){
 				b_is_start_read = true;
 				n_total_lines += 1;
-				continue;
 			}
-			else continue;
-		}
-		if (b_is_start_read && sz_line.empty()){
-			b_empty_line = true;
 			continue;
 		}
-		else if (b_is_start_read && !b_empty_line){
-			n_total_lines += 1;
-		}
-		else if (b_is_start_read && b_empty_line){
-			return true;
+		if (sz_line.empty()) b_empty_line = true;
+		else if (b_empty_line){
+			b_interleaved = true;
+			return;
 		}
+		else n_total_lines += 1;
 	}
-	return false;
-}
-
-
-bool CReadFiles::is_phylip_line_sequential(int &n_total_lines){
 
-	std::string sz_line;
-	int n_seqs = 0, n_length_seq = 0;
-	bool b_is_start_read = false;
-	n_total_lines = 0;
-	ifstream filein;
-	filein.open(sz_file_name.c_str());
-	while (std::getline(filein, sz_line)) {
-
-		sz_line = trim(sz_line);
-		if (sz_line.empty() && !b_is_start_read) continue;
-
-		if (n_seqs == 0 && n_length_seq == 0){
-			int scan_value = std::sscanf( sz_line.c_str(), "%d%d", &n_seqs, &n_length_seq);
-			if (scan_value != 2){
-				n_seqs = 0;
-				n_length_seq = 0;
-			}
-			continue;
-		}
-		if (!b_is_start_read){
-			if (sz_phylip_accept_chars.find(sz_line[sz_line.length() - 1]) != string::npos){
-				b_is_start_read = true;
-				n_total_lines += 1;
-				continue;
-			}
-			else continue;
-		}
-		if (b_is_start_read && !sz_line.empty()) n_total_lines += 1;
-		if (sz_line.empty() && n_total_lines == n_seqs) return false;
-	}
-
-	if ((n_total_lines % n_seqs) == 0 && n_total_lines > n_seqs) return true;
-	return false;
+	if (n_seqs > 0 && (n_total_lines % n_seqs) == 0 && n_total_lines > n_seqs) b_line_sequential = true;
 }
 
 
-
 void CReadFiles::read_fasta()
 {
 	std::string sz_line = "";
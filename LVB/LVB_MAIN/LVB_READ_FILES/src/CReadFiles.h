@@ -77,8 +77,8 @@ private:
 	std::vector<std::string> &split(const std::string &s, char delim, std::vector<std::string> &elems);
 
 	/// methods used in phylip files
-	bool is_phylip_interleaved();
-	bool is_phylip_line_sequential(int &n_total_lines);
+	void get_phylip_layout(const std::vector< std::string > &lst_lines, bool &b_interleaved,
+			bool &b_line_sequential, int &n_total_lines);
 	std::string clean_phylip_dna_sequence(std::string sz_sequence);
 
 	/// used for phylip files, is the max length of the namess
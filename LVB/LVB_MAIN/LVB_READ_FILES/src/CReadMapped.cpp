@@ -0,0 +1,520 @@
+/*
+ * CReadMapped.cpp
+ *
+ *  Reads FASTA and PHYLIP files straight from a memory map into the rows
+ *  of the LVB data matrix, without intermediate strings, optionally
+ *  encoding each residue by a lookup table as it goes; large files are
+ *  split at line boundaries and parsed by several threads
+ */
+
+#include "CReadMapped.h"
+#include "CReadCompressed.h"
+#include "ReadFile.h"
+
+#ifndef WINDOWS_KEY_WORD
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/// as in CReadFiles
+static const char sz_phylip_accept_chars[] = "ABCDEFGHIKLMNPQRSTVWXYZabcdefghiklmnpqrstvwxyz*?-";
+static const long n_nmlngth_phylip_names = 10;
+
+/// bytes in each chunk of a file parsed in parallel; smaller files are read
+/// by the calling thread alone
+static const size_t n_chunk_size = 1 << 20;
+
+/// trim the chars of CReadFiles::trim() from both ends, in the same order
+static void trim_range(const char *&p_begin, const char *&p_end)
+{
+	static const char trim_chars[] = "\n\r\n ";
+	for (int i = 0; i < 4; i++){
+		while (p_begin < p_end && *p_begin == trim_chars[i]) p_begin++;
+		while (p_end > p_begin && p_end[-1] == trim_chars[i]) p_end--;
+	}
+}
+
+CReadMapped::CReadMapped() {
+
+	p_buf = NULL;
+	n_size = 0;
+	b_inflated = false;
+	p_next = NULL;
+	lst_rows = NULL;
+	lst_names = NULL;
+	lst_length = NULL;
+	n_rows = 0;
+	n_rows_max = 0;
+	n_length_seq = -1;
+	p_lut = NULL;
+	lst_varies = NULL;
+}
+
+CReadMapped::~CReadMapped() {
+	free_rows();
+	unmap_file();
+}
+
+bool CReadMapped::map_file(std::string sz_file_name){
+
+	/// a compressed file is read into memory whole
+	if (CReadCompressed::get_compression(sz_file_name) != CReadCompressed::COMPRESSION_NONE){
+		CReadCompressed readCompressed;
+		char *p_inflated;
+		if (!readCompressed.read_file(sz_file_name, &p_inflated, &n_size)) return false;
+		p_buf = p_inflated;
+		p_next = p_buf;
+		b_inflated = true;
+		return true;
+	}
+
+#ifdef WINDOWS_KEY_WORD
+	return false;
+#else
+	struct stat file_stat;
+	void *p_map;
+	int fd = open(sz_file_name.c_str(), O_RDONLY);
+	if (fd < 0) return false;
+	if (fstat(fd, &file_stat) != 0 || file_stat.st_size == 0){
+		close(fd);
+		return false;
+	}
+	p_map = mmap(NULL, (size_t) file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (p_map == MAP_FAILED) return false;
+	madvise(p_map, (size_t) file_stat.st_size, MADV_SEQUENTIAL);
+
+	p_buf = (const char *) p_map;
+	n_size = (size_t) file_stat.st_size;
+	p_next = p_buf;
+	return true;
+#endif
+}
+
+void CReadMapped::unmap_file(){
+
+	if (b_inflated) free((void *) p_buf);
+#ifndef WINDOWS_KEY_WORD
+	else if (p_buf != NULL) munmap((void *) p_buf, n_size);
+#endif
+	b_inflated = false;
+	p_buf = NULL;
+	n_size = 0;
+	p_next = NULL;
+}
+
+/// the next line from p_next, not going past p_last, trimmed; false at the end
+static bool next_line_in(const char *&p_next, const char *p_last, const char *&p_begin, const char *&p_end)
+{
+	if (p_next == NULL || p_next >= p_last) return false;
+
+	p_begin = p_next;
+	p_end = (const char *) memchr(p_begin, '\n', (size_t) (p_last - p_begin));
+	if (p_end == NULL){
+		p_end = p_last;
+		p_next = p_last;
+	}
+	else p_next = p_end + 1;
+	trim_range(p_begin, p_end);
+	return true;
+}
+
+/// residues in a piece of a PHYLIP line, leaving out numbers and spaces
+static long count_phylip_residues(const char *p_begin, const char *p_end)
+{
+	long n_count = 0;
+	for (; p_begin < p_end; p_begin++)
+		if (*p_begin != ' ' && (*p_begin < '0' || *p_begin > '9')) n_count += 1;
+	return n_count;
+}
+
+/// the next line, trimmed; false at the end of the file
+bool CReadMapped::next_line(const char *&p_begin, const char *&p_end){
+	return next_line_in(p_next, p_buf + n_size, p_begin, p_end);
+}
+
+/// split the file from p_start into chunks of about n_chunk_size bytes, each
+/// beginning at the start of a line; chunk i runs from lst_chunks[i] up to
+/// lst_chunks[i + 1]
+void CReadMapped::split_chunks(const char *p_start, std::vector<const char *> &lst_chunks){
+
+	const char *p_last = p_buf + n_size, *p_split;
+
+	lst_chunks.clear();
+	lst_chunks.push_back(p_start);
+	while ((size_t) (p_last - lst_chunks.back()) > n_chunk_size){
+		p_split = lst_chunks.back() + n_chunk_size;
+		p_split = (const char *) memchr(p_split, '\n', (size_t) (p_last - p_split));
+		if (p_split == NULL || p_split + 1 == p_last) break;
+		lst_chunks.push_back(p_split + 1);
+	}
+	lst_chunks.push_back(p_last);
+}
+
+/// residues per row; with a table, also the record of varying columns
+bool CReadMapped::set_length(long n_length){
+
+	n_length_seq = n_length;
+	if (p_lut != NULL){
+		lst_varies = (char *) calloc((size_t) n_length, 1);
+		if (lst_varies == NULL) return false;
+	}
+	return true;
+}
+
+/// new row with the given name, with room for n_length_seq residues
+bool CReadMapped::add_row(const char *p_name_begin, const char *p_name_end){
+
+	if (n_rows == n_rows_max){
+		long n_new_max = (n_rows_max == 0) ? 64 : 2 * n_rows_max;
+		char **lst_temp = (char **) realloc(lst_rows, (size_t) n_new_max * sizeof(char *));
+		if (lst_temp == NULL) return false;
+		lst_rows = lst_temp;
+		lst_temp = (char **) realloc(lst_names, (size_t) n_new_max * sizeof(char *));
+		if (lst_temp == NULL) return false;
+		lst_names = lst_temp;
+		long *lst_temp_length = (long *) realloc(lst_length, (size_t) n_new_max * sizeof(long));
+		if (lst_temp_length == NULL) return false;
+		lst_length = lst_temp_length;
+		n_rows_max = n_new_max;
+	}
+
+	size_t n_length_name = (size_t) (p_name_end - p_name_begin);
+	lst_names[n_rows] = (char *) malloc(n_length_name + 1);
+	lst_rows[n_rows] = (char *) malloc((size_t) n_length_seq + 1);
+	if (lst_names[n_rows] == NULL || lst_rows[n_rows] == NULL){
+		free(lst_names[n_rows]);
+		free(lst_rows[n_rows]);
+		return false;
+	}
+	memcpy(lst_names[n_rows], p_name_begin, n_length_name);
+	lst_names[n_rows][n_length_name] = '\0';
+	lst_length[n_rows] = 0;
+	n_rows += 1;
+	return true;
+}
+
+void CReadMapped::free_rows(){
+
+	for (long i = 0; i < n_rows; i++){
+		free(lst_rows[i]);
+		free(lst_names[i]);
+	}
+	free(lst_rows);
+	free(lst_names);
+	free(lst_length);
+	free(lst_varies);
+	lst_rows = NULL;
+	lst_names = NULL;
+	lst_length = NULL;
+	lst_varies = NULL;
+	n_rows = 0;
+	n_rows_max = 0;
+	n_length_seq = -1;
+}
+
+/// put the residues in a line into a row from n_offset on; for PHYLIP, leaving
+/// out numbers and spaces as CReadFiles::clean_phylip_dna_sequence() does; with
+/// a table, each is stored encoded and, if p_varies is not NULL, compared with
+/// the first row in the same pass; returns the new offset, or -1 if the row
+/// would overflow or a residue has no code
+long CReadMapped::put_residues(char *p_row, long n_offset, const char *p_begin, const char *p_end,
+		bool b_is_phylip, char *p_varies){
+
+	unsigned char c_set;
+
+	if (!b_is_phylip && p_lut == NULL){
+		if (p_end - p_begin > n_length_seq - n_offset) return -1;
+		memcpy(p_row + n_offset, p_begin, (size_t) (p_end - p_begin));
+		return n_offset + (long) (p_end - p_begin);
+	}
+
+	for (; p_begin < p_end; p_begin++){
+		if (b_is_phylip && (*p_begin == ' ' || (*p_begin >= '0' && *p_begin <= '9'))) continue;
+		if (n_offset == n_length_seq) return -1;
+		if (p_lut == NULL) p_row[n_offset++] = *p_begin;
+		else{
+			c_set = p_lut[(unsigned char) *p_begin];
+			if (c_set == 0) return -1;
+			if (p_varies != NULL && (char) c_set != lst_rows[0][n_offset]) p_varies[n_offset] = 1;
+			p_row[n_offset++] = (char) c_set;
+		}
+	}
+	return n_offset;
+}
+
+/// add one thread's record of varying columns to lst_varies
+void CReadMapped::merge_varies(const char *p_varies){
+
+	#pragma omp critical (lvb_read_mapped)
+	for (long i = 0; i < n_length_seq; i++) lst_varies[i] |= p_varies[i];
+}
+
+/// the '>' that begin lines, once trimmed, from p_from up to p_to
+void CReadMapped::find_fasta_headers(const char *p_from, const char *p_to, std::vector<const char *> &lst_headers){
+
+	const char *p_last = p_buf + n_size, *p_char = p_from, *p_begin, *p_end;
+
+	while (p_char < p_to && (p_char = (const char *) memchr(p_char, '>', (size_t) (p_to - p_char))) != NULL){
+		p_begin = p_char;
+		while (p_begin > p_buf && p_begin[-1] != '\n') p_begin--;
+		p_end = (const char *) memchr(p_char, '\n', (size_t) (p_last - p_char));
+		if (p_end == NULL) p_end = p_last;
+		trim_range(p_begin, p_end);
+		if (p_begin == p_char) lst_headers.push_back(p_char);
+		p_char += 1;
+	}
+}
+
+/// the residues of a record, from the line after its header up to p_to
+bool CReadMapped::read_fasta_record(long n_row, const char *p_from, const char *p_to, char *p_varies){
+
+	const char *p_begin, *p_end;
+	long n_offset = 0;
+
+	while (next_line_in(p_from, p_to, p_begin, p_end)){
+		if (p_begin == p_end) continue;
+		n_offset = put_residues(lst_rows[n_row], n_offset, p_begin, p_end, false, p_varies);
+		if (n_offset < 0) return false;
+	}
+	lst_length[n_row] = n_offset;
+	return n_offset == n_length_seq;
+}
+
+/// as CReadFiles::read_fasta(); the headers are found first, chunk by chunk,
+/// then the records, which all take the length of the first, are read in
+/// parallel into rows allocated beforehand
+bool CReadMapped::read_fasta(){
+
+	const char *p_last = p_buf + n_size, *p_begin, *p_end, *p_char;
+	std::vector<const char *> lst_chunks, lst_headers, lst_data;
+	std::vector< std::vector<const char *> > lst_found;
+	long n_chunks, n_records, n_length = 0, n_failed = 0;
+
+	split_chunks(p_buf, lst_chunks);
+	n_chunks = (long) lst_chunks.size() - 1;
+	lst_found.resize(n_chunks);
+	#pragma omp parallel for schedule(dynamic) if (n_chunks > 1)
+	for (long i = 0; i < n_chunks; i++) find_fasta_headers(lst_chunks[i], lst_chunks[i + 1], lst_found[i]);
+	for (long i = 0; i < n_chunks; i++) lst_headers.insert(lst_headers.end(), lst_found[i].begin(), lst_found[i].end());
+	n_records = (long) lst_headers.size();
+	if (n_records == 0) return false;
+	lst_headers.push_back(p_last);
+
+	/// nothing but empty lines before the first
+	while (next_line(p_begin, p_end) && p_begin != lst_headers[0])
+		if (p_begin != p_end) return false;
+
+	p_next = lst_headers[0];
+	next_line(p_begin, p_end);
+	for (p_char = p_next; next_line_in(p_char, lst_headers[1], p_begin, p_end); )
+		n_length += (long) (p_end - p_begin);
+	if (n_length == 0 || !set_length(n_length)) return false;
+
+	for (long i = 0; i < n_records; i++){
+		p_next = lst_headers[i];
+		next_line(p_begin, p_end);
+		if (!add_row(p_begin + 1, p_end)) return false;
+		lst_data.push_back(p_next);
+	}
+
+	/// the first row, then the others, each thread noting the columns where
+	/// they differ from it
+	if (!read_fasta_record(0, lst_data[0], lst_headers[1], NULL)) return false;
+	#pragma omp parallel if (n_chunks > 1) reduction(+:n_failed)
+	{
+		char *p_varies = NULL;
+		if (p_lut != NULL && (p_varies = (char *) calloc((size_t) n_length_seq, 1)) == NULL) n_failed += 1;
+		#pragma omp for schedule(dynamic, 16)
+		for (long i = 1; i < n_records; i++)
+			if (n_failed == 0 && !read_fasta_record(i, lst_data[i], lst_headers[i + 1], p_varies)) n_failed += 1;
+		if (p_varies != NULL){
+			merge_varies(p_varies);
+			free(p_varies);
+		}
+	}
+	return n_failed == 0;
+}
+
+/// the lines from p_from up to p_to, with their residues counted
+void CReadMapped::scan_phylip_lines(const char *p_from, const char *p_to, std::vector<line_info> &lst_lines){
+
+	line_info line;
+	const char *p_name_end;
+
+	line.n_row = -1;
+	line.n_offset = 0;
+	while (next_line_in(p_from, p_to, line.p_begin, line.p_end)){
+		p_name_end = line.p_begin + n_nmlngth_phylip_names;
+		if (p_name_end > line.p_end) p_name_end = line.p_end;
+		line.n_residues_name = count_phylip_residues(line.p_begin, p_name_end);
+		line.n_residues = line.n_residues_name + count_phylip_residues(p_name_end, line.p_end);
+		lst_lines.push_back(line);
+	}
+}
+
+/// put the residues of each line in place, those of the first row before the
+/// others so that they can be compared with it
+bool CReadMapped::fill_phylip_rows(const std::vector<line_info> &lst_lines){
+
+	long n_lines = (long) lst_lines.size(), n_failed = 0;
+
+	for (int n_pass = 0; n_pass < 2; n_pass++){
+		#pragma omp parallel if (n_size > n_chunk_size) reduction(+:n_failed)
+		{
+			char *p_varies = NULL;
+			if (n_pass == 1 && p_lut != NULL && (p_varies = (char *) calloc((size_t) n_length_seq, 1)) == NULL) n_failed += 1;
+			#pragma omp for schedule(dynamic, 64)
+			for (long i = 0; i < n_lines; i++){
+				const line_info &line = lst_lines[i];
+				if (n_failed > 0 || line.n_row < 0 || (line.n_row == 0) != (n_pass == 0)) continue;
+				if (put_residues(lst_rows[line.n_row], line.n_offset, line.p_begin, line.p_end, true, p_varies) < 0) n_failed += 1;
+			}
+			if (p_varies != NULL){
+				merge_varies(p_varies);
+				free(p_varies);
+			}
+		}
+		if (n_failed > 0) return false;
+	}
+	return true;
+}
+
+/// as CReadFiles::read_phylip(); the lines are split and counted in parallel,
+/// which is also the pre-scan that tells an interleaved file, then given rows
+/// and offsets in order, and then filled in parallel; a sequential file takes
+/// lines for a row until it is full, which is how well-formed line sequential
+/// files are laid out; interleaved files are read round robin after the names
+bool CReadMapped::read_phylip(){
+
+	const char *p_begin, *p_end, *p_name_begin, *p_name_end;
+	char sz_header[64];
+	int n_seqs = 0, n_length = 0;
+	long n_chunks, n_count_line = 0, n_row;
+	size_t n_length_header;
+	bool b_is_interleaved = false, b_empty_line = false;
+	std::vector<const char *> lst_chunks;
+	std::vector< std::vector<line_info> > lst_found;
+	std::vector<line_info> lst_lines;
+
+	/// the first line giving two numbers has the dimensions
+	while (n_seqs == 0 && n_length == 0){
+		if (!next_line(p_begin, p_end)) return false;
+		if (p_begin == p_end) continue;
+		n_length_header = (size_t) (p_end - p_begin);
+		if (n_length_header > sizeof(sz_header) - 1) n_length_header = sizeof(sz_header) - 1;
+		memcpy(sz_header, p_begin, n_length_header);
+		sz_header[n_length_header] = '\0';
+		if (std::sscanf(sz_header, "%d%d", &n_seqs, &n_length) != 2){
+			n_seqs = 0;
+			n_length = 0;
+		}
+	}
+	if (n_seqs < 2 || n_length < 1 || !set_length(n_length)) return false;
+
+	/// data start at the first line ending with a residue
+	do {
+		if (!next_line(p_begin, p_end)) return false;
+	} while (p_begin == p_end || p_end[-1] == '\0' || strchr(sz_phylip_accept_chars, p_end[-1]) == NULL);
+
+	scan_phylip_lines(p_begin, p_end, lst_lines);
+	split_chunks(p_next, lst_chunks);
+	n_chunks = (long) lst_chunks.size() - 1;
+	lst_found.resize(n_chunks);
+	#pragma omp parallel for schedule(dynamic) if (n_chunks > 1)
+	for (long i = 0; i < n_chunks; i++) scan_phylip_lines(lst_chunks[i], lst_chunks[i + 1], lst_found[i]);
+	for (long i = 0; i < n_chunks; i++) lst_lines.insert(lst_lines.end(), lst_found[i].begin(), lst_found[i].end());
+
+	/// a full first row cannot be interleaved; otherwise it is if a line
+	/// with data follows an empty line
+	if (lst_lines[0].n_residues - lst_lines[0].n_residues_name < n_length_seq){
+		for (size_t i = 1; i < lst_lines.size() && !b_is_interleaved; i++){
+			if (lst_lines[i].p_begin == lst_lines[i].p_end) b_empty_line = true;
+			else if (b_empty_line) b_is_interleaved = true;
+		}
+	}
+
+	for (size_t i = 0; i < lst_lines.size(); i++){
+		line_info &line = lst_lines[i];
+		if (line.p_begin == line.p_end) continue;
+		if (n_rows < n_seqs && (b_is_interleaved || n_rows == 0 || lst_length[n_rows - 1] == n_length_seq)){
+			if (line.p_end - line.p_begin < n_nmlngth_phylip_names) return false;
+			p_name_begin = line.p_begin;
+			p_name_end = line.p_begin + n_nmlngth_phylip_names;
+			trim_range(p_name_begin, p_name_end);
+			if (!add_row(p_name_begin, p_name_end)) return false;
+			line.p_begin += n_nmlngth_phylip_names;
+			line.n_residues -= line.n_residues_name;
+			n_row = n_rows - 1;
+		}
+		else if (b_is_interleaved){
+			n_row = n_count_line;
+			n_count_line += 1;
+			if (n_count_line == n_seqs) n_count_line = 0;
+		}
+		else n_row = n_rows - 1;
+		line.n_row = n_row;
+		line.n_offset = lst_length[n_row];
+		lst_length[n_row] += line.n_residues;
+		if (lst_length[n_row] > n_length_seq) return false;
+	}
+
+	if (n_rows != n_seqs) return false;
+	for (long i = 0; i < n_rows; i++) if (lst_length[i] != n_length_seq) return false;
+	return fill_phylip_rows(lst_lines);
+}
+
+bool CReadMapped::read_file(std::string sz_file_name, struct data *p_lvbmat,
+		const unsigned char *lut, char **p_varies){
+
+	std::string sz_only_file_name, sz_extension;
+	bool b_is_fasta, b_ok;
+
+	/// file type from the name, as in CReadFiles, less any ".gz" or ".zst"
+#ifdef WINDOWS_KEY_WORD
+	if (sz_file_name.find_last_of("\\") != string::npos)
+		sz_only_file_name = sz_file_name.substr(sz_file_name.find_last_of("\\") + 1);
+#else
+	if (sz_file_name.find_last_of("/") != string::npos)
+		sz_only_file_name = sz_file_name.substr(sz_file_name.find_last_of("/") + 1);
+#endif
+	else sz_only_file_name = sz_file_name;
+	sz_only_file_name = CReadCompressed::strip_suffix(sz_only_file_name);
+	if (sz_only_file_name.find_last_of(".") != string::npos)
+		sz_extension = sz_only_file_name.substr(sz_only_file_name.find_last_of(".") + 1);
+	else sz_extension = "";
+
+	if (sz_extension.compare("fas") == 0) b_is_fasta = true;
+	else if (sz_extension.compare("phy") == 0 || sz_extension.compare("ph") == 0 || sz_only_file_name.compare("infile") == 0) b_is_fasta = false;
+	else return false;
+
+	p_lut = lut;
+	if (!map_file(sz_file_name)) return false;
+	b_ok = b_is_fasta ? read_fasta() : read_phylip();
+	unmap_file();
+	if (!b_ok || n_rows < 2){
+		free_rows();
+		return false;
+	}
+
+	/// hand the rows over
+	for (long i = 0; i < n_rows; i++) lst_rows[i][n_length_seq] = '\0';
+	p_lvbmat->n = n_rows;
+	p_lvbmat->m = n_length_seq;
+	p_lvbmat->row = lst_rows;
+	p_lvbmat->rowblock = NULL;
+	p_lvbmat->rowtitle = lst_names;
+	if (p_varies != NULL) *p_varies = lst_varies;
+	else free(lst_varies);
+	free(lst_length);
+	lst_rows = NULL;
+	lst_names = NULL;
+	lst_length = NULL;
+	lst_varies = NULL;
+	n_rows = 0;
+	n_rows_max = 0;
+	n_length_seq = -1;
+	return true;
+}
@@ -0,0 +1,81 @@
+/*
+ * CReadMapped.h
+ *
+ *  Reads FASTA and PHYLIP files straight from a memory map into the rows
+ *  of the LVB data matrix, without intermediate strings, optionally
+ *  encoding each residue by a lookup table as it goes; large files are
+ *  split at line boundaries and parsed by several threads; compressed
+ *  files are decompressed into memory by CReadCompressed instead
+ */
+
+#ifndef CREADMAPPED_H_
+#define CREADMAPPED_H_
+
+#include <string>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <vector>
+
+struct data;
+
+class CReadMapped {
+
+public:
+	CReadMapped();
+	virtual ~CReadMapped();
+
+	/// returns false, leaving p_lvbmat untouched, if the file is not FASTA or
+	/// PHYLIP, cannot be mapped, or is not well formed; CReadFiles then reads
+	/// it and reports any error; if lut is not NULL, each residue c is stored
+	/// as lut[c], false is returned if that is 0, and *p_varies is set to a
+	/// new array, nonzero where a column differs from the first row
+	bool read_file(std::string sz_file_name, struct data *p_lvbmat,
+			const unsigned char *lut = NULL, char **p_varies = NULL);
+
+private:
+	const char *p_buf;			/// mapped file
+	size_t n_size;				/// bytes in p_buf
+	bool b_inflated;			/// p_buf was decompressed, not mapped
+	const char *p_next;			/// start of the next line
+
+	/// rows being filled
+	char **lst_rows;
+	char **lst_names;
+	long *lst_length;			/// residues in each row so far
+	long n_rows;				/// rows allocated
+	long n_rows_max;			/// size of the three arrays above
+	long n_length_seq;			/// residues per row, -1 if not yet known
+	const unsigned char *p_lut;		/// encoding of residues, or NULL
+	char *lst_varies;			/// columns that differ from the first row
+
+	/// a line of PHYLIP data, and where its residues go
+	struct line_info {
+		const char *p_begin;		/// trimmed line
+		const char *p_end;
+		long n_residues;			/// residues in the line
+		long n_residues_name;		/// those within the name field
+		long n_row;					/// row they belong to, -1 if none
+		long n_offset;				/// position of the first in that row
+	};
+
+	bool map_file(std::string sz_file_name);
+	void unmap_file();
+	bool next_line(const char *&p_begin, const char *&p_end);
+	void split_chunks(const char *p_start, std::vector<const char *> &lst_chunks);
+	bool set_length(long n_length);
+	bool add_row(const char *p_name_begin, const char *p_name_end);
+	long put_residues(char *p_row, long n_offset, const char *p_begin, const char *p_end,
+			bool b_is_phylip, char *p_varies);
+	void merge_varies(const char *p_varies);
+	void free_rows();
+
+	bool read_fasta();
+	void find_fasta_headers(const char *p_from, const char *p_to, std::vector<const char *> &lst_headers);
+	bool read_fasta_record(long n_row, const char *p_from, const char *p_to, char *p_varies);
+	bool read_phylip();
+	void scan_phylip_lines(const char *p_from, const char *p_to, std::vector<line_info> &lst_lines);
+	bool fill_phylip_rows(const std::vector<line_info> &lst_lines);
+};
+
+#endif /* CREADMAPPED_H_ */
@@ -5,9 +5,17 @@
  *      Author: mmp
  */
 #include "ReadFile.h"
+#include "CReadMapped.h"
+#include "CReadCompressed.h"
+#include "CMatrixCache.h"
 
 void read_file(char *file_name, DataStructure *p_lvbmat){
 
+	/// well-formed FASTA and PHYLIP files go straight from a memory map into
+	/// the rows; anything else, and any error, is left to CReadFiles
+	CReadMapped readMapped = CReadMapped();
+	if (readMapped.read_file(std::string(file_name), p_lvbmat)) return;
+
 	CReadFiles readFiles = CReadFiles();
 	/// read file
 	std::string sz_file_name = std::string(file_name);
@@ -21,8 +29,9 @@ void read_file(char *file_name, DataStructure *p_lvbmat){
     /* array for row title strings */
     p_lvbmat->rowtitle = (char **) malloc((size_t) (p_lvbmat->n) * sizeof(char *));
 
-    /* array for row strings */
+    /* array for row strings, and one block for the strings themselves */
     p_lvbmat->row = (char **) malloc((size_t) (p_lvbmat->n) * sizeof(char *));
+    p_lvbmat->rowblock = (char *) malloc((size_t) (p_lvbmat->n) * (size_t) (p_lvbmat->m + 1));
 
 	/* initialize unallocated pointers to NULL */
 	for (int i = 0; i < p_lvbmat->n; ++i){
@@ -34,7 +43,7 @@ void read_file(char *file_name, DataStructure *p_lvbmat){
      * data structures */
     for (int i = 0; i < p_lvbmat->n; i++){
     	p_lvbmat->rowtitle[i] = (char*) malloc(sizeof(char) * (readFiles.get_max_length_seq_name() + 1));
-    	p_lvbmat->row[i] = (char*) malloc(sizeof(char) * (p_lvbmat->m + 1));
+    	p_lvbmat->row[i] = p_lvbmat->rowblock + (size_t) i * (size_t) (p_lvbmat->m + 1);
     }
     for (int i = 0; i < p_lvbmat->n; i++) {
         for (int j = 0; j < readFiles.get_length_seq_name(i); j++) p_lvbmat->rowtitle[i][j] = readFiles.get_char_seq_name(i, j);
@@ -49,6 +58,34 @@ void read_file(char *file_name, DataStructure *p_lvbmat){
 }
 
 
+/// as read_file(), but each residue c is stored in the rows as lut[c], and
+/// *p_varies is set to a new array, nonzero where a column differs from the
+/// first row; mapped files are encoded as they are read, others afterwards;
+/// compressed files can only be read by CReadMapped
+void read_file_encoded(char *file_name, DataStructure *p_lvbmat, const unsigned char *lut, char **p_varies){
+
+	CReadMapped readMapped = CReadMapped();
+	if (readMapped.read_file(std::string(file_name), p_lvbmat, lut, p_varies)) return;
+	if (CReadCompressed::get_compression(std::string(file_name)) != CReadCompressed::COMPRESSION_NONE)
+		CReadFiles::exit_error(1, "Could not read the compressed file " + std::string(file_name) +
+				"; it must hold a well formed FASTA or PHYLIP file, and be compressed in a way this build supports");
+
+	read_file(file_name, p_lvbmat);
+	*p_varies = (char *) calloc((size_t) p_lvbmat->m, 1);
+	for (int i = 0; i < p_lvbmat->n; i++) {
+		for (int j = 0; j < p_lvbmat->m; j++) {
+			unsigned char c_set = lut[(unsigned char) p_lvbmat->row[i][j]];
+			if (c_set == 0) {
+				std::string error = "Unrecognised character '" + std::string(1, p_lvbmat->row[i][j]) + "' in sequence " + std::string(p_lvbmat->rowtitle[i]);
+				CReadFiles::exit_error(1, error);
+			}
+			p_lvbmat->row[i][j] = (char) c_set;
+			if (i > 0 && p_lvbmat->row[i][j] != p_lvbmat->row[0][j]) (*p_varies)[j] = 1;
+		}
+	}
+}
+
+
 void phylip_mat_dims_in_external(char *file_name, long *species_ptr, long *sites_ptr){
 
 	CReadFiles readFiles = CReadFiles();
@@ -67,9 +104,11 @@ void phylip_mat_dims_in_external(char *file_name, long *species_ptr, long *sites
 void free_lvbmat_structure(DataStructure *p_lvbmat){
 
 	if (p_lvbmat->row != NULL){
-		for(int i = 0; i < p_lvbmat->n; ++i) free(p_lvbmat->row[i]);
+		if (p_lvbmat->rowblock != NULL) free(p_lvbmat->rowblock);
+		else for(int i = 0; i < p_lvbmat->n; ++i) free(p_lvbmat->row[i]);
 		free(p_lvbmat->row);
 		p_lvbmat->row = NULL;
+		p_lvbmat->rowblock = NULL;
 	}
 	if (p_lvbmat->rowtitle != NULL){
 		for(int i = 0; i < p_lvbmat->n; ++i) free(p_lvbmat->rowtitle[i]);
@@ -80,3 +119,23 @@ void free_lvbmat_structure(DataStructure *p_lvbmat){
 //	p_lvbmat = NULL;
 }
 
+/// fills p_lvbmat, p_counts and *p_length_full from the cache cache_name of
+/// file_name made with the same options and returns 1, or returns 0 if there
+/// is no such cache or its rows are longer than max_length
+int read_matrix_cache(char *cache_name, char *file_name, long options, long max_length,
+		DataStructure *p_lvbmat, long *p_counts, long *p_length_full){
+
+	CMatrixCache matrixCache = CMatrixCache();
+	return matrixCache.read_cache(std::string(cache_name), std::string(file_name), options,
+			max_length, p_lvbmat, p_counts, p_length_full) ? 1 : 0;
+}
+
+/// writes p_lvbmat, p_counts and length_full to the cache cache_name of
+/// file_name; returns 1, or 0 if it cannot be written
+int write_matrix_cache(char *cache_name, char *file_name, long options, DataStructure *p_lvbmat,
+		const long *p_counts, long length_full){
+
+	CMatrixCache matrixCache = CMatrixCache();
+	return matrixCache.write_cache(std::string(cache_name), std::string(file_name), options,
+			p_lvbmat, p_counts, length_full) ? 1 : 0;
+}
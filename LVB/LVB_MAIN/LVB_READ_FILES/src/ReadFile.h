@@ -19,16 +19,28 @@ typedef struct data
     long m;		/* number of columns */
     long n;		/* number of rows */
     char **rowtitle;	/* array of row title strings */
+    long *minsteps;	/* as in lvb.h; not used by the readers */
+    char *rowblock;	/* block holding every row string, or NULL */
 } *Dataptr, DataStructure;
 
 // nm -D libLVB_READ_FILES_LD.so | grep " T "
 /// to export
 extern "C" void read_file(char *file_name, DataStructure *p_lvbmat);
 extern "C" void phylip_mat_dims_in_external(char *file_name, long *species_ptr, long *sites_ptr);
+extern "C" void read_file_encoded(char *file_name, DataStructure *p_lvbmat, const unsigned char *lut, char **p_varies);
+extern "C" int read_matrix_cache(char *cache_name, char *file_name, long options, long max_length,
+		DataStructure *p_lvbmat, long *p_counts, long *p_length_full);
+extern "C" int write_matrix_cache(char *cache_name, char *file_name, long options, DataStructure *p_lvbmat,
+		const long *p_counts, long length_full);
 
 
 void read_file(char *file_name, DataStructure *p_lvbmat);
 void phylip_mat_dims_in_external(char *file_name, long *species_ptr, long *sites_ptr);
+void read_file_encoded(char *file_name, DataStructure *p_lvbmat, const unsigned char *lut, char **p_varies);
+int read_matrix_cache(char *cache_name, char *file_name, long options, long max_length,
+		DataStructure *p_lvbmat, long *p_counts, long *p_length_full);
+int write_matrix_cache(char *cache_name, char *file_name, long options, DataStructure *p_lvbmat,
+		const long *p_counts, long length_full);
 void free_lvbmat_structure(DataStructure *p_lvbmat);
 
 
@@ -0,0 +1,569 @@
+/* LVB
+ * (c) Copyright 2003-2012 by Daniel Barker.
+ * (c) Copyright 2013, 2014 by Daniel Barker and Maximilian Strobl.
+ * Permission is granted to copy and use this program provided that no fee is
+ * charged for it and provided that this copyright notice is not removed. */
+
+/**********
+
+=head1 NAME
+
+bandb.c - exact search by branch and bound
+
+=head1 DESCRIPTION
+
+Finds all most parsimonious trees for small data matrices, for which
+annealing is unnecessary and cannot show that its trees are the
+shortest.
+
+=cut
+
+**********/
+
+#include "lvb.h"
+
+typedef struct	/* state of a branch-and-bound search */
+{
+    Dataptr matrix;		/* data matrix */
+    unsigned char **enc_mat;	/* state sets of objects */
+    const long *weights;	/* weights of characters */
+    Branch *tree;		/* current partial tree, links only */
+    long *order;		/* element d: object added d-th */
+    long *rem;			/* element d: least length still to come
+				 * once objects order[0..d-1] are placed */
+    long *todo;			/* branches in preorder */
+    const unsigned char **down;	/* element i: down-pass sets of branch i */
+    unsigned char *down_buf;	/* down-pass sets of internal branches */
+    unsigned char *up;		/* up-pass sets, m per branch */
+    long *edge;			/* per depth: branches to add next object at */
+    long *cost;			/* per depth: length with object added there */
+    long best;			/* length of shortest trees so far */
+    long trees;			/* shortest trees pushed so far */
+    long iter;			/* partial trees tried */
+    Lvb_bool stopped;		/* search stopped after BANDB_MAX_ITER */
+    Treestack *sp;		/* shortest trees */
+    Branch *out;		/* complete tree for pushing to sp */
+    FILE *lenfp;		/* progress log, or NULL */
+} Bandb;
+
+static void bb_sets(Bandb *const s)
+/* fill s->down and s->up for the current partial tree, whose root is
+ * object 0 */
+{
+    const long m = s->matrix->m;	/* characters */
+    const long n = s->matrix->n;	/* objects */
+    const Branch *const t = s->tree;	/* current partial tree */
+    long cnt = 0;			/* branches in preorder */
+    long i;				/* loop counter */
+    long b;				/* current branch */
+    long l;				/* left child of b */
+    long r;				/* right child of b */
+
+    /* preorder from the root's children */
+    s->todo[cnt++] = t[0].left;
+    s->todo[cnt++] = t[0].right;
+    for (i = 0; i < cnt; i++) {
+	b = s->todo[i];
+	if (b >= n) {
+	    s->todo[cnt++] = t[b].left;
+	    s->todo[cnt++] = t[b].right;
+	}
+    }
+
+    /* down pass, children before parents */
+    for (i = cnt - 1; i >= 0; i--) {
+	b = s->todo[i];
+	if (b >= n) {
+	    fitch_sets(s->down_buf + (b - n) * m, s->down[t[b].left],
+		s->down[t[b].right], m);
+	    s->down[b] = s->down_buf + (b - n) * m;
+	}
+    }
+
+    /* up pass, parents before children */
+    l = t[0].left;
+    r = t[0].right;
+    fitch_sets(s->up + l * m, s->enc_mat[0], s->down[r], m);
+    fitch_sets(s->up + r * m, s->enc_mat[0], s->down[l], m);
+    for (i = 0; i < cnt; i++) {
+	b = s->todo[i];
+	if (b >= n) {
+	    l = t[b].left;
+	    r = t[b].right;
+	    fitch_sets(s->up + l * m, s->up + b * m, s->down[r], m);
+	    fitch_sets(s->up + r * m, s->up + b * m, s->down[l], m);
+	}
+    }
+
+} /* end bb_sets() */
+
+static long bb_cost(const Bandb *const s, const long x, const long e)
+/* return the increase in length from adding object x to the current
+ * partial tree at branch e, i.e. between e and its parent, or, if e is the
+ * root, between the root and the rest of the tree; s->down and s->up must
+ * be up to date */
+{
+    const long m = s->matrix->m;	/* characters */
+    const unsigned char *const ssx = s->enc_mat[x];	/* sets of x */
+    const unsigned char *a;		/* sets of one side of e */
+    const unsigned char *l;		/* sets of root's left child */
+    const unsigned char *r;		/* sets of root's right child */
+    long k;				/* loop counter */
+    long cost = 0;			/* return value */
+    unsigned char ss;			/* state sets of e */
+
+    if (e == 0) {
+	l = s->down[s->tree[0].left];
+	r = s->down[s->tree[0].right];
+	a = s->enc_mat[0];
+	for (k = 0; k < m; k++) {
+	    ss = l[k] & r[k];
+	    if (ss == 0U) ss = l[k] | r[k];
+	    if ((a[k] & ss) != 0U) ss &= a[k];
+	    else ss |= a[k];
+	    if ((ssx[k] & ss) == 0U) cost += s->weights[k];
+	}
+    }
+    else cost = insert_cost(s->down[e], s->up + e * m, ssx, m, s->weights);
+    return cost;
+
+} /* end bb_cost() */
+
+static void bb_insert(Branch *const t, const long x, const long u, const long e)
+/* add object x to partial tree t at branch e, as for bb_cost(), using
+ * internal branch u */
+{
+    long p;	/* parent of e */
+
+    if (e == 0) {
+	t[u].left = t[0].left;
+	t[u].right = t[0].right;
+	t[t[u].left].parent = u;
+	t[t[u].right].parent = u;
+	t[u].parent = 0;
+	t[0].left = u;
+	t[0].right = x;
+	t[x].parent = 0;
+    }
+    else {
+	p = t[e].parent;
+	if (t[p].left == e) t[p].left = u;
+	else t[p].right = u;
+	t[u].parent = p;
+	t[u].left = e;
+	t[u].right = x;
+	t[e].parent = u;
+	t[x].parent = u;
+    }
+
+} /* end bb_insert() */
+
+static void bb_remove(Branch *const t, const long x, const long u, const long e)
+/* undo bb_insert(t, x, u, e) */
+{
+    long p;	/* parent of e */
+
+    if (e == 0) {
+	t[0].left = t[u].left;
+	t[0].right = t[u].right;
+	t[t[0].left].parent = 0;
+	t[t[0].right].parent = 0;
+    }
+    else {
+	p = t[u].parent;
+	if (t[p].left == u) t[p].left = e;
+	else t[p].right = e;
+	t[e].parent = p;
+    }
+    t[u].parent = UNSET;
+    t[u].left = UNSET;
+    t[u].right = UNSET;
+    t[x].parent = UNSET;
+
+} /* end bb_remove() */
+
+static long bb_edges(const Bandb *const s, const long d, long *const edge)
+/* fill edge with the branches at which the next object may be added to the
+ * current partial tree of d objects; return their number */
+{
+    const long n = s->matrix->n;	/* objects */
+    long cnt = 0;			/* return value */
+    long i;				/* loop counter */
+
+    edge[cnt++] = 0;
+    for (i = 1; i < d; i++) edge[cnt++] = s->order[i];
+    for (i = n; i < n + d - 3; i++) edge[cnt++] = i;
+    return cnt;
+
+} /* end bb_edges() */
+
+static void bb_record(Bandb *const s, const long len)
+/* note the current tree, which is complete and of length len, if it is
+ * among the shortest so far */
+{
+    const long n = s->matrix->n;	/* objects */
+    long i;				/* loop counter */
+
+    if (len < s->best) {
+	s->best = len;
+	s->trees = 0;
+	treestack_clear(s->sp);
+	if (s->lenfp != NULL)
+	    fprintf(s->lenfp, "%-15ld%-15ld%-15ld\n", 1L, s->iter, len);
+    }
+    if (s->trees < BANDB_MAX_TREES) {
+	for (i = 0; i < brcnt(n); i++) {
+	    s->out[i].parent = s->tree[i].parent;
+	    s->out[i].left = s->tree[i].left;
+	    s->out[i].right = s->tree[i].right;
+	    s->out[i].changes = 0;
+	}
+	ss_init(s->out, s->enc_mat, brcnt(n), s->matrix->m);
+	s->trees += treestack_push(s->matrix, s->sp, s->out, 0);
+    }
+
+} /* end bb_record() */
+
+static void bb_search(Bandb *const s, const long d, const long len)
+/* try every way of adding objects order[d..n-1] to the current partial
+ * tree, of d objects and length len, whose length with all of them could
+ * be no more than that of the shortest trees so far, until BANDB_MAX_ITER
+ * partial trees have been tried in all */
+{
+    const long n = s->matrix->n;	/* objects */
+    long x;				/* object to add */
+    const long u = n + d - 3;		/* internal branch to add it with */
+    long *const edge = s->edge + d * brcnt(n);	/* where to add x */
+    long *const cost = s->cost + d * brcnt(n);	/* length after adding x */
+    long cnt;				/* elements in edge */
+    long i;				/* loop counter */
+    long j;				/* loop counter */
+    long tmp;				/* for swapping */
+
+    if (d == n) {
+	bb_record(s, len);
+	return;
+    }
+
+    x = s->order[d];
+    bb_sets(s);
+    cnt = bb_edges(s, d, edge);
+    for (i = 0; i < cnt; i++) cost[i] = len + bb_cost(s, x, edge[i]);
+
+    /* shortest first, so good trees are found early */
+    for (i = 1; i < cnt; i++) {
+	for (j = i; (j > 0) && (cost[j] < cost[j - 1]); j--) {
+	    tmp = cost[j]; cost[j] = cost[j - 1]; cost[j - 1] = tmp;
+	    tmp = edge[j]; edge[j] = edge[j - 1]; edge[j - 1] = tmp;
+	}
+    }
+
+    /* ties with the shortest trees are followed only while more of them
+     * are wanted */
+    for (i = 0; i < cnt; i++) {
+	if ((cost[i] + s->rem[d + 1] > s->best)
+	 || ((cost[i] + s->rem[d + 1] == s->best) && (s->trees >= BANDB_MAX_TREES)))
+	    break;
+	if (s->iter >= BANDB_MAX_ITER) {
+	    s->stopped = LVB_TRUE;
+	    break;
+	}
+	bb_insert(s->tree, x, u, edge[i]);
+	s->iter++;
+	bb_search(s, d + 1, cost[i]);
+	bb_remove(s->tree, x, u, edge[i]);
+    }
+
+} /* end bb_search() */
+
+static void bb_first(Bandb *const s)
+/* set s->tree to the tree of objects order[0..2] */
+{
+    long i;	/* loop counter */
+
+    for (i = 0; i < brcnt(s->matrix->n); i++) {
+	s->tree[i].parent = UNSET;
+	s->tree[i].left = UNSET;
+	s->tree[i].right = UNSET;
+    }
+    s->tree[0].left = s->order[1];
+    s->tree[0].right = s->order[2];
+    s->tree[s->order[1]].parent = 0;
+    s->tree[s->order[2]].parent = 0;
+
+} /* end bb_first() */
+
+static long bb_start(Bandb *const s)
+/* set s->order, s->rem, s->best to the length of a tree by greedy
+ * addition, which is recorded, and s->tree to the tree of objects
+ * order[0..2]; return that tree's length; in greedy addition, each next object is the one whose
+ * cheapest place in the tree of the objects before it is dearest, so the
+ * bound rises quickly; object 0 comes first, to be the root */
+{
+    const long n = s->matrix->n;	/* objects */
+    const long m = s->matrix->m;	/* characters */
+    long d;				/* objects placed */
+    long i;				/* loop counter */
+    long j;				/* loop counter */
+    long k;				/* loop counter */
+    long c;				/* current cost */
+    long cnt;				/* places to add an object */
+    long least;				/* cheapest place for an object */
+    long least_e = UNSET;		/* branch of cheapest place */
+    long dearest = -1;			/* dearest cheapest place */
+    long dearest_e = UNSET;		/* branch of dearest cheapest place */
+    long dearest_i = UNSET;		/* order[] index of dearest object */
+    long len = 0;			/* return value */
+    long total;				/* length of greedy tree */
+    unsigned char ss;			/* intersection of state sets */
+    const unsigned char *a;		/* state sets */
+    const unsigned char *b;		/* state sets */
+
+    for (i = 0; i < n; i++) s->order[i] = i;
+
+    /* objects 1 and 2: most different from object 0, then from both */
+    for (d = 1; d < 3; d++) {
+	dearest = -1;
+	for (i = d; i < n; i++) {
+	    c = 0;
+	    for (j = 0; j < d; j++) {
+		a = s->enc_mat[s->order[i]];
+		b = s->enc_mat[s->order[j]];
+		for (k = 0; k < m; k++)
+		    if ((a[k] & b[k]) == 0U) c += s->weights[k];
+	    }
+	    if (c > dearest) {
+		dearest = c;
+		dearest_i = i;
+	    }
+	}
+	j = s->order[d];
+	s->order[d] = s->order[dearest_i];
+	s->order[dearest_i] = j;
+    }
+
+    bb_first(s);
+    a = s->enc_mat[s->order[1]];
+    b = s->enc_mat[s->order[2]];
+    for (k = 0; k < m; k++) {
+	ss = a[k] & b[k];
+	if (ss == 0U) {
+	    ss = a[k] | b[k];
+	    len += s->weights[k];
+	}
+	if ((ss & s->enc_mat[0][k]) == 0U) len += s->weights[k];
+    }
+
+    /* the rest, building a tree to order them by */
+    total = len;
+    for (d = 3; d < n; d++) {
+	bb_sets(s);
+	cnt = bb_edges(s, d, s->edge);
+	dearest = -1;
+	for (i = d; i < n; i++) {
+	    least = LONG_MAX;
+	    for (j = 0; j < cnt; j++) {
+		c = bb_cost(s, s->order[i], s->edge[j]);
+		if (c < least) {
+		    least = c;
+		    least_e = s->edge[j];
+		}
+	    }
+	    if (least > dearest) {
+		dearest = least;
+		dearest_i = i;
+		dearest_e = least_e;
+	    }
+	}
+	j = s->order[d];
+	s->order[d] = s->order[dearest_i];
+	s->order[dearest_i] = j;
+	bb_insert(s->tree, s->order[d], n + d - 3, dearest_e);
+	total += dearest;
+    }
+    s->best = total;
+    bb_record(s, total);
+
+    /* least length still to come: one change for every character where an
+     * object has no state in common with any object before it */
+    s->rem[n] = 0;
+    for (d = n - 1; d >= 0; d--) {
+	s->rem[d] = s->rem[d + 1];
+	a = s->enc_mat[s->order[d]];
+	for (k = 0; k < m; k++) {
+	    ss = 0U;
+	    for (i = 0; i < d; i++) ss |= s->enc_mat[s->order[i]][k];
+	    if ((a[k] & ss) == 0U) s->rem[d] += s->weights[k];
+	}
+    }
+
+    bb_first(s);
+    return len;
+
+} /* end bb_start() */
+
+/**********
+
+=head1 bandb - FIND ALL MOST PARSIMONIOUS TREES BY BRANCH AND BOUND
+
+=head2 SYNOPSIS
+
+    long bandb(Dataptr matrix, Treestack *bstackp, unsigned char **enc_mat,
+    FILE *const lenfp, const long *weights, long *current_iter,
+    Lvb_bool log_progress, Lvb_bool *const finished);
+
+=head2 DESCRIPTION
+
+Finds the most parsimonious trees by adding the objects one at a time in
+every possible place, abandoning any partial tree that could not lead to
+a tree as short as the shortest found so far. Returns their length.
+
+The first bound is the length of a tree built by adding each next object
+where it costs least, the objects being taken in the order that makes
+this cost greatest. The same order is used for the search, so large
+increases in length come early. A partial tree is abandoned if its length
+plus a lower bound on the length still to come exceeds the bound. For
+each character, each later object with no state in common with any
+object before it must add a change. This is weaker than the bound from
+C<getminlen()> for a whole tree, but applies to partial trees as well.
+
+The length of the tree with each possible addition is found from
+Fitch state sets for each side of every branch of the partial tree, as
+in C<addtree()>, so each partial tree costs one pass over its branches.
+
+At most C<BANDB_MAX_TREES> most parsimonious trees are kept. Once that
+many are found, only shorter trees are sought, so the length returned is
+still exact.
+
+The number of partial trees grows very fast with the number of objects,
+so the search stops after C<BANDB_MAX_ITER> of them. The trees on the
+stack are then the shortest found so far, which are no longer than the
+first bound, but need not be most parsimonious.
+
+=head2 PARAMETERS
+
+=head3 INPUT
+
+=over 4
+
+=item matrix
+
+The data matrix.
+
+=item enc_mat
+
+The state sets of the objects, as from C<dna_makebin()>.
+
+=item lenfp
+
+File for output of progress, if C<log_progress> is C<LVB_TRUE>.
+
+=item weights
+
+Weights of the characters.
+
+=item log_progress
+
+If C<LVB_TRUE>, a line is written to C<lenfp> at the start and each time
+a shorter tree is found.
+
+=back
+
+=head3 INOUT
+
+=over 4
+
+=item bstackp
+
+The most parsimonious trees are pushed on to this stack, which is first
+cleared. They have root 0.
+
+=item current_iter
+
+Increased by the number of partial trees tried.
+
+=back
+
+=head3 OUTPUT
+
+=over 4
+
+=item finished
+
+Set to C<LVB_TRUE> if the search finished, so the trees are most
+parsimonious, or C<LVB_FALSE> if it stopped after C<BANDB_MAX_ITER>
+partial trees.
+
+=back
+
+=head2 RETURN
+
+Returns the length of the most parsimonious trees, or of the shortest
+trees found if the search stopped.
+
+=cut
+
+**********/
+
+long bandb(Dataptr matrix, Treestack *bstackp, unsigned char **enc_mat,
+    FILE *const lenfp, const long *weights, long *current_iter,
+    Lvb_bool log_progress, Lvb_bool *const finished)
+{
+    const long n = matrix->n;		/* objects */
+    const long m = matrix->m;		/* characters */
+    const long nbranches = brcnt(n);	/* branches per tree */
+    long i;				/* loop counter */
+    long len;				/* length of first partial tree */
+    Bandb s;				/* search state */
+
+    lvb_assert(n >= MIN_N);
+
+    /* "local" dynamic heap memory */
+    s.matrix = matrix;
+    s.enc_mat = enc_mat;
+    s.weights = weights;
+    s.tree = treealloc(matrix);
+    s.out = treealloc(matrix);
+    s.order = alloc(n * sizeof(long), "addition order");
+    s.rem = alloc((n + 1) * sizeof(long), "bounds");
+    s.todo = alloc(nbranches * sizeof(long), "branches in preorder");
+    s.down = alloc(nbranches * sizeof(unsigned char *), "down-pass sets");
+    s.down_buf = alloc(n * m, "down-pass sets");
+    s.up = alloc(nbranches * m, "up-pass sets");
+    s.edge = alloc((n + 1) * nbranches * sizeof(long), "branches to add at");
+    s.cost = alloc((n + 1) * nbranches * sizeof(long), "lengths after adding");
+    s.trees = 0;
+    s.iter = 0;
+    s.stopped = LVB_FALSE;
+    s.sp = bstackp;
+    s.lenfp = (log_progress == LVB_TRUE) ? lenfp : NULL;
+    for (i = 0; i < n; i++) s.down[i] = enc_mat[i];
+
+    treestack_clear(bstackp);
+    len = bb_start(&s);
+    if (s.lenfp != NULL) {
+	fprintf(lenfp, "\nTrees:         Rearrangement: Length:\n");
+	fprintf(lenfp, "%-15ld%-15ld%-15ld\n", 0L, 0L, s.best);
+    }
+    bb_search(&s, 3, len);
+    if (s.lenfp != NULL)
+	fprintf(lenfp, "%-15ld%-15ld%-15ld\n", s.trees, s.iter, s.best);
+    lvb_assert(s.trees >= 1);
+    *current_iter += s.iter;
+    *finished = (s.stopped == LVB_TRUE) ? LVB_FALSE : LVB_TRUE;
+
+    /* free "local" dynamic heap memory */
+    free(s.tree);
+    free(s.out);
+    free(s.order);
+    free(s.rem);
+    free(s.todo);
+    free(s.down);
+    free(s.down_buf);
+    free(s.up);
+    free(s.edge);
+    free(s.cost);
+
+    return s.best;
+
+} /* end bandb() */
@@ -0,0 +1,544 @@
+/* LVB
+ * (c) Copyright 2003-2012 by Daniel Barker.
+ * (c) Copyright 2013, 2014 by Daniel Barker and Maximilian Strobl.
+ * Permission is granted to copy and use this program provided that no fee is
+ * charged for it and provided that this copyright notice is not removed. */
+
+/**********
+
+=head1 NAME
+
+ctreestack.c - concurrent tree stack functions
+
+=head1 DESCRIPTION
+
+Provides a store of the shortest tree topologies found so far, which
+several threads may push trees onto at once. It holds only trees of the
+best length pushed so far.
+
+Trees that are longer than the best length are rejected by reading
+one word, without taking a lock. Trees of the best length are checked
+for novelty against a hash table of topology hashes from C<treehash()>,
+inserted with compare-and-swap and also without a lock. Only new
+topologies are stored, in one of C<CTREESTACK_SHARDS> ordinary tree
+stacks, chosen by hash, each with its own lock. A strictly shorter
+tree clears the store by switching to a fresh hash table, so no thread
+ever sees a mixture of old and new lengths.
+
+Two different topologies with the same 64-bit hash are taken to be the
+same topology.
+
+If compiled without OpenMP, the same functions are available but are
+not thread-safe.
+
+=cut
+
+**********/
+
+#include "lvb.h"
+
+#ifdef _OPENMP
+#define CAS(p, old, new) __sync_bool_compare_and_swap((p), (old), (new))
+#define ADD(p, v) __sync_fetch_and_add((p), (v))
+#define BARRIER() __sync_synchronize()
+#else
+#define CAS(p, old, new) ((*(p) == (old)) ? (*(p) = (new), 1) : 0)
+#define ADD(p, v) (*(p) += (v))
+#define BARRIER() ((void) 0)
+#endif /* #ifdef _OPENMP */
+
+static Ctreestack_table *table_new(const long slots)
+/* return a new, empty hash table of slots slots */
+{
+    Ctreestack_table *t;	/* return value */
+    long i;			/* loop counter */
+
+    t = alloc(sizeof(Ctreestack_table), "concurrent tree stack table");
+    t->key = alloc(slots * sizeof(unsigned long), "topology hash table");
+    for (i = 0; i < slots; i++) t->key[i] = 0UL;
+    t->len = LONG_MAX;
+    t->active = 0;
+    return t;
+
+} /* end table_new() */
+
+static Ctreestack_table *table_enter(Ctreestack *sp)
+/* return the current hash table of *sp, counted as in use by this thread
+ * until table_leave() is called */
+{
+    Ctreestack_table *t;	/* return value */
+
+    while (1) {
+	t = sp->table;
+	ADD(&t->active, 1);
+	BARRIER();
+	if (t == sp->table) break;	/* not replaced meanwhile */
+	ADD(&t->active, -1);
+    }
+    return t;
+
+} /* end table_enter() */
+
+static void table_leave(Ctreestack_table *t)
+/* finish using hash table t */
+{
+    ADD(&t->active, -1);
+
+} /* end table_leave() */
+
+static void clear_to(Ctreestack *sp, const long len)
+/* make len the best length of *sp, discarding all trees, unless some
+ * other thread has already made it len or less */
+{
+    Ctreestack_table *t;	/* current table */
+    Ctreestack_table *s;	/* spare table */
+    long i;			/* loop counter */
+
+    #pragma omp critical (lvb_ctreestack)
+    {
+	t = sp->table;
+	if (len < t->len) {
+	    /* wait for threads still looking at the spare table from
+	     * before the last clear */
+	    s = sp->spare;
+	    while (ADD(&s->active, 0) != 0) ;
+	    for (i = 0; i < sp->slots; i++) s->key[i] = 0UL;
+	    s->len = len;
+	    BARRIER();
+	    sp->table = s;
+	    BARRIER();
+	    sp->spare = t;
+	}
+    }
+
+} /* end clear_to() */
+
+static long shard_push(Dataptr matrix, Ctreestack *sp, const long shard,
+    const Branch *const barray, const long root, const long len)
+/* push the tree in barray (of root root and length len) on to shard shard
+ * of *sp, unless the shard already holds shorter trees; return 1 if it was
+ * pushed, 0 otherwise */
+{
+    long val = 0;	/* return value */
+
+#ifdef _OPENMP
+    omp_set_lock(&sp->shard_lock[shard]);
+#endif
+    if (len < sp->shard_len[shard]) {
+	treestack_clear(&sp->shard[shard]);
+	sp->shard_len[shard] = len;
+    }
+    if (len == sp->shard_len[shard])
+	val = treestack_push(matrix, &sp->shard[shard], barray, root);
+#ifdef _OPENMP
+    omp_unset_lock(&sp->shard_lock[shard]);
+#endif
+    return val;
+
+} /* end shard_push() */
+
+/**********
+
+=head1 ctreestack_new - RETURN A NEW CONCURRENT TREE STACK
+
+=head2 SYNOPSIS
+
+    Ctreestack ctreestack_new(long slots);
+
+=head2 DESCRIPTION
+
+Returns a new concurrent tree stack.
+
+=head2 PARAMETERS
+
+=head3 INPUT
+
+=over 4
+
+=item slots
+
+Number of topologies of the best length that can be checked for
+novelty without a lock. More may be stored, but these are checked
+under the lock of their shard. Rounded up to a power of 2.
+
+=back
+
+=head2 RETURN
+
+Returns a new, empty concurrent tree stack.
+
+=cut
+
+**********/
+
+Ctreestack ctreestack_new(long slots)
+{
+    Ctreestack s;	/* return value */
+    long i;		/* loop counter */
+
+    s.slots = 1;
+    while (s.slots < slots) s.slots *= 2;
+    s.table = table_new(s.slots);
+    s.spare = table_new(s.slots);
+    s.shard = alloc(CTREESTACK_SHARDS * sizeof(Treestack), "tree stack shards");
+    s.shard_len = alloc(CTREESTACK_SHARDS * sizeof(long), "shard lengths");
+#ifdef _OPENMP
+    s.shard_lock = alloc(CTREESTACK_SHARDS * sizeof(omp_lock_t), "shard locks");
+#endif
+    for (i = 0; i < CTREESTACK_SHARDS; i++) {
+	s.shard[i] = treestack_new();
+	s.shard_len[i] = LONG_MAX;
+#ifdef _OPENMP
+	omp_init_lock(&s.shard_lock[i]);
+#endif
+    }
+
+    return s;
+
+} /* end ctreestack_new() */
+
+/**********
+
+=head1 ctreestack_push - PUSH TREE ONTO CONCURRENT TREE STACK
+
+=head2 SYNOPSIS
+
+    long ctreestack_push(Dataptr matrix, Ctreestack *sp,
+    const Branch *const barray, const long root, const long len);
+
+=head2 DESCRIPTION
+
+Push copy of a tree of given length onto a concurrent tree stack, if
+no shorter tree has been pushed and its topology is not already
+present. If it is shorter than every tree pushed so far, all other
+trees are discarded first. May be called by several threads at once.
+
+=head2 PARAMETERS
+
+=head3 INPUT
+
+=over 4
+
+=item barray
+
+Pointer to first element of array containing tree to be pushed.
+
+=item root
+
+Root branch number of tree to be pushed.
+
+=item len
+
+Length of tree to be pushed.
+
+=back
+
+=head3 INOUT
+
+=over 4
+
+=item sp
+
+Pointer to concurrent tree stack that may receive a new copy of the
+tree.
+
+=back
+
+=head2 RETURN
+
+Returns 1 if the tree was pushed, or 0 if not.
+
+=cut
+
+**********/
+
+long ctreestack_push(Dataptr matrix, Ctreestack *sp, const Branch *const barray,
+    const long root, const long len)
+{
+    Ctreestack_table *t;		/* current hash table */
+    unsigned long hash;			/* topology hash of tree */
+    unsigned long key;			/* hash, made non-zero */
+    unsigned long k;			/* current table entry */
+    long slot;				/* current table slot */
+    long probes;			/* slots tried */
+    Lvb_bool novel = LVB_FALSE;		/* new to the hash table */
+    Lvb_bool full = LVB_TRUE;		/* no room in the hash table */
+
+    /* reject longer trees without a lock */
+    BARRIER();
+    if (len > sp->table->len) return 0;
+    if (len < sp->table->len) clear_to(sp, len);
+
+    hash = treehash(matrix, barray, root);
+    key = (hash == 0UL) ? 1UL : hash;
+
+    t = table_enter(sp);
+    if (len != t->len) {	/* a shorter tree was pushed meanwhile */
+	lvb_assert(len > t->len);
+	table_leave(t);
+	return 0;
+    }
+    slot = (long) (key & (unsigned long) (sp->slots - 1));
+    for (probes = 0; probes < sp->slots; probes++) {
+	k = t->key[slot];
+	if (k == 0UL) {
+	    if (CAS(&t->key[slot], 0UL, key)) {
+		novel = LVB_TRUE;
+		full = LVB_FALSE;
+		break;
+	    }
+	    k = t->key[slot];	/* taken by another thread */
+	}
+	if (k == key) {		/* already present */
+	    full = LVB_FALSE;
+	    break;
+	}
+	slot = (slot + 1) & (sp->slots - 1);
+    }
+    table_leave(t);
+
+    if ((novel == LVB_TRUE) || (full == LVB_TRUE))
+	return shard_push(matrix, sp, (long) ((key >> 16) % CTREESTACK_SHARDS),
+	    barray, root, len);
+    else return 0;
+
+} /* end ctreestack_push() */
+
+/**********
+
+=head1 ctreestack_len - RETURN LENGTH OF TREES ON CONCURRENT TREE STACK
+
+=head2 SYNOPSIS
+
+    long ctreestack_len(Ctreestack *sp);
+
+=head2 DESCRIPTION
+
+Return the length of the shortest tree pushed so far. May be called by
+several threads at once, and while other threads push trees.
+
+=head2 PARAMETERS
+
+=head3 INPUT
+
+=over 4
+
+=item sp
+
+Pointer to the concurrent tree stack.
+
+=back
+
+=head2 RETURN
+
+Returns the length of the trees on the stack, or C<LONG_MAX> if it is
+empty.
+
+=cut
+
+**********/
+
+long ctreestack_len(Ctreestack *sp)
+{
+    BARRIER();
+    return sp->table->len;
+
+} /* end ctreestack_len() */
+
+/**********
+
+=head1 ctreestack_get - COPY A TREE FROM CONCURRENT TREE STACK
+
+=head2 SYNOPSIS
+
+    long ctreestack_get(Dataptr matrix, Ctreestack *sp, Branch *barray,
+    long *root);
+
+=head2 DESCRIPTION
+
+Copy one of the shortest trees on a concurrent tree stack, leaving the
+stack unchanged. May be called by several threads at once, and while
+other threads push trees.
+
+=head2 PARAMETERS
+
+=head3 OUTPUT
+
+=over 4
+
+=item barray
+
+Pointer to first element of array to contain the tree. There must be
+sufficient space in this array prior to the call.
+
+=item root
+
+Pointer to scalar that will receive the index of the root in C<barray>.
+
+=back
+
+=head3 INOUT
+
+=over 4
+
+=item sp
+
+Pointer to the concurrent tree stack.
+
+=back
+
+=head2 RETURN
+
+Returns 1 if a tree was copied, or 0 if the stack was empty.
+
+=cut
+
+**********/
+
+long ctreestack_get(Dataptr matrix, Ctreestack *sp, Branch *barray, long *root)
+{
+    long i;		/* loop counter */
+    long len;		/* length of shortest trees */
+    long val = 0;	/* return value */
+    Treestack *s;	/* current shard */
+
+    len = ctreestack_len(sp);
+    for (i = 0; (i < CTREESTACK_SHARDS) && (val == 0); i++) {
+	s = &sp->shard[i];
+#ifdef _OPENMP
+	omp_set_lock(&sp->shard_lock[i]);
+#endif
+	if ((sp->shard_len[i] == len) && (s->next > 0)) {
+	    treecopy(matrix, barray, s->stack[s->next - 1].tree);
+	    *root = s->stack[s->next - 1].root;
+	    val = 1;
+	}
+#ifdef _OPENMP
+	omp_unset_lock(&sp->shard_lock[i]);
+#endif
+    }
+
+    return val;
+
+} /* end ctreestack_get() */
+
+/**********
+
+=head1 ctreestack_transfer - TRANSFER TREES TO AN ORDINARY TREE STACK
+
+=head2 SYNOPSIS
+
+    long ctreestack_transfer(Dataptr matrix, Treestack *destp,
+    Ctreestack *sourcep);
+
+=head2 DESCRIPTION
+
+Transfer the shortest trees on a concurrent tree stack to an ordinary
+tree stack, as C<treestack_transfer()>. The source stack is emptied
+but not deallocated. Must not be called while other threads use the
+source stack.
+
+=head2 PARAMETERS
+
+=head3 INOUT
+
+=over 4
+
+=item destp
+
+Pointer to the stack to be added to.
+
+=item sourcep
+
+Pointer to the concurrent stack to be transferred to C<destp> and
+cleared.
+
+=back
+
+=head2 RETURN
+
+Number of trees actually transferred (excluding duplicates which
+are not transferred).
+
+=cut
+
+**********/
+
+long ctreestack_transfer(Dataptr matrix, Treestack *destp, Ctreestack *sourcep)
+{
+    long i;		/* loop counter */
+    long len;		/* length of shortest trees */
+    long pushed = 0;	/* number of trees transferred */
+    Ctreestack_table *t = sourcep->table;	/* current hash table */
+
+    len = ctreestack_len(sourcep);
+    for (i = 0; i < CTREESTACK_SHARDS; i++) {
+	if (sourcep->shard_len[i] == len)
+	    pushed += treestack_transfer(matrix, destp, &sourcep->shard[i]);
+	treestack_clear(&sourcep->shard[i]);
+	sourcep->shard_len[i] = LONG_MAX;
+    }
+    for (i = 0; i < sourcep->slots; i++) t->key[i] = 0UL;
+    t->len = LONG_MAX;
+
+    return pushed;
+
+} /* end ctreestack_transfer() */
+
+/**********
+
+=head1 ctreestack_free - DEALLOCATE CONCURRENT TREE STACK
+
+=head2 SYNOPSIS
+
+    void ctreestack_free(Ctreestack *sp);
+
+=head2 DESCRIPTION
+
+Deallocate dynamically allocated heap memory associated with a
+concurrent tree stack. Must not be called while other threads use it.
+
+=head2 PARAMETERS
+
+=head3 INOUT
+
+=over 4
+
+=item sp
+
+The stack to be deallocated.
+
+=back
+
+=head2 RETURN
+
+None.
+
+=cut
+
+**********/
+
+void ctreestack_free(Ctreestack *sp)
+{
+    long i;	/* loop counter */
+
+    for (i = 0; i < CTREESTACK_SHARDS; i++) {
+	treestack_free(&sp->shard[i]);
+#ifdef _OPENMP
+	omp_destroy_lock(&sp->shard_lock[i]);
+#endif
+    }
+    free(sp->shard);
+    free(sp->shard_len);
+#ifdef _OPENMP
+    free(sp->shard_lock);
+#endif
+    free(sp->table->key);
+    free(sp->table);
+    free(sp->spare->key);
+    free(sp->spare);
+    sp->table = NULL;
+    sp->spare = NULL;
+    sp->shard = NULL;
+
+} /* end ctreestack_free() */
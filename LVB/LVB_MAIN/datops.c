@@ -23,52 +23,131 @@ static void cutmsg(const Lvb_bool *const togo, const long m,
  const char *const msg);
 static void logcut(const Lvb_bool *const cut, const long m);
 
-static char *getstatev(const Dataptr matrix, const long k)
-/* return pointer to string containing 1 instance of each character state in
- * column k of matrix, or NULL if more than MAXSTATES states are
- * found; ignores the special meaning of ambiguity codes or gaps, so can return
- * NULL if these are present;
- * N.B. string is static and will be overwritten by later calls */
+static const unsigned char *pattern_cols;	/* columns for colcmp() */
+static long pattern_n;				/* length of each */
+
+#define STATESETS (A_BIT | C_BIT | G_BIT | T_BIT | O_BIT)	/* bits used */
+#define MASK_BLOCK 4096L	/* columns of masks updated together */
+
+long popcount(unsigned long x)
+/* return the number of bits set in x */
 {
-    static char statev[MAXSTATES + 1];	/* array of states */
-    long statec;			/* number of states */
-    long i;				/* loop counter */
+#ifdef __GNUC__
+    return (long) __builtin_popcountl(x);
+#else
+    long cnt = 0;	/* return value */
+
+    while (x != 0UL) {
+	x &= x - 1UL;
+	cnt++;
+    }
+    return cnt;
+#endif /* #ifdef __GNUC__ */
+
+} /* end popcount() */
+
+static void sitemasks(const Dataptr matrix, unsigned long *mask)
+/* set element k of the matrix->m-element array mask to the set of
+ * statesets found in column k of matrix, bit s being set if stateset s
+ * is present; the rows must hold statesets, and are read in order, a
+ * block of columns at a time so that the masks being updated stay in
+ * cache */
+{
+    const unsigned char *row;	/* current row */
+    long first;			/* first column of current block */
+    long last;			/* last column of current block, plus 1 */
+    long i;			/* loop counter */
+    long k;			/* loop counter */
+
+#ifdef _OPENMP
+    #pragma omp parallel for private(row, last, i, k) schedule(static) \
+     if (matrix->m > MASK_BLOCK)
+#endif
+    for (first = 0; first < matrix->m; first += MASK_BLOCK)
+    {
+	last = first + MASK_BLOCK;
+	if (last > matrix->m)
+	    last = matrix->m;
+	for (k = first; k < last; k++)
+	    mask[k] = 0UL;
+	for (i = 0; i < matrix->n; i++)
+	{
+	    row = (const unsigned char *) matrix->row[i];
+	    for (k = first; k < last; k++)
+		mask[k] |= 1UL << (row[k] & STATESETS);
+	}
+    }
+
+} /* end sitemasks() */
+
+void minsteps_init(Dataptr matrix)
+/* set matrix->minsteps to a new matrix->m-element array giving the least
+ * number of changes in each column on any tree: one less than the fewest
+ * states that include a state of every stateset in the column, so that
+ * ambiguity codes and gaps are allowed for; the rows must hold statesets */
+{
+    unsigned long *mask;	/* statesets in each column */
+    unsigned long hits[STATESETS + 1];	/* element s: statesets sharing a
+					 * state with stateset s */
+    long best;			/* fewest states found for current column */
+    long k;			/* loop counter */
+    unsigned s;			/* loop counter */
+    unsigned t;			/* loop counter */
 
-    /* clear record of states */
-    statev[0] = '\0';
-    statec = 0;
+    for (s = 0; s <= STATESETS; s++)
+    {
+	hits[s] = 0UL;
+	for (t = 1; t <= STATESETS; t++)
+	    if ((s & t) != 0U)
+		hits[s] |= 1UL << t;
+    }
 
-    /* update record of states for column k */
-    for (i = 0; i < matrix->n; ++i)
+    mask = alloc(matrix->m * sizeof(unsigned long), "state masks");
+    sitemasks(matrix, mask);
+    matrix->minsteps = alloc(matrix->m * sizeof(long), "minimum changes");
+    for (k = 0; k < matrix->m; k++)
     {
-	if (strchr(statev, (int) matrix->row[i][k]) == NULL)	/* new state */
+	best = MAXSTATES;
+	for (s = 1; s <= STATESETS; s++)
 	{
-	    statev[statec++] = matrix->row[i][k];
-	    if (statec > MAXSTATES)
-		 return NULL;
-	    statev[statec] = '\0';	/* for strchr() */
+	    if (((mask[k] & ~hits[s]) == 0UL) && (popcount(s) < best))
+		best = popcount(s);
 	}
+	matrix->minsteps[k] = best - 1;
     }
-	
-    return statev;
+    free(mask);
 
-} /* end getstatev() */
+} /* end minsteps_init() */
 
-long getminlen(const Dataptr matrix)
-/* return minimum length of any tree based on matrix; FIXME not quite right
- * with ambiguity or gaps */
+long getminlen(const Dataptr matrix, const long *weights)
+/* return minimum length of any tree based on matrix, using weights in
+ * weights, or weight 1 for every column if weights is NULL; the least
+ * changes in each column are found by minsteps_init(), if it has not
+ * been called for matrix already */
 {
     long minlen = 0;	/* return value */
-    char *statev;	/* list of states in current character */
     long k;		/* loop counter */
+    Lvb_bool local;	/* minsteps set here, not kept */
 
-    for (k = 0; k < matrix->m; ++k)
+    local = (matrix->minsteps == NULL) ? LVB_TRUE : LVB_FALSE;
+    if (local == LVB_TRUE)
+	minsteps_init(matrix);
+
+    if (weights == NULL)
     {
-	statev = getstatev(matrix, k);
-	if (statev == NULL)
-	    minlen += MAXSTATES;
-	else
-	    minlen += strlen(statev) - 1;
+	for (k = 0; k < matrix->m; k++)
+	    minlen += matrix->minsteps[k];
+    }
+    else
+    {
+	for (k = 0; k < matrix->m; k++)
+	    minlen += weights[k] * matrix->minsteps[k];
+    }
+
+    if (local == LVB_TRUE)
+    {
+	free(matrix->minsteps);
+	matrix->minsteps = NULL;
     }
     return minlen;
 
@@ -76,6 +155,94 @@ long getminlen(const Dataptr matrix)
 
 /**********
 
+=head1 dna_lut - MAKE LOOKUP TABLE FROM DNA TEXT TO BINARY STATESETS
+
+=head2 SYNOPSIS
+
+    void dna_lut(unsigned char *lut, Lvb_bool fifthstate);
+
+=head2 DESCRIPTION
+
+Fills a 256-element table giving the binary-encoded stateset for each
+character, as described for C<dna_makebin()>. Lowercase letters are
+given the same statesets as uppercase. Characters that are not valid
+bases, ambiguity codes, C<?>, C<O> or C<-> are given the empty stateset,
+0.
+
+=head2 PARAMETERS
+
+=head3 INPUT
+
+=over 4
+
+=item fifthstate
+
+If C<LVB_TRUE>, treat gaps indicated by C<-> as identical to C<O>. Otherwise,
+treat gaps indicated by C<-> as identical to <?>, i.e., totally ambiguous.
+
+=back
+
+=head3 OUTPUT
+
+=over 4
+
+=item lut
+
+Must point to the first element of an array of 256 elements. On return,
+C<lut>[(unsigned char) I<c>] gives the stateset for character I<c>.
+
+=back
+
+=cut
+
+**********/
+
+void dna_lut(unsigned char *lut, Lvb_bool fifthstate)
+{
+    long i;	/* loop counter */
+
+    for (i = 0; i < 256; i++)
+	lut[i] = 0U;
+
+    /* unambiguous bases */
+    lut['A'] = A_BIT;
+    lut['C'] = C_BIT;
+    lut['G'] = G_BIT;
+    lut['T'] = T_BIT;
+    lut['U'] = T_BIT;	/* treat the same as 'T' */
+
+    /* ambiguous bases */
+    lut['Y'] = C_BIT | T_BIT;
+    lut['R'] = A_BIT | G_BIT;
+    lut['W'] = A_BIT | T_BIT;
+    lut['S'] = C_BIT | G_BIT;
+    lut['K'] = T_BIT | G_BIT;
+    lut['M'] = C_BIT | A_BIT;
+    lut['B'] = C_BIT | G_BIT | T_BIT;
+    lut['D'] = A_BIT | G_BIT | T_BIT;
+    lut['H'] = A_BIT | C_BIT | T_BIT;
+    lut['V'] = A_BIT | C_BIT | G_BIT;
+    lut['N'] = A_BIT | C_BIT | G_BIT | T_BIT;
+    lut['X'] = A_BIT | C_BIT | G_BIT | T_BIT;
+
+    /* total ambiguity */
+    lut['?'] = A_BIT | C_BIT | G_BIT | T_BIT | O_BIT;
+
+    /* deletion */
+    lut['O'] = O_BIT;
+    if (fifthstate == LVB_TRUE)
+	lut['-'] = O_BIT;
+    else
+	lut['-'] = A_BIT | C_BIT | G_BIT | T_BIT | O_BIT;
+
+    /* lowercase as uppercase */
+    for (i = 'A'; i <= 'Z'; i++)
+	lut[tolower(i)] = lut[i];
+
+} /* end dna_lut() */
+
+/**********
+
 =head1 dna_makebin - CONVERT DNA TEXT MATRIX TO BINARY STATESET MATRIX
 
 =head2 SYNOPSIS
@@ -89,7 +256,8 @@ Converts a matrix of sequence strings to a matrix of binary-encoded
 statesets, where each of A, C, T, G and O (deletion) is represented by
 a different bit. Ambiguous bases are converted to the union of all the
 bases they may represent. C<?> is treated as totally ambiguous and
-C<-> is either treated as <?> or as <O>.
+C<-> is either treated as <?> or as <O>. The conversion is by the table
+from C<dna_lut()>.
 
 =head2 PARAMETERS
 
@@ -136,98 +304,91 @@ void dna_makebin(const Dataptr mat, Lvb_bool fifthstate,
 {
     long i;			/* loop counter */
     long j;			/* loop counter */
-    char base;			/* current base as text character */
-    unsigned char sset = 0U;	/* binary-encoded state set */
+    unsigned char lut[256];	/* stateset for each character */
+    const unsigned char *row;	/* current row as unsigned characters */
+    unsigned char *enc_row;	/* current encoded row */
 
+    dna_lut(lut, fifthstate);
     for (i = 0; i < mat->n; i++)
     {
+	row = (const unsigned char *) mat->row[i];
+	enc_row = enc_mat[i];
         for (j = 0; j < mat->m; j++)
 	{
-	    base = mat->row[i][j];
-
-	    /* unambiguous bases */
-	    if (base == 'A')
-	    	sset = A_BIT;
-	    else if (base == 'C')
-	        sset = C_BIT;
-	    else if (base == 'G')
-	        sset = G_BIT;
-	    else if (base == 'T')
-	    	sset = T_BIT;
-	    else if (base == 'U')	/* treat the same as 'U' */
-	        sset = T_BIT;
-
-	    /* ambiguous bases */
-	    else if (base == 'Y')
-	        sset = C_BIT | T_BIT;
-	    else if (base == 'R')
-		sset = A_BIT | G_BIT;
-	    else if (base == 'W')
-	    	sset = A_BIT | T_BIT;
-	    else if (base == 'S')
-	    	sset = C_BIT | G_BIT;
-	    else if (base == 'K')
-	    	sset = T_BIT | G_BIT;
-	    else if (base == 'M')
-	    	sset = C_BIT | A_BIT;
-	    else if (base == 'B')
-	    	sset = C_BIT | G_BIT | T_BIT;
-	    else if (base == 'D')
-	    	sset = A_BIT | G_BIT | T_BIT;
-	    else if (base == 'H')
-	    	sset = A_BIT | C_BIT | T_BIT;
-    	    else if (base == 'V')
-	    	sset = A_BIT | C_BIT | G_BIT;
-	    else if (base == 'N')
-	    	sset = A_BIT | C_BIT | G_BIT | T_BIT;
-	    else if (base == 'X')
-	    	sset = A_BIT | C_BIT | G_BIT | T_BIT;
-
-	    /* total ambiguity */
-	    else if (base == '?')
-	    	sset = A_BIT | C_BIT | G_BIT | T_BIT | O_BIT;
-
-	    /* deletion */
-	    else if (base == 'O')
-	    	sset = O_BIT;
-	    else if (base == '-')
-            {
-		if (fifthstate == LVB_TRUE)
-		{
-		    sset = O_BIT;
-                }
-                else
-                {
-		    sset = A_BIT | C_BIT | G_BIT | T_BIT | O_BIT;
-		}
-	    }
-	    lvb_assert(sset != 0U);
-	    enc_mat[i][j] = sset;
+	    enc_row[j] = lut[row[j]];
+	    lvb_assert(enc_row[j] != 0U);
 	}
     }
 } /* end dna_makebin() */
 
 void rowfree(Dataptr matrix)
 /* free memory used for row strings and array of row strings in matrix,
- * and make the array of row title strings NULL;
- * or, if the array of row title strings is already NULL, do nothing */
+ * whether the rows are in one block or not, and make the array of row
+ * strings NULL; or, if the array of row strings is already NULL, do
+ * nothing; also free the array of least changes per column, if any */
 {
     long i;	/* loop counter */
 
+    if (matrix->minsteps != NULL)
+    {
+	free(matrix->minsteps);
+	matrix->minsteps = NULL;
+    }
+
     if (matrix->row != NULL)
     {
-	for(i = 0; i < matrix->n; ++i)
-	    free(matrix->row[i]);
+	if (matrix->rowblock != NULL)
+	    free(matrix->rowblock);
+	else
+	{
+	    for(i = 0; i < matrix->n; ++i)
+		free(matrix->row[i]);
+	}
 	free(matrix->row);
 	matrix->row = NULL;
+	matrix->rowblock = NULL;
     }
 
 } /* end rowfree() */
 
+void rowpack(Dataptr matrix)
+/* move the row strings of matrix into one block of matrix->n strings of
+ * matrix->m characters each, and point the rows into it; memory left
+ * over from longer rows, e.g. from columns since cut, is freed */
+{
+    long i;		/* loop counter */
+    size_t width;	/* bytes per row in the block */
+    char *block;	/* new block */
+
+    width = (size_t) matrix->m + 1;
+    if (matrix->rowblock != NULL)	/* close up the rows in place */
+    {
+	for (i = 0; i < matrix->n; i++)
+	    memmove(matrix->rowblock + i * width, matrix->row[i], width);
+	block = realloc(matrix->rowblock, matrix->n * width);
+	if (block == NULL)
+	    block = matrix->rowblock;	/* could not shrink; still valid */
+    }
+    else	/* copy each row, then free it */
+    {
+	block = alloc(matrix->n * width, "data matrix");
+	for (i = 0; i < matrix->n; i++)
+	{
+	    memcpy(block + i * width, matrix->row[i], width);
+	    free(matrix->row[i]);
+	}
+    }
+
+    matrix->rowblock = block;
+    for (i = 0; i < matrix->n; i++)
+	matrix->row[i] = block + i * width;
+
+} /* end rowpack() */
+
 Dataptr matalloc(const long n)
 /* return pointer to new matrix, with n pointers to rows and row titles;
- * the strings in these arrays, and the array of state counts, are not
- * allocated for and are initialized to NULL;
+ * the strings in these arrays, and the array of least changes per column,
+ * are not allocated for and are initialized to NULL;
  * one may free the memory for matrix struct itself and arrays of pointers
  & using the standard library function free(). */
 {
@@ -254,6 +415,8 @@ Dataptr matalloc(const long n)
     /* initialize scalars to zero */
     mat->m = 0;
     mat->n = 0;
+    mat->minsteps = NULL;
+    mat->rowblock = NULL;
 
     mat->row = l_row;	/* now can be freed e.g. by rowfree() */
 
@@ -264,30 +427,27 @@ Dataptr matalloc(const long n)
 static void constchar(const Dataptr matrix, Lvb_bool *const togo,
  const Lvb_bool verbose, Lvb_bool *scratch)
 /* Make sure matrix->m-element array togo is LVB_TRUE where matrix column
- * contains only one character state;
+ * contains only one stateset;
  * log details of new columns to ignore if verbose is LVB_TRUE.
  * scratch must point to the first element of an array of at least matrix->m
  * elements or arbitrary (even uninitialised) contents. It will be left with
  * arbitrary contents on return. */
 {
     long k;		/* loop counter */
-    long i;		/* loop counter */
     Lvb_bool *isconst = scratch;	/* LVB_TRUE where col. is constant */
+    unsigned long *mask;	/* statesets in each column */
 
-    /* local array of columns to go */
-    /* initialize all elements to LVB_TRUE ('ignore') */
+    /* a column is constant if one bit of its mask is set */
+    mask = alloc(matrix->m * sizeof(unsigned long), "state masks");
+    sitemasks(matrix, mask);
     for (k = 0; k < matrix->m; k++)
-	isconst[k] = LVB_TRUE;
-
-    /* discover variable columns */
-    for (i = 1; i < matrix->n; ++i)
     {
-	for (k = 0; k < matrix->m; ++k)
-	{
-	    if (matrix->row[i][k] != matrix->row[0][k])
-		isconst[k] = LVB_FALSE;
-	}
+	if ((mask[k] & (mask[k] - 1UL)) == 0UL)
+	    isconst[k] = LVB_TRUE;
+	else
+	    isconst[k] = LVB_FALSE;
     }
+    free(mask);
 
     /* update togo, for caller */
     for (k = 0; k < matrix->m; ++k)
@@ -322,9 +482,12 @@ static void cutmsg(const Lvb_bool *const togo, const long m,
 
 } /* end cutmsg() */
 
-void matchange(Dataptr matrix, const Params rcstruct, const Lvb_bool verbose)
+void matchange(Dataptr matrix, const Params rcstruct,
+ const Lvb_bool *const isconst, const Lvb_bool verbose)
 /* change and remove columns in matrix, partly in response to rcstruct,
- * verbosely or not according to value of verbose */
+ * verbosely or not according to value of verbose; if isconst is not NULL,
+ * it is the matrix->m-element array of constant columns already found, e.g.
+ * while reading the matrix, and is used instead of looking again */
 {
     static Lvb_bool *togo;	/* LVB_TRUE where column must go */
     static Lvb_bool *scratch;	/* scratch space for called fns */
@@ -344,7 +507,14 @@ void matchange(Dataptr matrix, const Params rcstruct, const Lvb_bool verbose)
     for (k = 0; k < matrix->m; k++)
 	togo[k] = LVB_FALSE;
 
-    constchar(matrix, togo, verbose, scratch);	/* compuslory cut */
+    if (isconst == NULL)
+	constchar(matrix, togo, verbose, scratch);	/* compuslory cut */
+    else {
+	for (k = 0; k < matrix->m; k++)
+	    togo[k] = isconst[k];
+	if (verbose == LVB_TRUE)
+	    cutmsg(togo, matrix->m, "Ignoring constant columns");
+    }
 
     /* N.B. a function to mark autapomorphic characters for cutting
      * could be called at this point. The effect would be more noticable
@@ -373,9 +543,10 @@ void matchange(Dataptr matrix, const Params rcstruct, const Lvb_bool verbose)
 static long cutcols(Dataptr matrix, const Lvb_bool *const tocut)
 /* remove columns in matrix for which the corresponding element of
 matrix->m-element array tocut is LVB_TRUE, and update matrix->m;
-return the number of columns cut */
+return the number of columns cut; each row is closed up in place, so
+no second copy of the matrix is made */
 {
-    char **newrow;			/* rows of reduced matrix */
+    char *row;				/* current row */
     long i;				/* loop counter */
     long newm;				/* new number of columns */
     const long oldm = matrix->m;	/* old number of columns */
@@ -394,65 +565,180 @@ return the number of columns cut */
     if (newm == matrix->m)
 	return 0;
 
-    /* memory for new matrix row array */
-    newrow = alloc((size_t) (matrix->n + 1) * sizeof(char *),
-     "pointers to new row strings");
-    for (i = 0; i < matrix->n; ++i)
-	newrow[i] = salloc(newm, "new row strings");
-    newrow[matrix->n] = NULL;
-
-    newk = 0;
-    for (k = 0; k < matrix->m; ++k)	/* for every column */
+    for (i = 0; i < matrix->n; ++i)	/* for every row */
     {
-	if (tocut[k] == LVB_FALSE)	/* keep this column */
+	row = matrix->row[i];
+	newk = 0;
+	for (k = 0; k < matrix->m; ++k)
 	{
-	    for (i = 0; i < matrix->n; ++i)	/* fill for ea. row */
-		newrow[i][newk] = matrix->row[i][k];
-	    ++newk;	/* fill next row next time */
+	    if (tocut[k] == LVB_FALSE)	/* keep this column */
+		row[newk++] = row[k];
 	}
-    }
 
-    /* trap impossible condition */
-    lvb_assert(newk == newm);
+	/* trap impossible condition */
+	lvb_assert(newk == newm);
 
-    /* terminate new row strings */
-    for (i = 0; i < matrix->n; ++i)
-	newrow[i][newk] = '\0';
+	row[newk] = '\0';	/* terminate new row string */
+    }
 
     /* update matrix structure */
-    rowfree(matrix);
-    matrix->row = newrow;
     matrix->m = newm;
 
     return (oldm - newm);
 
 } /* end cutcols() */
 
-void get_bootstrap_weights(long *weight_arr, long m, long extras)
+static int colcmp(const void *a, const void *b)
+/* compare the columns of pattern_cols whose numbers are pointed to by a
+ * and b, for qsort(); identical columns are ordered by number */
+{
+    const long ka = *(const long *) a;	/* first column */
+    const long kb = *(const long *) b;	/* second column */
+    int val;				/* return value */
+
+    val = memcmp(pattern_cols + ka * pattern_n, pattern_cols + kb * pattern_n,
+     (size_t) pattern_n);
+    if (val == 0)
+	val = (ka < kb) ? -1 : 1;
+    return val;
+
+} /* end colcmp() */
+
+long merge_patterns(Dataptr matrix, long *count)
+/* merge each set of identical columns in matrix into the first of them,
+ * keeping the columns in their original order, and set the first matrix->m
+ * elements of count to the number of original columns that each remaining
+ * column stands for, to be used as its weight; update matrix->m, and
+ * return the number of columns merged away */
+{
+    const long m = matrix->m;	/* old number of columns */
+    const long n = matrix->n;	/* number of rows */
+    unsigned char *cols;	/* matrix column by column */
+    long *order;		/* column numbers, sorted by column */
+    long *first;		/* element k: first column identical to column k */
+    long *newk;			/* element k: new number of column k, if kept */
+    char *row;			/* current row */
+    long i;			/* loop counter */
+    long j;			/* loop counter */
+    long k;			/* loop counter */
+    long newm = 0;		/* new number of columns */
+
+    cols = alloc(m * n, "matrix columns");
+    order = alloc(m * sizeof(long), "sorted columns");
+    first = alloc(m * sizeof(long), "first identical columns");
+    newk = alloc(m * sizeof(long), "new column numbers");
+
+    for (i = 0; i < n; i++)
+    {
+	for (k = 0; k < m; k++)
+	    cols[k * n + i] = (unsigned char) matrix->row[i][k];
+    }
+    for (k = 0; k < m; k++)
+	order[k] = k;
+    pattern_cols = cols;
+    pattern_n = n;
+    qsort(order, (size_t) m, sizeof(long), colcmp);
+
+    /* in sorted order, identical columns are together, first one first */
+    for (j = 0; j < m; j++)
+    {
+	if ((j > 0) && (memcmp(cols + order[j] * n, cols + order[j - 1] * n,
+	 (size_t) n) == 0))
+	    first[order[j]] = first[order[j - 1]];
+	else
+	    first[order[j]] = order[j];
+    }
+
+    for (k = 0; k < m; k++)
+    {
+	if (first[k] == k)
+	{
+	    newk[k] = newm;
+	    count[newm++] = 0;
+	}
+	count[newk[first[k]]]++;
+    }
+
+    /* close up each row in place, as in cutcols() */
+    for (i = 0; i < n; i++)
+    {
+	row = matrix->row[i];
+	for (k = 0; k < m; k++)
+	{
+	    if (first[k] == k)
+		row[newk[k]] = row[k];
+	}
+	row[newm] = '\0';
+    }
+    matrix->m = newm;
+
+    free(cols);
+    free(order);
+    free(first);
+    free(newk);
+    return m - newm;
+
+} /* end merge_patterns() */
+
+void get_bootstrap_weights(long *weight_arr, const long *count, long m,
+ long extras)
 /* Fill first m elements of array whose first element is pointed to by
  * weight_arr with weights for a single bootstrap resample. This is
  * obtained on the assumption that extras constant characters were in
  * the original sequence, but are not represented in weight_arr. This
  * gives a bootstrap sample with these constant characters effectively
- * included. */
+ * included. If count is not NULL, element k of weight_arr stands for
+ * count[k] sites of the original sequence, as after merge_patterns(),
+ * and each is sampled separately; otherwise each stands for one site. */
 {
     long samples = 0;	/* size of the sample so far */
     long i;		/* loop counter */
     long site;		/* number of current site to add to sample */
+    long sites = m;	/* sites represented in weight_arr */
+    long *upto = NULL;	/* element k: sites represented up to element k */
+    long lo;		/* lowest element that may hold current site */
+    long hi;		/* highest element that may hold current site */
+    long mid;		/* element between lo and hi */
 
     for (i = 0; i < m; i++)
 	weight_arr[i] = 0;
 
-    while (samples < (m + extras))
+    if (count != NULL)
     {
-	site = randpint(m + extras - 1);
-	if (site < m)
+	upto = alloc(m * sizeof(long), "sites up to each pattern");
+	sites = 0;
+	for (i = 0; i < m; i++)
 	{
+	    sites += count[i];
+	    upto[i] = sites;
+	}
+    }
+
+    while (samples < (sites + extras))
+    {
+	site = randpint(sites + extras - 1);
+	if (site < sites)
+	{
+	    if (count != NULL)	/* first element holding this site */
+	    {
+		lo = 0;
+		hi = m - 1;
+		while (lo < hi)
+		{
+		    mid = (lo + hi) / 2;
+		    if (upto[mid] > site) hi = mid;
+		    else lo = mid + 1;
+		}
+		site = lo;
+	    }
 	    weight_arr[site] += 1;
 	}
 	samples++;
     }
 
+    if (upto != NULL)
+	free(upto);
+
 } /* end get_bootstrap_weights() */
 
 static void logcut(const Lvb_bool *const cut, const long m)
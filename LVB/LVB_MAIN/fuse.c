@@ -0,0 +1,438 @@
+/* LVB
+ * (c) Copyright 2003-2012 by Daniel Barker.
+ * (c) Copyright 2013, 2014 by Daniel Barker and Maximilian Strobl.
+ * Permission is granted to copy and use this program provided that no fee is
+ * charged for it and provided that this copyright notice is not removed. */
+
+/**********
+
+=head1 NAME
+
+fuse.c - tree fusing
+
+=head1 DESCRIPTION
+
+Combines good trees from separate searches, by exchanging the
+resolution of clades they share (Goloboff 1999).
+
+=cut
+
+**********/
+
+#include "lvb.h"
+
+typedef struct	/* the clade below a branch */
+{
+    unsigned long key;	/* sum of hashes of its objects */
+    long size;		/* number of its objects */
+    long len;		/* changes within it */
+} Clade;
+
+typedef struct	/* internal branch of a tree, for look-up by its clade */
+{
+    unsigned long key;	/* key of its clade */
+    long size;		/* objects in its clade */
+    long branch;	/* the branch */
+} Clade_entry;
+
+typedef struct	/* scratch space for tree fusing */
+{
+    long *order_a;		/* internal branches of tree a, in postorder */
+    long *order_b;		/* internal branches of tree b, in postorder */
+    long *todo;			/* stack of branches to visit */
+    long *inner_a;		/* internal branches of a clade of a */
+    long *inner_b;		/* internal branches of a clade of b */
+    long *leaf;			/* leaves of a clade of a */
+    long *leaf_b;		/* leaves of a clade of b */
+    long *map;			/* element i: branch of a for branch i of b */
+    Clade *clade_a;		/* element i: clade below branch i of a */
+    Clade *clade_b;		/* element i: clade below branch i of b */
+    Clade_entry *table;		/* internal branches of a, sorted by clade */
+    Branch *saved;		/* old links of inner_a */
+} Fuse_work;
+
+static int entrycmp(const void *e1, const void *e2)
+/* compare clade entries by key and then size, for qsort() and bsearch() */
+{
+    const Clade_entry *c1 = (const Clade_entry *) e1;	/* 1st entry */
+    const Clade_entry *c2 = (const Clade_entry *) e2;	/* 2nd entry */
+
+    if (c1->key < c2->key) return -1;
+    else if (c1->key > c2->key) return 1;
+    else if (c1->size < c2->size) return -1;
+    else if (c1->size > c2->size) return 1;
+    else return 0;
+
+} /* end entrycmp() */
+
+static long postorder(const Branch *const tree, const long root, const long n,
+    long *const order, long *const todo)
+/* fill order with the internal branches of tree (of root root), every
+ * branch after its descendants, using todo as a stack; return their
+ * number */
+{
+    long cnt = 0;	/* branches in order */
+    long top = 0;	/* branches in todo */
+    long b;		/* current branch */
+    long i;		/* loop counter */
+    long tmp;		/* for swapping */
+
+    todo[top++] = tree[root].left;
+    todo[top++] = tree[root].right;
+    while (top > 0) {
+	b = todo[--top];
+	if (b < n) continue;
+	order[cnt++] = b;
+	todo[top++] = tree[b].left;
+	todo[top++] = tree[b].right;
+    }
+
+    /* preorder reversed */
+    for (i = 0; i < cnt / 2; i++) {
+	tmp = order[i];
+	order[i] = order[cnt - 1 - i];
+	order[cnt - 1 - i] = tmp;
+    }
+    return cnt;
+
+} /* end postorder() */
+
+static void clade_info(const Branch *const tree, const long n,
+    const long *const order, const long cnt, Clade *const clade)
+/* fill clade with the clade below every branch of tree, whose cnt internal
+ * branches are in postorder in order; tree must be clean */
+{
+    long i;	/* loop counter */
+    long b;	/* current branch */
+    long l;	/* left child of b */
+    long r;	/* right child of b */
+
+    for (i = 0; i < n; i++) {
+	clade[i].key = hashmix((unsigned long) i + 1UL);
+	clade[i].size = 1;
+	clade[i].len = 0;
+    }
+    for (i = 0; i < cnt; i++) {
+	b = order[i];
+	l = tree[b].left;
+	r = tree[b].right;
+	clade[b].key = clade[l].key + clade[r].key;
+	clade[b].size = clade[l].size + clade[r].size;
+	clade[b].len = clade[l].len + clade[r].len + tree[b].changes;
+    }
+
+} /* end clade_info() */
+
+static long clade_index(const Branch *const tree, const long root, const long n,
+    Fuse_work *const w)
+/* fill w->order_a, w->clade_a and w->table for tree (of root root), which
+ * must be clean; return its number of internal branches */
+{
+    long cnt;	/* internal branches */
+    long i;	/* loop counter */
+    long b;	/* current branch */
+
+    cnt = postorder(tree, root, n, w->order_a, w->todo);
+    clade_info(tree, n, w->order_a, cnt, w->clade_a);
+    for (i = 0; i < cnt; i++) {
+	b = w->order_a[i];
+	w->table[i].key = w->clade_a[b].key;
+	w->table[i].size = w->clade_a[b].size;
+	w->table[i].branch = b;
+    }
+    qsort(w->table, cnt, sizeof(Clade_entry), entrycmp);
+    return cnt;
+
+} /* end clade_index() */
+
+static long clade_branches(const Branch *const tree, const long top, const long n,
+    long *const inner, long *const leaf, long *const todo)
+/* fill inner with the internal branches below top in tree, and leaf with
+ * the leaves of the clade of top, using todo as a stack; return the number
+ * of internal branches */
+{
+    long cnt = 0;	/* branches in inner */
+    long lcnt = 0;	/* branches in leaf */
+    long top_cnt = 0;	/* branches in todo */
+    long b;		/* current branch */
+
+    todo[top_cnt++] = tree[top].left;
+    todo[top_cnt++] = tree[top].right;
+    while (top_cnt > 0) {
+	b = todo[--top_cnt];
+	if (b < n) leaf[lcnt++] = b;
+	else {
+	    inner[cnt++] = b;
+	    todo[top_cnt++] = tree[b].left;
+	    todo[top_cnt++] = tree[b].right;
+	}
+    }
+    return cnt;
+
+} /* end clade_branches() */
+
+static void clade_dirty(Branch *const a, const long root, const long x,
+    const long *const inner, const long cnt)
+/* mark dirty the cnt branches in inner, branch x and its ancestors in a (of
+ * root root) */
+{
+    long i;	/* loop counter */
+    long b;	/* current branch */
+
+    for (i = 0; i < cnt; i++) a[inner[i]].sset[0] = 0U;
+    for (b = x; b != root; b = a[b].parent) a[b].sset[0] = 0U;
+
+} /* end clade_dirty() */
+
+static Lvb_bool clade_swap(Dataptr matrix, Branch *const a, const long root,
+    const long x, const Branch *const b, const long y, long *const lenp,
+    const long *weights, Fuse_work *const w)
+/* give the clade of branch x of tree a (of root root and length *lenp) the
+ * resolution of the clade of branch y of tree b, which must have the same
+ * objects and be rooted at the same object; keep it, updating *lenp, if a
+ * is then no longer, and return LVB_TRUE; otherwise put back the old
+ * resolution and return LVB_FALSE */
+{
+    const long n = matrix->n;	/* objects */
+    long cnt;			/* internal branches below x */
+    long i;			/* loop counter */
+    long z;			/* current branch of a */
+    long len;			/* length after swap */
+    long x_left = a[x].left;	/* old left child of x */
+    long x_right = a[x].right;	/* old right child of x */
+    long *leaf_parent;		/* old parents of leaves of clade */
+
+    cnt = clade_branches(a, x, n, w->inner_a, w->leaf, w->todo);
+    i = clade_branches(b, y, n, w->inner_b, w->leaf_b, w->todo);
+    lvb_assert(i == cnt);
+
+    /* branches of b's clade to those of a's: leaves are the same in both,
+     * unless clade keys have collided */
+    for (i = 0; i < cnt + 2; i++) w->map[w->leaf_b[i]] = UNSET;
+    for (i = 0; i < cnt + 2; i++) w->map[w->leaf[i]] = w->leaf[i];
+    for (i = 0; i < cnt + 2; i++) if (w->map[w->leaf_b[i]] == UNSET) return LVB_FALSE;
+    w->map[y] = x;
+    for (i = 0; i < cnt; i++) w->map[w->inner_b[i]] = w->inner_a[i];
+
+    /* old links, with the leaves' old parents kept in the todo stack */
+    leaf_parent = w->todo;
+    for (i = 0; i < cnt; i++) w->saved[i] = a[w->inner_a[i]];
+    for (i = 0; i < cnt + 2; i++) leaf_parent[i] = a[w->leaf[i]].parent;
+
+    a[x].left = w->map[b[y].left];
+    a[x].right = w->map[b[y].right];
+    for (i = 0; i < cnt; i++) {
+	z = w->map[w->inner_b[i]];
+	a[z].parent = w->map[b[w->inner_b[i]].parent];
+	a[z].left = w->map[b[w->inner_b[i]].left];
+	a[z].right = w->map[b[w->inner_b[i]].right];
+    }
+    for (i = 0; i < cnt + 2; i++) a[w->leaf[i]].parent = w->map[b[w->leaf[i]].parent];
+    clade_dirty(a, root, x, w->inner_a, cnt);
+    len = getplen(a, root, matrix->m, n, weights);
+    if (len <= *lenp) {
+	*lenp = len;
+	return LVB_TRUE;
+    }
+
+    /* longer: put back the old resolution */
+    a[x].left = x_left;
+    a[x].right = x_right;
+    for (i = 0; i < cnt; i++) {
+	z = w->inner_a[i];
+	a[z].parent = w->saved[i].parent;
+	a[z].left = w->saved[i].left;
+	a[z].right = w->saved[i].right;
+    }
+    for (i = 0; i < cnt + 2; i++) a[w->leaf[i]].parent = leaf_parent[i];
+    clade_dirty(a, root, x, w->inner_a, cnt);
+    len = getplen(a, root, matrix->m, n, weights);
+    lvb_assert(len == *lenp);
+    return LVB_FALSE;
+
+} /* end clade_swap() */
+
+static void fuse_pair(Dataptr matrix, Branch *const a, const long root,
+    long *const lenp, const Branch *const b, const long *weights,
+    Fuse_work *const w)
+/* give clades of tree a (of root root and length *lenp) the resolution of
+ * the same clades in tree b, rooted at the same object, wherever b's
+ * resolution has fewer changes and a is then no longer; update *lenp;
+ * both trees must be clean */
+{
+    const long n = matrix->n;	/* objects */
+    long cnt_a;			/* internal branches of a */
+    long cnt_b;			/* internal branches of b */
+    long i;			/* loop counter */
+    long y;			/* current branch of b */
+    Clade_entry key;		/* clade sought */
+    Clade_entry *found;		/* same clade in a */
+
+    cnt_b = postorder(b, root, n, w->order_b, w->todo);
+    clade_info(b, n, w->order_b, cnt_b, w->clade_b);
+    cnt_a = clade_index(a, root, n, w);
+
+    /* smaller clades first, so larger ones are compared after any change
+     * within them */
+    for (i = 0; i < cnt_b; i++) {
+	y = w->order_b[i];
+	key.key = w->clade_b[y].key;
+	key.size = w->clade_b[y].size;
+	found = bsearch(&key, w->table, cnt_a, sizeof(Clade_entry), entrycmp);
+	if ((found != NULL) && (w->clade_b[y].len < w->clade_a[found->branch].len)) {
+	    if (clade_swap(matrix, a, root, found->branch, b, y, lenp, weights, w) == LVB_TRUE)
+		cnt_a = clade_index(a, root, n, w);
+	}
+    }
+
+} /* end fuse_pair() */
+
+/**********
+
+=head1 treefuse - COMBINE TREES BY TREE FUSING
+
+=head2 SYNOPSIS
+
+    long treefuse(Dataptr matrix, Treestack *sp, const long *weights);
+
+=head2 DESCRIPTION
+
+Combines up to C<FUSE_MAX_TREES> trees from the top of the stack C<*sp>
+into one tree, and returns its length.
+
+Starting from a shortest of these trees, each clade found in another tree
+replaces the same clade of the combined tree if it has fewer changes
+there, and the combined tree is kept whenever this leaves the whole tree
+no longer. Clades are compared by the sum of hashes of their objects.
+Passes over the trees continue while the combined tree gets shorter.
+
+If the combined tree is shorter than all the trees, it replaces the
+contents of C<*sp>. Otherwise it is pushed on to C<*sp> in addition to
+them, unless it is already there. Either way, the tree on top of C<*sp>
+is then of the length returned.
+
+=head2 PARAMETERS
+
+=head3 INPUT
+
+=over 4
+
+=item matrix
+
+The data matrix.
+
+=item weights
+
+Weights of the characters.
+
+=back
+
+=head3 INOUT
+
+=over 4
+
+=item sp
+
+The tree stack, whose trees must all have their leaves' state sets set.
+
+=back
+
+=head2 RETURN
+
+Returns the length of the combined tree.
+
+=cut
+
+**********/
+
+long treefuse(Dataptr matrix, Treestack *sp, const long *weights)
+{
+    const long n = matrix->n;		/* objects */
+    const long nbranches = brcnt(n);	/* branches per tree */
+    long cnt;				/* trees being fused */
+    long i;				/* loop counter */
+    long j;				/* loop counter */
+    long len;				/* length of fused tree */
+    long prev_len;			/* length at start of pass */
+    long lenbest = LONG_MAX;		/* length of shortest tree */
+    long best = 0;			/* a shortest tree */
+    long xroot;				/* root of fused tree */
+    long *root;				/* element i: root of tree i */
+    Branch **tree;			/* trees being fused */
+    Branch *x;				/* fused tree */
+    Fuse_work w;			/* scratch space */
+
+    cnt = treestack_cnt(*sp);
+    if (cnt > FUSE_MAX_TREES) cnt = FUSE_MAX_TREES;
+    lvb_assert(cnt >= 1);
+
+    /* "local" dynamic heap memory */
+    root = alloc(cnt * sizeof(long), "roots of trees to fuse");
+    tree = alloc(cnt * sizeof(Branch *), "trees to fuse");
+    x = treealloc(matrix);
+    w.order_a = alloc(n * sizeof(long), "branches in postorder");
+    w.order_b = alloc(n * sizeof(long), "branches in postorder");
+    w.todo = alloc(n * sizeof(long), "branches to visit");
+    w.inner_a = alloc(n * sizeof(long), "clade branches");
+    w.inner_b = alloc(n * sizeof(long), "clade branches");
+    w.leaf = alloc(n * sizeof(long), "clade leaves");
+    w.leaf_b = alloc(n * sizeof(long), "clade leaves");
+    w.map = alloc(nbranches * sizeof(long), "branch map");
+    w.clade_a = alloc(nbranches * sizeof(Clade), "clades");
+    w.clade_b = alloc(nbranches * sizeof(Clade), "clades");
+    w.table = alloc(n * sizeof(Clade_entry), "clade index");
+    w.saved = alloc(n * sizeof(Branch), "old links");
+
+    /* take the trees off the stack, all rooted as the first and scored
+     * afresh */
+    for (i = 0; i < cnt; i++) {
+	tree[i] = treealloc(matrix);
+	treestack_pop(matrix, tree[i], &root[i], sp);
+	if (root[i] != root[0]) lvb_reroot(tree[i], root[i], root[0]);
+	for (j = n; j < nbranches; j++) tree[i][j].sset[0] = 0U;
+	len = getplen(tree[i], root[0], matrix->m, n, weights);
+	if (len < lenbest) {
+	    lenbest = len;
+	    best = i;
+	}
+    }
+    xroot = root[0];
+    treecopy(matrix, x, tree[best]);
+    len = lenbest;
+
+    do {
+	prev_len = len;
+	for (i = 0; i < cnt; i++)
+	    if (i != best) fuse_pair(matrix, x, xroot, &len, tree[i], weights, &w);
+    } while (len < prev_len);
+
+    /* a tree of length len must end up on top */
+    if (len < lenbest) treestack_clear(sp);
+    else {
+	for (i = cnt - 1; i >= 0; i--)
+	    if (i != best) treestack_push(matrix, sp, tree[i], xroot);
+	treestack_push(matrix, sp, tree[best], xroot);
+    }
+    treestack_push(matrix, sp, x, xroot);
+
+    /* free "local" dynamic heap memory */
+    for (i = 0; i < cnt; i++) free(tree[i]);
+    free(tree);
+    free(root);
+    free(x);
+    free(w.order_a);
+    free(w.order_b);
+    free(w.todo);
+    free(w.inner_a);
+    free(w.inner_b);
+    free(w.leaf);
+    free(w.leaf_b);
+    free(w.map);
+    free(w.clade_a);
+    free(w.clade_b);
+    free(w.table);
+    free(w.saved);
+
+    return len;
+
+} /* end treefuse() */
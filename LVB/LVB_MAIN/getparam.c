@@ -43,6 +43,18 @@ static void defaults(Params *const prms)
  * defaults from lvb.h */
 {
     prms->bootstraps = 0;	/* sensible default */
+    prms->islands = ISLANDS;
+    prms->adaptive_moves = (ADAPTIVE_MOVES == 1) ? LVB_TRUE : LVB_FALSE;
+    prms->start_tree = START_TREE;
+    prms->ratchet = (RATCHET == 1) ? LVB_TRUE : LVB_FALSE;
+    prms->sectorial = (SECTORIAL == 1) ? LVB_TRUE : LVB_FALSE;
+    prms->fuse = (FUSE == 1) ? LVB_TRUE : LVB_FALSE;
+    prms->bandb = (BANDB == 1) ? LVB_TRUE : LVB_FALSE;
+    prms->matrix_cache = (MATRIX_CACHE == 1) ? LVB_TRUE : LVB_FALSE;
+    prms->site_patterns = (SITE_PATTERNS == 1) ? LVB_TRUE : LVB_FALSE;
+    prms->analytic_t0 = (ANALYTIC_T0 == 1) ? LVB_TRUE : LVB_FALSE;
+    prms->t0_group = BOOTSTRAP_T0_GROUP;
+    prms->warm_start = (BOOTSTRAP_WARM_START == 1) ? LVB_TRUE : LVB_FALSE;
 
     /* meaningful value that is not user-configurable */
      prms->verbose = VERBOSE_OUTPUT;
@@ -100,33 +112,78 @@ static void user_adjust(Params *prms)
 	break;
     }
 
-    /* cooling schedule */
+    /* cooling schedule, and other choices for the search */
     printf("\nPlease select a cooling schedule. The schedule chosen\n" 
      "will affect the quality and speed of the simulated annealing\n"
      "search. The GEOMETRIC schedule will take significantly less time,\n"
      "but may produce lower quality results. The LINEAR schedule may\n"
      "produce higher quality results, at the cost of increased runtime.\n"
-     "Currently, the DEFAULT is the GEOMETRIC schedule.\n");
+     "The ADAPTIVE schedule cools slowly where the tree length varies\n"
+     "most, and stops when changes for the worse are rarely accepted.\n"
+     "Currently, the DEFAULT is the GEOMETRIC schedule.\n"
+     "Instead of annealing, the PARSIMONY RATCHET may be used, which\n"
+     "alternates hill-climbing with the real and perturbed weights.\n"
+     "Before choosing, you may enter I to run several annealing searches,\n"
+     "or ISLANDS, at once, which exchange their best trees, and N, S or T\n"
+     "to start from a NEIGHBOUR-JOINING tree, a tree by STEPWISE addition,\n"
+     "or a random TREE.\n");
+    prms->cooling_schedule = -1;
     do
     {
-        printf("Enter G for GEOMETRIC or L for LINEAR\n"
-            "or press RETURN for default:\n");
+        printf("Enter G for GEOMETRIC, L for LINEAR or A for ADAPTIVE,\n"
+            "R for PARSIMONY RATCHET, I for ISLANDS,\n"
+            "N, S or T for the starting tree, or press RETURN for default:\n");
         read_line(buffer);
         if ((strcmp(buffer, "\n") == 0))
         {
             prms->cooling_schedule = 0;
             break;
         }
-    } while ((cistrcmp(buffer, "G\n") != 0) && (cistrcmp(buffer, "L\n") != 0));
-    switch (toupper(buffer[0]))
-    {
-    case 'G':
-	prms->cooling_schedule = 0;
-	break;
-    case 'L':
-	prms->cooling_schedule = 1;
-	break;
-    }
+        if (buffer[1] != '\n')
+            continue;
+        switch (toupper(buffer[0]))
+        {
+        case 'G':
+            prms->cooling_schedule = 0;
+            prms->ratchet = LVB_FALSE;
+            break;
+        case 'L':
+            prms->cooling_schedule = 1;
+            prms->ratchet = LVB_FALSE;
+            break;
+        case 'A':
+            prms->cooling_schedule = 2;
+            prms->ratchet = LVB_FALSE;
+            break;
+        case 'R':
+            prms->cooling_schedule = 0;
+            prms->ratchet = LVB_TRUE;
+            break;
+        case 'I':
+            do
+            {
+                printf("Enter the number of islands as an integer in the "
+                    "range 1 to %ld inclusive,\nor press RETURN for a single "
+                    "search:\n", MAX_ISLANDS);
+                read_line(buffer);
+                if ((strcmp(buffer, "\n") == 0))
+                    lval = 1;
+                else
+                    lval = strtol(buffer, NULL, 10);
+            } while ((lval < 1L) || (lval > MAX_ISLANDS));
+            prms->islands = lval;
+            break;
+        case 'N':
+            prms->start_tree = 2;
+            break;
+        case 'S':
+            prms->start_tree = 1;
+            break;
+        case 'T':
+            prms->start_tree = 0;
+            break;
+        }
+    } while (prms->cooling_schedule == -1);
 
     /* seed */
     printf("\nPlease specify a random number seed, or use default.\n"
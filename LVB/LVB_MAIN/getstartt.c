@@ -8,6 +8,25 @@
 
 #include "lvb.h"
 
+static long propose(Dataptr matrix, Branch *const xdash, const Branch *const x,
+	const long root, const long iter, const long m, const long n, const long *weights)
+/* put in xdash a change to the tree x (of root root), made by the mutation
+ * anneal() would use on iteration iter, and return its length */
+{
+    long lendash;	/* length of proposed new tree */
+
+	/* mutation: alternate between the two mutation functions */
+	if (iter % 2)
+		mutate_spr(matrix, xdash, x, root);	/* global change */
+	else
+		mutate_nni(matrix, xdash, x, root);	/* local change */
+
+	lendash = getplen(xdash, root, m, n, weights);
+	lvb_assert (lendash >= 1L);
+	return lendash;
+
+} /* end propose() */
+
 double get_initial_t(Dataptr matrix, const Branch *const inittree, long root, long m, long n,
 		const long *weights, Lvb_bool log_progress)
 /* Determine the starting temperature for the annealing search 
@@ -19,6 +38,14 @@ double get_initial_t(Dataptr matrix, const Branch *const inittree, long root, lo
  * using a sample of sample_size transitions. When the ratio reaches the 
  * desired value the search stops and the current temperature is 
  * returned as starting temperature.
+ * The next INITIAL_T_BATCH proposals from the current tree are made and
+ * scored at once, shared among the threads, each with its own random
+ * number stream seeded from the caller's; they are then taken in order
+ * until one is accepted, and the rest are discarded. Since the proposals
+ * from a given tree are independent, the sample is that of a serial
+ * chain. The batch does not depend on the number of threads, so for a
+ * given seed the result is the same however many threads are used, but
+ * differs from that of LVB versions that made one proposal at a time.
  * Note: The procedures for creating mutations and deciding on 
  * whether to accept them have been adopted from the anneal()
  * function.
@@ -29,15 +56,23 @@ double get_initial_t(Dataptr matrix, const Branch *const inittree, long root, lo
     long deltalen;		/* change in length with new tree */
     long iter;		/* iteration of mutate/evaluate loop */
     long len;			/* length of current tree */
-    long prev_len = UNSET;	/* length of previous tree */
-    long lendash;		/* length of proposed new tree */
     long lenmin;		/* minimum length for any tree */
     double pacc;		/* prob. of accepting new config. */
     double r_lenmin;		/* minimum length for any tree */
     long rootdash;		/* root of new configuration */
     double t = LVB_EPS;		/* current temperature */
     Branch *x;			/* current configuration */
-    Branch *xdash;		/* proposed new configuration */
+
+    /* Variables for making several proposals at once */
+    const long batch = INITIAL_T_BATCH;	/* most proposals made at once */
+    long batch_cnt;		/* proposals made at once this time */
+    long j;			/* loop counter */
+    long next_seed;		/* seed for caller's stream afterwards */
+    Branch **xdash;		/* element j: proposed new configuration j */
+    long *lendash;		/* element j: length of proposal j */
+    long *seed;			/* element j: seed for proposal j */
+    double *u;			/* element j: uniform deviate for proposal j */
+    Lvb_bool accepted;		/* accepted a proposal of the batch */
 
     /* Variables specific to the get_initial_temperature() procedure*/
     int acc_pos_trans = 0;        /* Number of accepted positve transitions */
@@ -45,16 +80,20 @@ double get_initial_t(Dataptr matrix, const Branch *const inittree, long root, lo
     int prop_pos_trans = 0;       /* Number of proposed positve transitions */
     double r_acc_to_prop = 0;   /* Ratio of accepted to proposed positve transitions */
     int sample_size = 100;                /* Sample size used to estimate the ratio */
-    
+
     /* Create "local" dynamic heap memory and initialise tree 
      * structures like in anneal() */
     x = treealloc(matrix);
-    xdash = treealloc(matrix);
+    xdash = alloc(batch * sizeof(Branch *), "proposed trees");
+    for (j = 0; j < batch; j++) xdash[j] = treealloc(matrix);
+    lendash = alloc(batch * sizeof(long), "proposed lengths");
+    seed = alloc(batch * sizeof(long), "proposal seeds");
+    u = alloc(batch * sizeof(double), "proposal deviates");
 
     treecopy(matrix, x, inittree);	/* current configuration */
     len = getplen(x, root, m, n, weights);
     
-    lenmin = getminlen(matrix);
+    lenmin = getminlen(matrix, weights);
     r_lenmin = (double) lenmin;
     
     /* Log progress to standard output if chosen*/
@@ -66,65 +105,78 @@ double get_initial_t(Dataptr matrix, const Branch *const inittree, long root, lo
     {
 		/* Collect a sample of sample_size permutations at the current temperature 
 		* and compute the ratio of proposed vs accepted worse changes*/
-		for (iter = 0; iter <= sample_size; iter++)
+		iter = 0;
+		while (iter <= sample_size)
 		{
-			/* Create an alternative tree topology (adopted from anneal()) */
-			prev_len = len;
-
 			/* occasionally re-root, to prevent influence from root position */
 			if ((iter % REROOT_INTERVAL) == 0)
 				root = arbreroot(x, root);
 
 			lvb_assert(t > DBL_EPSILON);
 
-			/* mutation: alternate between the two mutation functions */
-			if (iter % 2) {
-				rootdash = root;
-				mutate_spr(matrix, xdash, x, root);	/* global change */
-			}
+			/* Create alternative tree topologies (adopted from anneal()) */
+			batch_cnt = sample_size + 1 - iter;
+			if (batch_cnt > batch) batch_cnt = batch;
+			if (batch_cnt > REROOT_INTERVAL - iter % REROOT_INTERVAL)
+				batch_cnt = REROOT_INTERVAL - iter % REROOT_INTERVAL;
+			if (batch_cnt == 1)
+				lendash[0] = propose(matrix, xdash[0], x, root, iter, m, n, weights);
 			else {
-				rootdash = root;
-				mutate_nni(matrix, xdash, x, root);	/* local change */
+				for (j = 0; j < batch_cnt; j++) seed[j] = randpint(MAX_SEED);
+				next_seed = randpint(MAX_SEED);
+				#pragma omp parallel for schedule(dynamic)
+				for (j = 0; j < batch_cnt; j++) {
+					rinit((int) seed[j]);
+					lendash[j] = propose(matrix, xdash[j], x, root, iter + j, m, n, weights);
+					u[j] = uni();
+				}
+				rinit((int) next_seed);
 			}
 
-			lendash = getplen(xdash, rootdash, m, n, weights);
-			lvb_assert (lendash >= 1L);
-			deltalen = lendash - len;
-			deltah = (r_lenmin / (double) len) - (r_lenmin / (double) lendash);
+			accepted = LVB_FALSE;
+			for (j = 0; (j < batch_cnt) && (accepted == LVB_FALSE); j++)
+			{
+				iter++;
+				deltalen = lendash[j] - len;
+				deltah = (r_lenmin / (double) len) - (r_lenmin / (double) lendash[j]);
 			
-			if (deltah > 1.0)	/* getminlen() problem with ambiguous sites */
-				deltah = 1.0;
+				if (deltah > 1.0)	/* cannot happen while lenmin <= len */
+					deltah = 1.0;
 
-			/* Check whether the change is accepted (Again adopted from anneal()*/
-			if (deltalen <= 0)	/* accept the change */
-			{
-				/* update current tree and its stats */
-				prev_len = len;
-				len = lendash;
-				treeswap(&x, &root, &xdash, &rootdash);
-			}	
-			else {
-				prop_pos_trans++; /* Another positive transition has been generated*/
-
-				if (-deltah < t * log_wrapper(LVB_EPS)) {
-					pacc = 0.0;
-					/* Call uni() even though its not required. It
-					* would have been called in LVB 1.0A, so this
-					* helps make results identical to results with
-					* that version. */
-					(void) uni();
-				}
-				else	/* possibly accept the change */
+				/* Check whether the change is accepted (Again adopted from anneal()*/
+				if (deltalen <= 0)	/* accept the change */
 				{
-					pacc = exp_wrapper(-deltah/t);
-					if (uni() < pacc)	/* do accept the change */
+					accepted = LVB_TRUE;
+				}	
+				else {
+					prop_pos_trans++; /* Another positive transition has been generated*/
+
+					if (-deltah < t * log_wrapper(LVB_EPS)) {
+						pacc = 0.0;
+						/* Call uni() even though its not required. It
+						* would have been called in LVB 1.0A, so this
+						* helps make results identical to results with
+						* that version. */
+						if (batch_cnt == 1) (void) uni();
+					}
+					else	/* possibly accept the change */
 					{
-						prev_len = len;
-						len = lendash;
-						treeswap(&x, &root, &xdash, &rootdash);
-						acc_pos_trans++;  /* The change has been accepted */
+						pacc = exp_wrapper(-deltah/t);
+						if (batch_cnt == 1) u[j] = uni();
+						if (u[j] < pacc)	/* do accept the change */
+						{
+							accepted = LVB_TRUE;
+							acc_pos_trans++;  /* The change has been accepted */
+						}
 					}
 				}
+
+				/* update current tree and its stats */
+				if (accepted == LVB_TRUE) {
+					len = lendash[j];
+					rootdash = root;
+					treeswap(&x, &root, &xdash[j], &rootdash);
+				}
 			}
 		}
 
@@ -144,7 +196,11 @@ double get_initial_t(Dataptr matrix, const Branch *const inittree, long root, lo
     
     /* free "local" dynamic heap memory */
     free(x);
+    for (j = 0; j < batch; j++) free(xdash[j]);
     free(xdash);
+    free(lendash);
+    free(seed);
+    free(u);
     
     /* Log progress if chosen*/
     if (log_progress)
@@ -154,3 +210,124 @@ double get_initial_t(Dataptr matrix, const Branch *const inittree, long root, lo
     return (t - increment_size);
 
 } /* end get_initial_t() */
+
+static double mean_pacc(const double *deltah, const long cnt, const double t)
+/* return the mean probability of acceptance at temperature t of changes
+ * of positive energy change deltah[0..cnt-1], by the rule in anneal() */
+{
+    long i;		/* loop counter */
+    double sum = 0.0;	/* sum of probabilities */
+
+    for (i = 0; i < cnt; i++) {
+	if (-deltah[i] >= t * log_wrapper(LVB_EPS))
+	    sum += exp_wrapper(-deltah[i] / t);
+    }
+    return sum / (double) cnt;
+
+} /* end mean_pacc() */
+
+static double solve_t(const double *deltah, const long cnt)
+/* return the temperature at which the mean probability of acceptance of
+ * changes of positive energy change deltah[0..cnt-1] is 0.65, found by
+ * bisection since that mean increases with temperature */
+{
+    double t_lo = LVB_EPS;	/* temperature known to be too low */
+    double t_hi = 1.0;		/* temperature known to be high enough */
+    double t;			/* current temperature */
+
+    if (mean_pacc(deltah, cnt, t_hi) <= 0.65) return t_hi;
+    while (t_hi - t_lo > 0.001 * t_lo) {
+	t = 0.5 * (t_lo + t_hi);
+	if (mean_pacc(deltah, cnt, t) > 0.65) t_hi = t;
+	else t_lo = t;
+    }
+    return t_hi;
+
+} /* end solve_t() */
+
+double get_initial_t_analytic(Dataptr matrix, const Branch *const inittree, long root,
+		long m, long n, const long *weights, Lvb_bool log_progress)
+/* Determine the starting temperature for the annealing search, with the
+ * same meaning as for get_initial_t(), from samples of positive energy
+ * changes rather than a linear search: the search is run at the current
+ * estimate of the temperature, as in anneal(), and after INITIAL_T_BURNIN
+ * proposals the energy changes of the next INITIAL_T_SAMPLE proposals that
+ * would lengthen the tree are recorded; the temperature at which 65% of
+ * them would be accepted is found by bisection, and the estimate is moved
+ * half way towards it on a log scale; this is repeated until the estimate
+ * changes by less than INITIAL_T_TOLERANCE, or for at most
+ * INITIAL_T_ROUNDS samples; the first sample is taken from the initial
+ * tree without burn-in */
+{
+    double *deltah;		/* recorded positive energy changes */
+    double dh;			/* current energy change */
+    long cnt;			/* number recorded */
+    long iter;			/* iteration of mutate/evaluate loop */
+    long round;			/* sample number */
+    long len;			/* length of current tree */
+    long lendash;		/* length of proposed new tree */
+    long lenmin;		/* minimum length for any tree */
+    double r_lenmin;		/* minimum length for any tree */
+    long rootdash;		/* root of new configuration */
+    double t = LVB_EPS;		/* current estimate */
+    double t_new = LVB_EPS;	/* estimate from current sample */
+    Branch *x;			/* current configuration */
+    Branch *xdash;		/* proposed new configuration */
+
+    /* "local" dynamic heap memory */
+    x = treealloc(matrix);
+    xdash = treealloc(matrix);
+    deltah = alloc(INITIAL_T_SAMPLE * sizeof(double), "energy change sample");
+
+    treecopy(matrix, x, inittree);	/* current configuration */
+    len = getplen(x, root, m, n, weights);
+    lenmin = getminlen(matrix, weights);
+    r_lenmin = (double) lenmin;
+
+    if (log_progress)
+        printf("\nDetermining the Starting Temperature ...\n");
+
+    for (round = 0; round < INITIAL_T_ROUNDS; round++)
+    {
+	/* give up on the sample if changes are rarely for the worse */
+	cnt = 0;
+	for (iter = (round == 0) ? INITIAL_T_BURNIN : 0; (cnt < INITIAL_T_SAMPLE)
+	    && (iter < INITIAL_T_BURNIN + 10 * INITIAL_T_SAMPLE); iter++)
+	{
+	    /* occasionally re-root, to prevent influence from root position */
+	    if ((iter % REROOT_INTERVAL) == 0)
+		root = arbreroot(x, root);
+	    rootdash = root;
+	    lendash = propose(matrix, xdash, x, root, iter, m, n, weights);
+	    dh = (r_lenmin / (double) len) - (r_lenmin / (double) lendash);
+	    if (dh > 1.0)	/* cannot happen while lenmin <= len */
+		dh = 1.0;
+	    if ((lendash > len) && (iter >= INITIAL_T_BURNIN))
+		deltah[cnt++] = dh;
+
+	    /* accept as in anneal() */
+	    if ((lendash <= len) || ((-dh >= t * log_wrapper(LVB_EPS))
+		&& (uni() < exp_wrapper(-dh / t)))) {
+		len = lendash;
+		treeswap(&x, &root, &xdash, &rootdash);
+	    }
+	}
+	if (cnt == 0) break;
+
+	t_new = solve_t(deltah, cnt);
+	if (round == 0) t = t_new;
+	else t = sqrt(t * t_new);
+	if ((round > 0) && (fabs(t_new - t) < INITIAL_T_TOLERANCE * t)) break;
+    }
+
+    /* free "local" dynamic heap memory */
+    free(x);
+    free(xdash);
+    free(deltah);
+
+    if (log_progress)
+        printf("Starting Temperature is: %-.8f\n", t);
+
+    return t;
+
+} /* end get_initial_t_analytic() */
@@ -20,6 +20,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif /* #ifdef _OPENMP */
 #include "myuni.h"
 #include "mymaths.h"
 
@@ -62,6 +65,19 @@
 /* limits that could be changed but are likely to be OK */
 #define MAX_BOOTSTRAPS 1000000	/* max. bootstrap replicates */
 #define FROZEN_T 0.0001		/* consider system frozen if temp < FROZEN_T */
+#define ANALYTIC_T0 1		/* 1: T0 from samples, 0: by linear search */
+#define INITIAL_T_BURNIN 500L	/* proposals before sampling for T0 */
+#define INITIAL_T_SAMPLE 500L	/* positive energy changes sampled for T0 */
+#define INITIAL_T_ROUNDS 10L	/* most samples taken for T0 */
+#define INITIAL_T_TOLERANCE 0.05	/* relative change to stop sampling for T0 */
+
+/* parallelism: only has effect if compiled with OpenMP */
+#define PARALLEL_FITCH_MIN 256L	/* min. dirty branches for parallel getplen() */
+#define FITCH_TASK_DEPTH 12L	/* clade depth beyond which no new tasks */
+#define HILLCLIMB_BATCH 64L	/* branches tried at once in hill-climbing */
+#define INITIAL_T_BATCH 8L	/* proposals made at once in get_initial_t() */
+#define CTREESTACK_SHARDS 16L	/* separately locked parts of a Ctreestack */
+#define CTREESTACK_SLOTS 4096L	/* best trees checked without a lock */
 
 /* unchangeable types */
 typedef enum { LVB_FALSE, LVB_TRUE } Lvb_bool;	/* boolean type */
@@ -69,10 +85,15 @@ typedef enum { LVB_FALSE, LVB_TRUE } Lvb_bool;	/* boolean type */
 /* matrix and associated information */
 typedef struct data
 {
-    char **row;		/* array of row strings */
+    char **row;		/* array of row strings, of statesets if read by
+			 * phylip_dna_matrin_encoded() */
     long m;		/* number of columns */
     long n;		/* number of rows */
     char **rowtitle;	/* array of row title strings */ 
+    long *minsteps;	/* least changes in each column on any tree, or NULL
+			 * if not yet found by minsteps_init() */
+    char *rowblock;	/* block holding every row string, or NULL if each
+			 * row is allocated separately */
 } *Dataptr, DataStructure;
 
 /* branch of tree */
@@ -91,6 +112,7 @@ typedef struct
 {
     Branch *tree;	/* pointer to first branch in tree array */
     long root;		/* root of tree */
+    unsigned long hash;	/* topology hash of tree, from treehash() */
 } Treestack_element;
 typedef struct
 {
@@ -99,6 +121,25 @@ typedef struct
     Treestack_element *stack;	/* pointer to first element in stack */
 } Treestack;
 
+/* concurrent tree stacks, see ctreestack.c */
+typedef struct
+{
+    volatile long len;		/* length of trees in table, LONG_MAX if none */
+    volatile long active;	/* threads currently using table */
+    unsigned long *key;		/* open-addressed topology hashes, 0 if unused */
+} Ctreestack_table;
+typedef struct
+{
+    Ctreestack_table *volatile table;	/* current hash table */
+    Ctreestack_table *spare;	/* hash table for use after next clear */
+    long slots;			/* elements in key of each table, power of 2 */
+    Treestack *shard;		/* element i: trees in shard i */
+    long *shard_len;		/* element i: length of trees in shard i */
+#ifdef _OPENMP
+    omp_lock_t *shard_lock;	/* element i: lock for shard i */
+#endif /* #ifdef _OPENMP */
+} Ctreestack;
+
 /* user- or programmer-configurable parameters */
 typedef struct
 {
@@ -106,7 +147,21 @@ typedef struct
     long verbose;		/* verboseness level */
     long bootstraps;		/* number of bootstrap replicates */
     Lvb_bool fifthstate;	/* if LVB_TRUE, '-' is 'O'; otherwise is '?' */
-    int cooling_schedule;   /* cooling schedule: 0 is geometric, 1 is linear */
+    int cooling_schedule;   /* cooling schedule: 0 is geometric, 1 is linear,
+    			     * 2 is adaptive */
+    long islands;		/* islands in island-model search, < 2 for none */
+    Lvb_bool adaptive_moves;	/* choose rearrangements adaptively in anneal() */
+    Lvb_bool ratchet;		/* search by parsimony ratchet, not annealing */
+    Lvb_bool sectorial;		/* sectorial search after main search */
+    Lvb_bool fuse;		/* fuse best trees after main search */
+    Lvb_bool bandb;		/* exact search if few enough objects */
+    Lvb_bool matrix_cache;	/* keep prepared matrix of large files in cache */
+    Lvb_bool site_patterns;	/* merge identical columns into weighted ones */
+    int start_tree;		/* starting tree: 0 is random, 1 is by stepwise
+    				 * addition, 2 is by neighbour-joining */
+    Lvb_bool analytic_t0;	/* if LVB_TRUE, get_initial_t_analytic() */
+    long t0_group;		/* bootstrap replicates per T0, 0: original data */
+    Lvb_bool warm_start;	/* start replicates from original data's tree */
     char *p_file_name;
 } Params;
 
@@ -114,6 +169,73 @@ typedef struct
 #define MAXACCEPT_SLOW 5L	/* maxaccept for "slow" searches */
 #define MAXPROPOSE_SLOW 2000L	/* maxpropose for "slow" searches */
 #define MAXFAIL_SLOW 40L	/* maxfail for "slow" searches */
+#define ADAPTIVE_LAMBDA 0.7	/* cooling speed of adaptive schedule */
+#define ADAPTIVE_MIN_RATIO 0.5	/* least t(n+1)/t(n) for adaptive schedule */
+#define ADAPTIVE_MAX_RATIO 0.999	/* most t(n+1)/t(n) for adaptive schedule */
+#define ADAPTIVE_FROZEN 0.001	/* adaptive schedule: frozen if fewer
+				 * changes for the worse are accepted */
+
+/* choice of rearrangement in anneal() */
+#define ADAPTIVE_MOVES 1	/* 1: adaptive choice, 0: alternate NNI and SPR */
+#define MOVE_BANDS 16L		/* temperature bands, each half the last */
+#define MOVE_MIN_PROB 0.05	/* least probability of each rearrangement */
+#define MOVE_IMPROVE_WEIGHT 10.0	/* worth of improvement over acceptance */
+#define SPR_RADIUS 3L		/* greatest distance moved by local SPR */
+
+/* parsimony ratchet */
+#define RATCHET 0		/* 1: search by ratchet instead of annealing */
+#define RATCHET_ITERATIONS 200L	/* max. ratchet iterations */
+#define RATCHET_STALL 50L	/* ratchet iterations without improvement
+				 * before stopping */
+#define RATCHET_MAX_TREES 100L	/* max. equally short trees found by each
+				 * climb of the ratchet */
+
+/* sectorial search */
+#define SECTORIAL 1		/* 1: sectorial search after the main search */
+#define SECTORIAL_MIN_N 100L	/* min. objects for sectorial search */
+#define SECTORIAL_STALL 3L	/* rounds without improvement before stopping */
+#define SECTOR_SIZE 40L		/* max. subtrees hanging from a sector */
+#define SECTOR_MIN 8L		/* min. subtrees hanging from a sector */
+#define SECTOR_ITERATIONS 20L	/* max. ratchet iterations per sector */
+#define SECTOR_STALL 5L		/* ratchet iterations per sector without
+				 * improvement before stopping */
+
+/* tree fusing */
+#define FUSE 1			/* 1: fuse the best trees after the search */
+#define FUSE_MAX_TREES 32L	/* max. trees fused */
+
+/* exact search by branch and bound */
+#define BANDB 1			/* 1: exact search if few enough objects */
+#define BANDB_MAX_N 10L		/* max. objects for exact search */
+#define BANDB_MAX_TREES 10000L	/* max. most parsimonious trees kept */
+#define BANDB_MAX_ITER 200000L	/* max. partial trees tried; then the
+				 * search continues by annealing */
+
+/* preparation of the data matrix */
+#define MATRIX_CACHE 1		/* 1: keep the prepared matrix in a cache file */
+#define MATRIX_CACHE_MIN_SIZE 1048576L	/* min. bytes in data file to cache */
+#define MATRIX_CACHE_SUFFIX ".lvbcache"	/* added to data file name for cache */
+#define SITE_PATTERNS 0		/* 1: merge identical columns, as weights */
+
+/* starting tree */
+#define START_TREE 1		/* 0: random tree, 1: stepwise addition,
+				 * 2: neighbour-joining */
+#define START_T_FACTOR 0.1	/* T0 multiplier for non-random starting tree */
+#define ADDTREE_PARALLEL_MIN 65536L	/* min. states compared for parallel
+					 * stepwise addition */
+#define NJ_EXACT_MAX 500L	/* max. objects for exact neighbour-joining */
+
+/* bootstrapping */
+#define BOOTSTRAP_T0_GROUP 1L	/* replicates per T0; 0: T0 of original data
+				 * for all replicates */
+#define BOOTSTRAP_WARM_START 0	/* 1: start replicates from original data's tree */
+#define WARM_START_T_FACTOR 0.1	/* T0 multiplier for warm-started replicates */
+
+/* island-model search: several annealing searches exchanging best trees */
+#define ISLANDS 0L		/* islands; 0 or 1 for a single search */
+#define MAX_ISLANDS 64L		/* max. islands chosen at run time */
+#define MIGRATION_INTERVAL 10L	/* temperatures between migrations */
+#define ISLAND_PERTURB 2L	/* random NNIs applied to a migrant tree */
 
 /* fixed file names */
 #define MATFNAM "infile"	/* matrix file name */
@@ -133,13 +255,31 @@ typedef struct
 extern long chars;	/* defined in dnapars.c */
 
 /* LVB global functions */
+void addtree(Dataptr, Branch *const, unsigned char **, const long *);
+void njtree(Dataptr, Branch *const, unsigned char **);
 void *alloc(const size_t, const char *const);
 long anneal(Dataptr, Treestack *, const Branch *const, long, const double,
- const long, const long, const long, FILE *const, const long *, long *, const int, Lvb_bool);
+ const long, const long, const long, FILE *const, const long *, long *, const int,
+ const Lvb_bool, Lvb_bool);
+long anneal_islands(Dataptr, Treestack *, const Branch *const, long, const double,
+ const long, const long, const long, FILE *const, const long *, long *,
+ const int, const Lvb_bool, Lvb_bool, const long);
 long arbreroot(Branch *const, const long);
+long bandb(Dataptr, Treestack *, unsigned char **, FILE *const, const long *,
+ long *, Lvb_bool, Lvb_bool *const);
+long ratchet(Dataptr, Treestack *, const Branch *const, long, FILE *const,
+ const long *, long *, Lvb_bool);
+long sectorial(Dataptr, Treestack *, const Branch *const, long, FILE *const,
+ const long *, long *, Lvb_bool);
 long brcnt(long);
 long childadd(Branch *const, const long, const long);
 long cistrcmp(const char *const, const char *const);
+void ctreestack_free(Ctreestack *);
+long ctreestack_get(Dataptr, Ctreestack *, Branch *, long *);
+long ctreestack_len(Ctreestack *);
+Ctreestack ctreestack_new(long);
+long ctreestack_push(Dataptr, Ctreestack *, const Branch *const, const long, const long);
+long ctreestack_transfer(Dataptr, Treestack *, Ctreestack *);
 Lvb_bool cleanup(void);
 void clnclose(FILE *const, const char *const);
 FILE *clnopen(const char *const, const char *const);
@@ -147,38 +287,55 @@ void clnremove(const char *const);
 void crash(const char *const, ...);
 long deterministic_hillclimb(Dataptr, Treestack *, const Branch *const, long,
     FILE * const, const long *, long *, Lvb_bool);
+void dna_lut(unsigned char *, Lvb_bool);
 void dna_makebin(const Dataptr, Lvb_bool, unsigned char **);
 void dnapars_wrapper(void);
 char *f2str(FILE *const);
+void fitch_sets(unsigned char *const, const unsigned char *const,
+ const unsigned char *const, const long);
 Lvb_bool file_exists(const char *const);
-void get_bootstrap_weights(long *, long, long);
+void get_bootstrap_weights(long *, const long *, long, long);
+long merge_patterns(Dataptr, long *);
 double get_initial_t(Dataptr, const Branch *const, long, long, long, const long *, Lvb_bool);
-long getminlen(const Dataptr);
+double get_initial_t_analytic(Dataptr, const Branch *const, long, long, long, const long *,
+ Lvb_bool);
+long getminlen(const Dataptr, const long *);
+void minsteps_init(Dataptr);
 void getparam(Params *);
 long getplen(Branch *, const long, const long, const long, const long *);
+unsigned long hashmix(unsigned long);
 double get_predicted_length(double, double, long, long, long, long);
 double get_predicted_trees(double, double, long, long, long, long);
 long getroot(const Branch *const);
+long insert_cost(const unsigned char *const, const unsigned char *const,
+ const unsigned char *const, const long, const long *);
 void lvb_assertion_fail(const char *, const char *, int);
 void lvb_initialize(void);
 Dataptr lvb_matrin(const char *);
 long lvb_reroot(Branch *const barray, const long oldroot, const long newroot);
 void lvb_treeprint (Dataptr, FILE *const, const Branch *const, const long);
 Dataptr matalloc(const long);
-void matchange(Dataptr, const Params, const Lvb_bool);
+void matchange(Dataptr, const Params, const Lvb_bool *const, const Lvb_bool);
 Dataptr matrin(const char *const);
 void mutate_deterministic(Dataptr, Branch *const, const Branch *const, long, long, Lvb_bool);
 void mutate_spr(Dataptr, Branch *const, const Branch *const, long);
 void mutate_nni(Dataptr, Branch *const, const Branch *const, long);
+void mutate_spr_local(Dataptr, Branch *const, const Branch *const, long, const long);
+void mutate_tbr(Dataptr, Branch *const, const Branch *const, long);
 char *nextnonwspc(const char *);
 void nodeclear(Branch *const, const long);
 long objreroot(Branch *const, const long, const long);
 void params_change(Params *);
 void phylip_dna_matrin(char *, Dataptr);
+Lvb_bool *phylip_dna_matrin_encoded(char *, Lvb_bool, Dataptr);
+Lvb_bool matrix_cache_load(const Params, Dataptr, long *, long *);
+void matrix_cache_save(const Params, Dataptr, const long *, long);
 void phylip_mat_dims_in(char *, long *, long *);
+long popcount(unsigned long);
 void randtree(Dataptr, Branch *const);
 long randpint(const long);
 void rowfree(Dataptr);
+void rowpack(Dataptr);
 char *salloc(const long, const char *const);
 void scream(const char *const, ...);
 void ss_init(Branch *, unsigned char **, long, long);
@@ -188,6 +345,8 @@ void treeclear(Dataptr, Branch *const);
 void treecopy(Dataptr, Branch *const, const Branch *const);
 long treecmp(Dataptr, const Branch *const, const long, const Branch *const, long);
 void treedump(Dataptr, FILE *const, const Branch *const);
+unsigned long treehash(Dataptr, const Branch *const, const long);
+long treefuse(Dataptr, Treestack *, const long *);
 void treestack_clear(Treestack *);
 long treestack_cnt(Treestack);
 long treestack_dump(Dataptr, Treestack *, FILE *const);
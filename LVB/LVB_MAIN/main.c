@@ -27,8 +27,9 @@ static void smessg(long start, long cycle)
 
 } /* end smessg() */
 
-static void writeinf(Params prms)
-/* write initial details to standard output */
+static void writeinf(Params prms, Lvb_bool from_cache)
+/* write initial details to standard output; from_cache is LVB_TRUE if the
+ * matrix was read from its cache */
 {
     printf("\n");
 
@@ -36,12 +37,48 @@ static void writeinf(Params prms)
     if (prms.fifthstate == LVB_TRUE) printf("FIFTH STATE\n");
     else printf("UNKNOWN\n");
 
-    printf("cooling schedule     = ");
-    if(prms.cooling_schedule == 0) printf("GEOMETRIC\n");
-    else printf("LINEAR\n");
+    printf("matrix cache         = ");
+    if (from_cache == LVB_TRUE) printf("READ FROM '%s%s'\n", prms.p_file_name, MATRIX_CACHE_SUFFIX);
+    else if (prms.matrix_cache == LVB_TRUE) printf("FOR FILES FROM %ld BYTES\n", MATRIX_CACHE_MIN_SIZE);
+    else printf("NO\n");
+    printf("site patterns        = ");
+    if (prms.site_patterns == LVB_TRUE) printf("MERGED\n");
+    else printf("NO\n");
+
+    printf("exact search         = ");
+    if (prms.bandb == LVB_TRUE) printf("UP TO %ld OBJECTS\n", BANDB_MAX_N);
+    else printf("NO\n");
+    if (prms.ratchet == LVB_TRUE) printf("search               = PARSIMONY RATCHET\n");
+    else {
+	printf("cooling schedule     = ");
+	if(prms.cooling_schedule == 0) printf("GEOMETRIC\n");
+	else if(prms.cooling_schedule == 1) printf("LINEAR\n");
+	else printf("ADAPTIVE\n");
+    }
+
+    printf("starting tree        = ");
+    if (prms.start_tree == 1) printf("STEPWISE ADDITION\n");
+    else if (prms.start_tree == 2) printf("NEIGHBOUR-JOINING\n");
+    else printf("RANDOM\n");
+
+    printf("sectorial search     = ");
+    if (prms.sectorial == LVB_TRUE) printf("FROM %ld OBJECTS\n", SECTORIAL_MIN_N);
+    else printf("NO\n");
+    printf("tree fusing          = ");
+    if (prms.fuse == LVB_TRUE) printf("YES\n");
+    else printf("NO\n");
 
+    if (prms.islands > 1) printf("islands              = %ld\n", prms.islands);
     printf("seed                 = %d\n", prms.seed);
     printf("bootstrap replicates = %ld\n", prms.bootstraps);
+    if (prms.bootstraps > 0) {
+	printf("starting temperature = ");
+	if (prms.t0_group == 0) printf("FROM ORIGINAL DATA\n");
+	else printf("EVERY %ld REPLICATE(S)\n", prms.t0_group);
+	printf("warm start           = ");
+	if (prms.warm_start == LVB_TRUE) printf("FROM ORIGINAL DATA\n");
+	else printf("NO\n");
+    }
 
 } /* end writeinf() */
 
@@ -62,26 +99,72 @@ static void logtree1(Dataptr matrix, const Branch *const barray, const long star
 
 } /* end logtree1() */
 
-static long getsoln(Dataptr matrix, Params rcstruct, const long *weight_arr, long *iter_p, Lvb_bool log_progress)
+static double get_t0(Dataptr matrix, Params rcstruct, unsigned char **enc_mat,
+    const long *weight_arr, Lvb_bool log_progress)
+/* return the starting temperature for an annealing search using weights in
+ * weight_arr, determined by the method given in rcstruct, from a random
+ * tree for the data encoded in enc_mat; return LVB_EPS without work if
+ * rcstruct asks for the parsimony ratchet, or the search will be exact,
+ * neither of which needs a temperature */
+{
+    double t0;		/* return value */
+    long initroot = 0;	/* initial tree's root */
+    Branch *tree;	/* initial tree */
+
+    if (rcstruct.ratchet == LVB_TRUE) return LVB_EPS;
+    if ((rcstruct.bandb == LVB_TRUE) && (matrix->n <= BANDB_MAX_N)) return LVB_EPS;
+
+    /* dynamic "local" heap memory */
+    tree = treealloc(matrix);
+
+    randtree(matrix, tree);	/* initialise required variables */
+    ss_init(tree, enc_mat, brcnt(matrix->n), matrix->m);
+    if (rcstruct.analytic_t0 == LVB_TRUE)
+	t0 = get_initial_t_analytic(matrix, tree, initroot, matrix->m, matrix->n, weight_arr,
+		log_progress);
+    else
+	t0 = get_initial_t(matrix, tree, initroot, matrix->m, matrix->n, weight_arr, log_progress);
+
+    /* "local" dynamic heap memory */
+    free(tree);
+
+    return t0;
+
+} /* end get_t0() */
+
+static long getsoln(Dataptr matrix, Params rcstruct, unsigned char **enc_mat,
+    const long *weight_arr, long *iter_p, Lvb_bool log_progress, double t0,
+    const Branch *const start_tree, const long start_root)
 /* get and output solution(s) according to parameters in rcstruct;
- * return length of shortest tree(s) found, using weights in weight_arr */
+ * return length of shortest tree(s) found, using weights in weight_arr,
+ * for the data encoded in enc_mat; the search starts at temperature t0
+ * from a random tree, or at temperature t0 * START_T_FACTOR from a tree
+ * by stepwise addition or neighbour-joining if rcstruct says so, or if start_tree is not NULL,
+ * at temperature t0 * WARM_START_T_FACTOR from start_tree (of root
+ * start_root); with enough objects, the result is refined by sectorial
+ * search if rcstruct says so, and the best trees found may then be fused,
+ * unless their length is already the least possible;
+ * with few enough objects, if rcstruct says so, all most parsimonious
+ * trees are found by branch and bound instead, unless it takes too long,
+ * in which case the search goes on from the best tree it found, at
+ * START_T_FACTOR times a starting temperature found then, since t0 is not
+ * found for branch and bound */
 {
     int cooling_schedule = rcstruct.cooling_schedule; /* cooling schedule */
     static char fnam[LVB_FNAMSIZE];	/* current file name */
     long fnamlen;			/* length of current file name */
-    long i;				/* loop counter */
-    double t0;		/* SA cooling cycle initial temp */
     long maxaccept = MAXACCEPT_SLOW;	/* SA cooling cycle maxaccept */
     long maxpropose = MAXPROPOSE_SLOW;	/* SA cooling cycle maxpropose */
     long maxfail = MAXFAIL_SLOW;	/* SA cooling cycly maxfail */
     long treec;				/* number of trees found */
     long treelength = LONG_MAX;		/* length of each tree found */
+    long lenmin;			/* minimum length for any tree */
     long initroot;			/* initial tree's root */
+    Lvb_bool exact = LVB_FALSE;		/* branch and bound finished */
     FILE *sumfp;			/* best length file */
     FILE *resfp;			/* results file */
     Branch *tree;			/* initial tree */
     Branch *user_tree_ptr = NULL;	/* user-specified initial tree */
-    static unsigned char *enc_mat[MAX_N] = { NULL };	/* encoded data mat. */
 
     /* NOTE: These variables and their values are "dummies" and are no longer
      * used in the current version of LVB. However, in order to keep the
@@ -94,13 +177,6 @@ static long getsoln(Dataptr matrix, Params rcstruct, const long *weight_arr, lon
     /* dynamic "local" heap memory */
     tree = treealloc(matrix);
 
-    /* Allocation of the initial encoded matrix is non-contiguous because
-     * this matrix isn't used much, so any performance penalty won't matter. */
-    for (i = 0; i < matrix->n; i++)
-        enc_mat[i] = alloc(matrix->m * sizeof(unsigned char), "state sets");
-    
-    dna_makebin(matrix, rcstruct.fifthstate, enc_mat);
-
     /* open and entitle statistics file shared by all cycles
      * NOTE: There are no cycles anymore in the current version
      * of LVB. The code bellow is purely to keep the output consistent
@@ -116,15 +192,27 @@ static long getsoln(Dataptr matrix, Params rcstruct, const long *weight_arr, lon
         sumfp = NULL;
     }
 	
-    /* determine starting temperature */
-    randtree(matrix, tree);	/* initialise required variables */
-    ss_init(tree, enc_mat, brcnt(matrix->n), matrix->m);
-    initroot = 0;
-    t0 = get_initial_t(matrix, tree, initroot, matrix->m, matrix->n, weight_arr, log_progress);
-
-    randtree(matrix, tree);	/* begin from scratch */
+    if (start_tree != NULL) {	/* warm start, from a cooler temperature */
+	treecopy(matrix, tree, start_tree);
+	initroot = start_root;
+	t0 *= WARM_START_T_FACTOR;
+    }
+    else if (rcstruct.start_tree == 1) {	/* stepwise addition, cooler */
+	addtree(matrix, tree, enc_mat, weight_arr);
+	initroot = 0;
+	t0 *= START_T_FACTOR;
+    }
+    else if (rcstruct.start_tree == 2) {	/* neighbour-joining, cooler */
+	njtree(matrix, tree, enc_mat);
+	initroot = 0;
+	t0 *= START_T_FACTOR;
+    }
+    else {			/* begin from scratch */
+	randtree(matrix, tree);
+	initroot = 0;
+    }
+    if (t0 < LVB_EPS) t0 = LVB_EPS;
     ss_init(tree, enc_mat, brcnt(matrix->n), matrix->m);
-    initroot = 0;
 
     if (rcstruct.verbose)
 	smessg(start, cyc);
@@ -142,12 +230,57 @@ static long getsoln(Dataptr matrix, Params rcstruct, const long *weight_arr, lon
     }
 
     /* find solution(s) */
-    treelength = anneal(matrix, &bstack_overall, tree, initroot, t0, maxaccept, maxpropose, maxfail,
-    		stdout, weight_arr, iter_p, cooling_schedule, log_progress);
-    treestack_pop(matrix, tree, &initroot, &bstack_overall);
-    treestack_push(matrix, &bstack_overall, tree, initroot);
-    treelength = deterministic_hillclimb(matrix, &bstack_overall, tree, initroot, stdout,
-    		weight_arr, iter_p, log_progress);
+    if ((rcstruct.bandb == LVB_TRUE) && (matrix->n <= BANDB_MAX_N)) {
+	treelength = bandb(matrix, &bstack_overall, enc_mat, stdout, weight_arr,
+		iter_p, log_progress, &exact);
+	if (exact == LVB_FALSE) {	/* go on from its best tree */
+	    if (log_progress == LVB_TRUE)
+		printf("\nExact search stopped after %ld partial trees, "
+		 "continuing by annealing\n", BANDB_MAX_ITER);
+	    treestack_pop(matrix, tree, &initroot, &bstack_overall);
+	    treestack_clear(&bstack_overall);
+	    ss_init(tree, enc_mat, brcnt(matrix->n), matrix->m);
+	    rcstruct.bandb = LVB_FALSE;
+	    t0 = get_t0(matrix, rcstruct, enc_mat, weight_arr, log_progress)
+		* START_T_FACTOR;
+	    if (t0 < LVB_EPS) t0 = LVB_EPS;
+	}
+	else if (log_progress == LVB_TRUE)
+	    printf("\nExact search finished, so the trees found are most "
+	     "parsimonious\n");
+    }
+    if (exact == LVB_FALSE) {
+	if (rcstruct.ratchet == LVB_TRUE)
+	    treelength = ratchet(matrix, &bstack_overall, tree, initroot, stdout,
+		    weight_arr, iter_p, log_progress);
+	else if (rcstruct.islands > 1)
+	    treelength = anneal_islands(matrix, &bstack_overall, tree, initroot, t0, maxaccept,
+		    maxpropose, maxfail, stdout, weight_arr, iter_p, cooling_schedule,
+		    rcstruct.adaptive_moves, log_progress, rcstruct.islands);
+	else
+	    treelength = anneal(matrix, &bstack_overall, tree, initroot, t0, maxaccept,
+		    maxpropose, maxfail, stdout, weight_arr, iter_p, cooling_schedule,
+		    rcstruct.adaptive_moves, log_progress);
+	treestack_pop(matrix, tree, &initroot, &bstack_overall);
+	treestack_push(matrix, &bstack_overall, tree, initroot);
+	lenmin = getminlen(matrix, weight_arr);
+	if ((rcstruct.sectorial == LVB_TRUE) && (matrix->n >= SECTORIAL_MIN_N)
+	 && (treelength > lenmin)) {
+	    treelength = sectorial(matrix, &bstack_overall, tree, initroot, stdout,
+		    weight_arr, iter_p, log_progress);
+	    treestack_pop(matrix, tree, &initroot, &bstack_overall);
+	    treestack_push(matrix, &bstack_overall, tree, initroot);
+	}
+	treelength = deterministic_hillclimb(matrix, &bstack_overall, tree, initroot, stdout,
+		    weight_arr, iter_p, log_progress);
+	if ((rcstruct.fuse == LVB_TRUE) && (treestack_cnt(bstack_overall) > 1)
+	 && (treelength > lenmin) && (treefuse(matrix, &bstack_overall, weight_arr) < treelength)) {
+	    treestack_pop(matrix, tree, &initroot, &bstack_overall);
+	    treestack_push(matrix, &bstack_overall, tree, initroot);
+	    treelength = deterministic_hillclimb(matrix, &bstack_overall, tree, initroot, stdout,
+		    weight_arr, iter_p, log_progress);
+	}
+    }
 
 	/* log this cycle's solution and its details 
 	 * NOTE: There are no cycles anymore in the current version
@@ -195,12 +328,10 @@ static void logstim(void)
 
 int main(void)
 {
-    Dataptr matrix;	/* data matrix */
+    extern Dataptr matrix;	/* data matrix */
     int val;			/* return value */
     Params rcstruct;		/* configurable parameters */
     long i;			/* loop counter */
-    long m;			/* sites per sequence */
-    long n;			/* sequences in the data matrix */
     long iter;			/* iterations of annealing algorithm */
     long replicate_no = 0L;	/* current bootstrap replicate number */
     long trees_output_total = 0L;	/* number of trees output, overall */
@@ -210,7 +341,16 @@ int main(void)
     long m_including_constcols;	/* site count before constant sites removed */
     FILE *outtreefp;		/* best trees found overall */
     static long weight_arr[MAX_M];	/* weights for sites */
+    static long site_count[MAX_M];	/* original columns per column */
+    long constcols;		/* constant columns, not in matrix */
+    Lvb_bool from_cache;	/* matrix read from its cache */
     Lvb_bool log_progress;	/* whether or not to log anneal search */
+    static unsigned char *enc_mat[MAX_N] = { NULL };	/* encoded data mat. */
+    double t0 = 0.0;		/* SA cooling cycle initial temp */
+    long orig_length;		/* length of best tree for original data */
+    long orig_root = UNSET;	/* root of orig_tree */
+    Branch *orig_tree = NULL;	/* best tree for original data, or NULL */
+    Lvb_bool *isconst = NULL;	/* constant columns, found while reading */
 
     /* global files */
 
@@ -228,24 +368,66 @@ int main(void)
 
     getparam(&rcstruct);
 
-    phylip_mat_dims_in(rcstruct.p_file_name, &n, &m);
     logstim();
 
+    /* the matrix, ready for the search, may be in its cache from an
+     * earlier run; otherwise, one pass over the file gives the dimensions,
+     * the data already encoded as statesets, and the constant columns */
     matrix = malloc(sizeof(DataStructure));
-    phylip_dna_matrin(rcstruct.p_file_name, matrix);
-    lvb_assert((matrix->m == m) && (matrix->n == n));
+    matrix->minsteps = NULL;
+    matrix->rowblock = NULL;
+    from_cache = matrix_cache_load(rcstruct, matrix, site_count,
+	&m_including_constcols);
+    if (from_cache == LVB_FALSE)
+	isconst = phylip_dna_matrin_encoded(rcstruct.p_file_name, rcstruct.fifthstate,
+	    matrix);
 
     /* "file-local" dynamic heap memory: set up best tree stacks */
     bstack_overall = treestack_new();
 
-    writeinf(rcstruct);
-    m_including_constcols = matrix->m;
-    matchange(matrix, rcstruct, rcstruct.verbose);	/* cut columns */
+    writeinf(rcstruct, from_cache);
+    if (from_cache == LVB_FALSE) {
+	m_including_constcols = matrix->m;
+	matchange(matrix, rcstruct, isconst, rcstruct.verbose);	/* cut columns */
+	free(isconst);
+	if (rcstruct.site_patterns == LVB_TRUE)
+	    merge_patterns(matrix, site_count);
+	else
+	    for (i = 0; i < matrix->m; i++) site_count[i] = 1;
+	matrix_cache_save(rcstruct, matrix, site_count, m_including_constcols);
+    }
+    constcols = m_including_constcols;
+    for (i = 0; i < matrix->m; i++) constcols -= site_count[i];
+    rowpack(matrix);	/* the search's only copy of the data */
 
+    minsteps_init(matrix);
     if (rcstruct.verbose == LVB_TRUE) {
-    	printf("getminlen: %ld\n\n", getminlen(matrix));
+    	printf("getminlen: %ld\n\n", getminlen(matrix, site_count));
     }
+    /* the rows are the encoded matrix, in one block */
+    for (i = 0; i < matrix->n; i++)
+        enc_mat[i] = (unsigned char *) matrix->row[i];
+
     rinit(rcstruct.seed);
+
+    /* for bootstrapping, the original data may give the starting
+     * temperature for all replicates, and their starting tree */
+    if ((rcstruct.bootstraps > 0)
+	&& ((rcstruct.t0_group == 0) || (rcstruct.warm_start == LVB_TRUE))) {
+	for (i = 0; i < matrix->m; i++) weight_arr[i] = site_count[i];
+	t0 = get_t0(matrix, rcstruct, enc_mat, weight_arr, LVB_FALSE);
+	if (rcstruct.warm_start == LVB_TRUE) {
+	    iter = 0;
+	    orig_length = getsoln(matrix, rcstruct, enc_mat, weight_arr, &iter, LVB_FALSE,
+		t0, NULL, 0);
+	    orig_tree = treealloc(matrix);
+	    treestack_pop(matrix, orig_tree, &orig_root, &bstack_overall);
+	    treestack_clear(&bstack_overall);
+	    printf("\nOriginal data: %ld rearrangements, length %ld\n", iter, orig_length);
+	    total_iter += (double) iter;
+	}
+    }
+
     if (rcstruct.bootstraps > 0) {
     	log_progress = LVB_FALSE;
     	printf("\nReplicate:      Rearrangements: Trees output:   Length:\n");
@@ -256,13 +438,17 @@ int main(void)
     do{
 		iter = 0;
 		if (rcstruct.bootstraps > 0){
-			get_bootstrap_weights(weight_arr, matrix->m, m_including_constcols - matrix->m);
+			get_bootstrap_weights(weight_arr, site_count, matrix->m, constcols);
 		}
 		else{
-			for (i = 0; i < matrix->m; i++) weight_arr[i] = 1;
+			for (i = 0; i < matrix->m; i++) weight_arr[i] = site_count[i];
 		}
 
-		final_length = getsoln(matrix, rcstruct, weight_arr, &iter, log_progress);
+		if ((rcstruct.bootstraps == 0)
+		    || ((rcstruct.t0_group > 0) && ((replicate_no % rcstruct.t0_group) == 0)))
+			t0 = get_t0(matrix, rcstruct, enc_mat, weight_arr, log_progress);
+		final_length = getsoln(matrix, rcstruct, enc_mat, weight_arr, &iter, log_progress,
+			t0, orig_tree, orig_root);
 		if (rcstruct.bootstraps > 0) trees_output = treestack_print(matrix, &bstack_overall, outtreefp, LVB_TRUE);
 		else trees_output = treestack_print(matrix, &bstack_overall, outtreefp, LVB_FALSE);
 
@@ -299,8 +485,12 @@ int main(void)
 			 "file '%s'\n", trees_output_total, final_length, OUTTREEFNAM);
 		}
     }
+    if ((rcstruct.bootstraps == 0) && (final_length == getminlen(matrix, site_count)))
+	printf("This length is the least possible for these data, so %s provably "
+	 "optimal\n", (trees_output_total == 1L) ? "the tree is" : "the trees are");
 
-    rowfree(matrix);
+    rowfree(matrix);	/* also frees enc_mat's rows */
+    if (orig_tree != NULL) free(orig_tree);
 
     /* "file-local" dynamic heap memory */
     treestack_free(&bstack_overall);
@@ -34,6 +34,7 @@ static void rstart(int i, int j, int k, int l);
 
 /*
  *	Global variables for rstart & uni
+ *	(one set per thread if compiled with OpenMP)
  */
 
 static double uni_u[98];	/* Was U(97) in Fortran version */
@@ -41,6 +42,11 @@ static double uni_c, uni_cd, uni_cm;
 static int uni_ui, uni_uj;
 static Lvb_bool rinit_called = LVB_FALSE;	/* added - DB */
 
+/* each thread has its own generator, seeded by its own call to rinit() */
+#ifdef _OPENMP
+#pragma omp threadprivate(uni_u, uni_c, uni_cd, uni_cm, uni_ui, uni_uj, rinit_called)
+#endif
+
 double uni(void)
 {
 	double luni;			/* local variable for uni */
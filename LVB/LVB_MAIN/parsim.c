@@ -8,6 +8,143 @@
 
 #include "lvb.h"
 
+static void fitch_node(Branch *barray, const long branch, const long m, const long *weights)
+/* calculate state sets and changes for internal branch branch of the tree in
+ * barray from the state sets of its children, which must both be clean;
+ * on return branch is clean */
+{
+    long k;				/* current character number */
+    const long left = barray[branch].left;	/* left child number */
+    const long right = barray[branch].right;	/* right child number */
+    unsigned current_ss;		/* current state set */
+    unsigned left_ss;			/* left state set */
+    unsigned right_ss;			/* right state set */
+
+    barray[branch].changes = 0;
+    for (k = 0; k < m; k++){
+	left_ss = barray[left].sset[k];
+	right_ss = barray[right].sset[k];
+	current_ss = left_ss & right_ss;
+	if (current_ss == 0U){
+	    current_ss = left_ss | right_ss;
+	    barray[branch].changes += weights[k];
+	}
+	barray[branch].sset[k] = current_ss;
+    }
+
+} /* end fitch_node() */
+
+#ifdef _OPENMP
+
+static Lvb_bool is_dirty(const Branch *const barray, const long branch, const long n)
+/* return LVB_TRUE if branch is an internal branch still to be calculated */
+{
+    if ((branch >= n) && (barray[branch].sset[0] == 0U)) return LVB_TRUE;
+    else return LVB_FALSE;
+
+} /* end is_dirty() */
+
+static void fitch_clade_serial(Branch *barray, const long top, const long n,
+    const long m, const long *weights)
+/* make clean every dirty branch in the clade descending from branch top,
+ * working up from the tips; uses the parent links rather than recursion or a
+ * stack, so the depth of the clade does not matter */
+{
+    long current = top;		/* current branch */
+
+    while (is_dirty(barray, current, n) == LVB_TRUE) {
+	if (is_dirty(barray, barray[current].left, n) == LVB_TRUE)
+	    current = barray[current].left;
+	else if (is_dirty(barray, barray[current].right, n) == LVB_TRUE)
+	    current = barray[current].right;
+	else {
+	    fitch_node(barray, current, m, weights);
+	    if (current != top) current = barray[current].parent;
+	}
+    }
+
+} /* end fitch_clade_serial() */
+
+static void fitch_clade_tasks(Branch *barray, const long top, const long n,
+    const long m, const long *weights, const long depth)
+/* make clean every dirty branch in the clade descending from branch top,
+ * scoring the two subclades of each branch as independent tasks while depth
+ * is below FITCH_TASK_DEPTH, and joining them at their common ancestor; must
+ * be called from within a parallel region; relies on dirty branches always
+ * forming paths down to the root, so nothing below a clean branch is dirty */
+{
+    const long left = barray[top].left;		/* left child number */
+    const long right = barray[top].right;	/* right child number */
+
+    if (is_dirty(barray, top, n) == LVB_FALSE) return;
+
+    if (depth >= FITCH_TASK_DEPTH) {
+	fitch_clade_serial(barray, top, n, m, weights);
+	return;
+    }
+
+    #pragma omp task
+    fitch_clade_tasks(barray, left, n, m, weights, depth + 1);
+    fitch_clade_tasks(barray, right, n, m, weights, depth + 1);
+    #pragma omp taskwait
+
+    fitch_node(barray, top, m, weights);
+
+} /* end fitch_clade_tasks() */
+
+static void getplen_tasks(Branch *barray, const long root, const long m,
+    const long n, const long *weights)
+/* calculate state sets and changes for all dirty branches in the tree in
+ * barray (of root root), scoring independent subtrees concurrently */
+{
+    #pragma omp parallel
+    {
+	#pragma omp single
+	{
+	    #pragma omp task
+	    fitch_clade_tasks(barray, barray[root].left, n, m, weights, 0L);
+	    fitch_clade_tasks(barray, barray[root].right, n, m, weights, 0L);
+	    #pragma omp taskwait
+	}
+    }
+
+} /* end getplen_tasks() */
+
+#endif /* #ifdef _OPENMP */
+
+void fitch_sets(unsigned char *const dest, const unsigned char *const a,
+    const unsigned char *const b, const long m)
+/* set the m state sets in dest to those Fitch's algorithm gives to the
+ * parent of nodes with state sets a and b */
+{
+    long k;		/* current character number */
+    unsigned char ss;	/* intersection of state sets */
+
+    for (k = 0; k < m; k++) {
+	ss = (unsigned char) (a[k] & b[k]);
+	dest[k] = (ss != 0U) ? ss : (unsigned char) (a[k] | b[k]);
+    }
+
+} /* end fitch_sets() */
+
+long insert_cost(const unsigned char *const down, const unsigned char *const up,
+    const unsigned char *const leaf, const long m, const long *weights)
+/* return the increase in length on joining a leaf with state sets leaf to
+ * the branch between clades with Fitch state sets down and up */
+{
+    long k;		/* current character number */
+    long cost = 0;	/* return value */
+    unsigned char ss;	/* state set of branch */
+
+    for (k = 0; k < m; k++) {
+	ss = (unsigned char) (down[k] & up[k]);
+	if (ss == 0U) ss = (unsigned char) (down[k] | up[k]);
+	if ((ss & leaf[k]) == 0U) cost += weights[k];
+    }
+    return cost;
+
+} /* end insert_cost() */
+
 long getplen(Branch *barray, const long root, const long m, const long n, const long *weights)
 {
     long branch;			/* current branch number */
@@ -22,16 +159,38 @@ long getplen(Branch *barray, const long root, const long m, const long n, const
     long right;				/* current right child number */
     unsigned right_ss;			/* right state set */
     long todo_cnt = 0;			/* count of branches "to do" */
-    static long todo_arr[MAX_BRANCHES + 1];	/* list of "dirty" branch nos */
+    static long *todo_arr = NULL;	/* list of "dirty" branch nos */
+    static long todo_size = 0;		/* elements allocated in todo_arr */
+#ifdef _OPENMP
+    #pragma omp threadprivate(todo_arr, todo_size)
+#endif
 
     lvb_assert((n >= MIN_N) && (n <= MAX_N));
     lvb_assert((m >= MIN_M) && (m <= MAX_M));
     lvb_assert((root >= 0) && (root < branch_cnt));
 
+    /* "local" static heap memory, one list per thread - do not free! */
+    if (todo_size < branch_cnt) {
+	free(todo_arr);
+	todo_arr = alloc(branch_cnt * sizeof(long), "list of dirty branches");
+	todo_size = branch_cnt;
+    }
+
     for (i = n; i < branch_cnt; i++) {
     	if (barray[i].sset[0] == 0U) todo_arr[todo_cnt++] = i;
     }
 
+#ifdef _OPENMP
+    /* many dirty branches, e.g. after re-rooting: score subtrees in parallel */
+    if ((todo_cnt >= PARALLEL_FITCH_MIN) && (omp_get_max_threads() > 1)
+     && (!omp_in_parallel())) {
+	getplen_tasks(barray, root, m, n, weights);
+	for (i = 0; i < todo_cnt; i++) {
+	    if (barray[todo_arr[i]].sset[0] != 0U) done++;
+	}
+    }
+#endif /* #ifdef _OPENMP */
+
     /* calculate state sets and changes where not already known */
     while (done < todo_cnt) {
 		for (i = 0; i < todo_cnt; i++) {
@@ -42,17 +201,7 @@ long getplen(Branch *barray, const long root, const long m, const long n, const
 				right = barray[branch].right;
 				if ((barray[left].sset[0] != 0U) && (barray[right].sset[0] != 0U))
 				{
-					barray[branch].changes = 0;
-					for (k = 0; k < m; k++){
-						left_ss = barray[left].sset[k];
-						right_ss = barray[right].sset[k];
-						current_ss = left_ss & right_ss;
-						if (current_ss == 0U){
-							current_ss = left_ss | right_ss;
-							barray[branch].changes += weights[k];
-						}
-						barray[branch].sset[k] = current_ss;
-					}
+					fitch_node(barray, branch, m, weights);
 					done++;
 				}
 			}
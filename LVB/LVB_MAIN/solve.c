@@ -20,94 +20,474 @@ static void lenlog(FILE *lengthfp, long iteration, long length, double temperatu
 
 } /* end lenlog() */
 
-long deterministic_hillclimb(Dataptr matrix, Treestack *bstackp, const Branch *const inittree,
+typedef struct	/* FIFO of internal branches still to be tried */
+{
+    long *branch;	/* circular array of branch numbers */
+    Lvb_bool *queued;	/* element i LVB_TRUE if branch i is in the queue */
+    long size;		/* elements allocated in branch */
+    long head;		/* index in branch of front of queue */
+    long cnt;		/* number of branches in queue */
+} Worklist;
+
+static void worklist_push(Worklist *wl, const long branch, Lvb_bool front)
+/* add branch to the back of the worklist, or to the front if front is
+ * LVB_TRUE; do nothing if it is already there */
+{
+    if (wl->queued[branch] == LVB_TRUE) return;
+    lvb_assert(wl->cnt < wl->size);
+    if (front == LVB_TRUE) {
+	wl->head = (wl->head + wl->size - 1) % wl->size;
+	wl->branch[wl->head] = branch;
+    }
+    else wl->branch[(wl->head + wl->cnt) % wl->size] = branch;
+    wl->queued[branch] = LVB_TRUE;
+    wl->cnt++;
+
+} /* end worklist_push() */
+
+static long worklist_pop(Worklist *wl)
+/* remove and return the branch at the front of the worklist, which must not
+ * be empty */
+{
+    long branch;	/* return value */
+
+    lvb_assert(wl->cnt > 0);
+    branch = wl->branch[wl->head];
+    wl->head = (wl->head + 1) % wl->size;
+    wl->cnt--;
+    wl->queued[branch] = LVB_FALSE;
+    return branch;
+
+} /* end worklist_pop() */
+
+static void worklist_push_near(Dataptr matrix, Worklist *wl, const Branch *const tree,
+    const long u)
+/* add to the back of the worklist the internal branches of tree within two
+ * branches of branch u, whose NNIs are the ones affected by a change at u */
+{
+    long near[6];	/* nearby branches */
+    long v;		/* parent of u */
+    long i;		/* loop counter */
+
+    v = tree[u].parent;
+    near[0] = u;
+    near[1] = tree[u].left;
+    near[2] = tree[u].right;
+    near[3] = v;
+    near[4] = (tree[v].left == u) ? tree[v].right : tree[v].left;
+    near[5] = tree[v].parent;
+    for (i = 0; i < 6; i++) {
+	if ((near[i] != UNSET) && (near[i] >= matrix->n))
+	    worklist_push(wl, near[i], LVB_FALSE);
+    }
+
+} /* end worklist_push_near() */
+
+static long hillclimb(Dataptr matrix, Treestack *bstackp, const Branch *const inittree,
 		long root, FILE * const lenfp, const long *weights,
-		long *current_iter, Lvb_bool log_progress)
+		long *current_iter, Lvb_bool log_progress, const long maxtrees)
 /* perform a deterministic hill-climbing optimization on the tree in inittree,
  * using NNI on all internal branches until no changes are accepted; return the
  * length of the best tree found; current_iter should give the iteration number
  * at the start of this call and will be used in any statistics sent to lenfp,
- * and will be updated on return */
+ * and will be updated on return;
+ * branches are taken from a worklist in batches of HILLCLIMB_BATCH, and both
+ * NNIs at every branch of a batch are scored concurrently on per-thread
+ * scratch trees; the first acceptable move in batch order is then made, so
+ * the result does not depend on the number of threads; after a move only the
+ * nearby branches are tried again, followed by one full sweep to confirm no
+ * NNI anywhere in the tree is acceptable; the climb stops as soon as the
+ * length is the least possible for any tree, from getminlen(); moves that
+ * keep the length are not made once *bstackp holds maxtrees trees */
 {
     long nbranches = brcnt(matrix->n);		/* count of branches in tree */
     long i;				/* loop counter */
     long j;				/* loop counter */
-    long todo_cnt = 0;			/* count of internal branches */
     long len;				/* current length */
     long prev_len;			/* previous length */
     long lendash;			/* length of proposed new config */
+    long lenmin;			/* minimum length for any tree */
     long rootdash = root;		/* root of proposed new config */
     long deltalen;			/* change in length */
+    long batch_cnt;			/* branches in current batch */
+    long nthreads = 1;			/* number of scratch trees */
+    Lvb_bool moved = LVB_FALSE;		/* changed tree since last sweep */
     Lvb_bool newtree;			/* accepted a new configuration */
     Branch *x;				/* current configuration */
     Branch *xdash;			/* proposed new configuration */
-    static long todo[MAX_BRANCHES];	/* array of internal branch numbers */
+    Branch **scratch;			/* per-thread proposed configs */
+    long *batch;			/* branches in current batch */
+    long *batch_len;			/* lengths of proposed configs */
+    Worklist wl;			/* internal branches still to try */
     static Lvb_bool leftright[] = {	/* to loop through left and right */
     				LVB_FALSE, LVB_TRUE };
 
+#ifdef _OPENMP
+    nthreads = omp_get_max_threads();
+#endif
+
     /* "local" dynamic heap memory */
     x = treealloc(matrix);
     xdash = treealloc(matrix);
+    scratch = alloc(nthreads * sizeof(Branch *), "scratch tree pointers");
+    for (i = 0; i < nthreads; i++) scratch[i] = treealloc(matrix);
+    batch = alloc(HILLCLIMB_BATCH * sizeof(long), "hill-climbing batch");
+    batch_len = alloc(2 * HILLCLIMB_BATCH * sizeof(long), "hill-climbing lengths");
+    wl.size = nbranches - matrix->n;
+    wl.branch = alloc(wl.size * sizeof(long), "hill-climbing worklist");
+    wl.queued = alloc(nbranches * sizeof(Lvb_bool), "hill-climbing worklist flags");
+    wl.head = 0;
+    wl.cnt = 0;
+    for (i = 0; i < nbranches; i++) wl.queued[i] = LVB_FALSE;
 
     treecopy(matrix, x, inittree);      /* current configuration */
     len = getplen(x, root, matrix->m, matrix->n, weights);
     prev_len = len;
+    lenmin = getminlen(matrix, weights);
+
+    /* initially, try all internal branches */
+    for (i = matrix->n; i < nbranches; i++) worklist_push(&wl, i, LVB_FALSE);
+    lvb_assert(wl.cnt == nbranches - matrix->n);
 
-    /* identify internal branches */
-    for (i = matrix->n; i < nbranches; i++) todo[todo_cnt++] = i;
-    lvb_assert(todo_cnt == nbranches - matrix->n);
+    while ((wl.cnt > 0) && (len > lenmin)) {
+		batch_cnt = 0;
+		while ((wl.cnt > 0) && (batch_cnt < HILLCLIMB_BATCH))
+			batch[batch_cnt++] = worklist_pop(&wl);
 
-    do {
+		/* score both NNIs at every branch in the batch */
+		#pragma omp parallel for schedule(dynamic)
+		for (i = 0; i < 2 * batch_cnt; i++) {
+			Branch *s = scratch[0];	/* this thread's scratch tree */
+#ifdef _OPENMP
+			s = scratch[omp_get_thread_num()];
+#endif
+			mutate_deterministic(matrix, s, x, root, batch[i / 2], leftright[i % 2]);
+			batch_len[i] = getplen(s, root, matrix->m, matrix->n, weights);
+		}
+
+		/* make the first acceptable move, in batch order */
 		newtree = LVB_FALSE;
-		for (i = 0; i < todo_cnt; i++) {
-			for (j = 0; j < 2; j++) {
-				mutate_deterministic(matrix, xdash, x, root, todo[i], leftright[j]);
-				lendash = getplen(xdash, rootdash, matrix->m, matrix->n, weights);
-				lvb_assert (lendash >= 1L);
-				deltalen = lendash - len;
-				if (deltalen <= 0) {
-					if (deltalen < 0)  /* very best so far */
-					{
-						treestack_clear(bstackp);
-						len = lendash;
-					}
-					if (treestack_push(matrix, bstackp, xdash, rootdash) == 1) {
-						newtree = LVB_TRUE;
-						treeswap(&x, &root, &xdash, &rootdash);
-					}
+		for (i = 0; (i < 2 * batch_cnt) && (newtree == LVB_FALSE); i++) {
+			lendash = batch_len[i];
+			lvb_assert (lendash >= 1L);
+			deltalen = lendash - len;
+			if ((deltalen < 0) || ((deltalen == 0) && (treestack_cnt(*bstackp) < maxtrees))) {
+				mutate_deterministic(matrix, xdash, x, root, batch[i / 2], leftright[i % 2]);
+				rootdash = root;
+				getplen(xdash, rootdash, matrix->m, matrix->n, weights);
+				if (deltalen < 0)  /* very best so far */
+				{
+					treestack_clear(bstackp);
+					len = lendash;
 				}
-				if ((log_progress == LVB_TRUE) && ((len != prev_len) || ((*current_iter % STAT_LOG_INTERVAL) == 0))) {
-					lenlog(lenfp, *current_iter, len, 0);
+				if (treestack_push(matrix, bstackp, xdash, rootdash) == 1) {
+					newtree = LVB_TRUE;
+					moved = LVB_TRUE;
+					treeswap(&x, &root, &xdash, &rootdash);
+
+					/* untried branches of the batch go back to the front */
+					for (j = batch_cnt - 1; j > i / 2; j--)
+						worklist_push(&wl, batch[j], LVB_TRUE);
+					worklist_push_near(matrix, &wl, x, batch[i / 2]);
 				}
-				prev_len = len;
-				*current_iter += 1;
 			}
+			if ((log_progress == LVB_TRUE) && ((len != prev_len) || ((*current_iter % STAT_LOG_INTERVAL) == 0))) {
+				lenlog(lenfp, *current_iter, len, 0);
+			}
+			prev_len = len;
+			*current_iter += 1;
 		}
-    } while (newtree == LVB_TRUE);
+
+		/* confirm with a full sweep that no NNI anywhere is acceptable */
+		if ((wl.cnt == 0) && (moved == LVB_TRUE)) {
+			moved = LVB_FALSE;
+			for (i = matrix->n; i < nbranches; i++) worklist_push(&wl, i, LVB_FALSE);
+		}
+    }
 
     /* free "local" dynamic heap memory */
     free(x);
     free(xdash);
+    for (i = 0; i < nthreads; i++) free(scratch[i]);
+    free(scratch);
+    free(batch);
+    free(batch_len);
+    free(wl.branch);
+    free(wl.queued);
 
     return len;
-}
 
-long anneal(Dataptr matrix, Treestack *bstackp, const Branch *const inittree, long root,
-		const double t0, const long maxaccept, const long maxpropose,
+} /* end hillclimb() */
+
+long deterministic_hillclimb(Dataptr matrix, Treestack *bstackp, const Branch *const inittree,
+		long root, FILE * const lenfp, const long *weights,
+		long *current_iter, Lvb_bool log_progress)
+/* hillclimb() without limit on the trees found */
+{
+    return hillclimb(matrix, bstackp, inittree, root, lenfp, weights,
+	current_iter, log_progress, LONG_MAX);
+
+} /* end deterministic_hillclimb() */
+
+static void make_dirty_internal(Dataptr matrix, Branch *const tree)
+/* mark every internal branch of tree dirty, as needed before scoring it
+ * with different weights, since its changes depend on the weights */
+{
+    long i;	/* loop counter */
+
+    for (i = matrix->n; i < brcnt(matrix->n); i++) tree[i].sset[0] = 0U;
+
+} /* end make_dirty_internal() */
+
+static long ratchet_climb(Dataptr matrix, Treestack *sp, Branch *const tree,
+    long *rootp, const long *weights, long *current_iter)
+/* hill-climb from tree (of root *rootp) with weights weights, leaving up to
+ * RATCHET_MAX_TREES best trees found in *sp, which is first cleared, and one
+ * of them in tree with its root in *rootp; return their length */
+{
+    long len;	/* return value */
+
+    make_dirty_internal(matrix, tree);
+    treestack_clear(sp);
+    treestack_push(matrix, sp, tree, *rootp);
+    len = hillclimb(matrix, sp, tree, *rootp, NULL, weights, current_iter,
+	LVB_FALSE, RATCHET_MAX_TREES);
+    treestack_pop(matrix, tree, rootp, sp);
+    treestack_push(matrix, sp, tree, *rootp);
+    return len;
+
+} /* end ratchet_climb() */
+
+static long ratchet_run(Dataptr matrix, Treestack *bstackp, const Branch *const inittree,
+    long root, FILE *const lenfp, const long *weights, long *current_iter,
+    Lvb_bool log_progress, const long iterations, const long stall_max)
+/* ratchet(), stopping after iterations iterations or stall_max without a
+ * shorter tree, or once no shorter tree is possible */
+{
+    long m = matrix->m;			/* characters */
+    long it;				/* ratchet iteration */
+    long k;				/* loop counter */
+    long len;				/* length of current tree */
+    long lenbest;			/* best length so far */
+    long lenmin;			/* minimum length for any tree */
+    long stall = 0;			/* iterations without improvement */
+    long total;				/* total of perturbed weights */
+    long *resample;			/* bootstrap weights */
+    long *perturbed;			/* perturbed weights */
+    Branch *x;				/* current tree */
+    Treestack found;			/* best trees of latest climb */
+
+    /* "local" dynamic heap memory */
+    resample = alloc(m * sizeof(long), "resampled weights");
+    perturbed = alloc(m * sizeof(long), "perturbed weights");
+    x = treealloc(matrix);
+    found = treestack_new();
+
+    treecopy(matrix, x, inittree);
+    lenmin = getminlen(matrix, weights);
+    lenbest = ratchet_climb(matrix, &found, x, &root, weights, current_iter);
+    treestack_clear(bstackp);
+    treestack_transfer(matrix, bstackp, &found);
+    if (log_progress == LVB_TRUE) {
+	fprintf(lenfp, "\nRatchet:       Rearrangement: Length:\n");
+	fprintf(lenfp, "%-15ld%-15ld%-15ld\n", 0L, *current_iter, lenbest);
+    }
+
+    for (it = 1; (it <= iterations) && (stall < stall_max) && (lenbest > lenmin); it++) {
+	do {
+	    get_bootstrap_weights(resample, NULL, m, 0);
+	    total = 0;
+	    for (k = 0; k < m; k++) {
+		perturbed[k] = weights[k] * resample[k];
+		total += perturbed[k];
+	    }
+	} while (total == 0);
+	(void) ratchet_climb(matrix, &found, x, &root, perturbed, current_iter);
+	len = ratchet_climb(matrix, &found, x, &root, weights, current_iter);
+
+	if (len < lenbest) {
+	    treestack_clear(bstackp);
+	    lenbest = len;
+	    stall = 0;
+	}
+	else stall++;
+	if (len == lenbest) treestack_transfer(matrix, bstackp, &found);
+	else {	/* go back to a best tree */
+	    treestack_pop(matrix, x, &root, bstackp);
+	    treestack_push(matrix, bstackp, x, root);
+	}
+	if (log_progress == LVB_TRUE)
+	    fprintf(lenfp, "%-15ld%-15ld%-15ld\n", it, *current_iter, len);
+    }
+
+    /* free "local" dynamic heap memory */
+    free(resample);
+    free(perturbed);
+    free(x);
+    treestack_free(&found);
+
+    return lenbest;
+
+} /* end ratchet_run() */
+
+long ratchet(Dataptr matrix, Treestack *bstackp, const Branch *const inittree,
+    long root, FILE *const lenfp, const long *weights, long *current_iter,
+    Lvb_bool log_progress)
+/* seek parsimonious trees from the tree in inittree (of root root) by the
+ * parsimony ratchet (Nixon 1999): hill-climb, then repeatedly hill-climb
+ * with the weights in weights resampled as for a bootstrap replicate and
+ * then again with the weights themselves, until RATCHET_ITERATIONS
+ * iterations have been made or RATCHET_STALL have passed without a
+ * shorter tree, or until the best length is the least possible for any
+ * tree; each iteration starts from the tree the last one ended
+ * with if that is of the best length, otherwise from a best tree; the best
+ * trees are left in *bstackp, which is first cleared, and their length is
+ * returned; lenfp is for output of progress if log_progress is LVB_TRUE;
+ * *current_iter should give the iteration number at the start of this call
+ * and will be updated on return */
+{
+    return ratchet_run(matrix, bstackp, inittree, root, lenfp, weights, current_iter,
+	log_progress, RATCHET_ITERATIONS, RATCHET_STALL);
+
+} /* end ratchet() */
+
+static void copy_leaves(Dataptr matrix, Branch *const dest, const Branch *const src)
+/* copy the leaf statesets of src to dest; both trees must have objects
+ * 0..n-1 on branches 0..n-1, as given by randtree() */
+{
+    long i;	/* loop counter */
+
+    for (i = 0; i < matrix->n; i++)
+	memcpy(dest[i].sset, src[i].sset, matrix->m);
+
+} /* end copy_leaves() */
+
+typedef struct	/* state shared by the islands of an island-model search */
+{
+    Ctreestack store;	/* best trees published by any island */
+    long *island_len;	/* element i: best length published by island i */
+    long cnt;		/* number of islands */
+} Archipelago;
+
+static Lvb_bool migrate(Dataptr matrix, Archipelago *arch, const long island,
+    Treestack *bstackp, Branch **xp, long *rootp, Branch **xdashp, long *lenp,
+    long *lenbestp, const long *weights, const long lenmin)
+/* publish the best tree of island number island, held in its stack
+ * *bstackp, to the archipelago arch; if island is then the worst island, its
+ * current tree *xp (of root *rootp and length *lenp) is replaced by a copy of
+ * a globally best tree, perturbed by ISLAND_PERTURB random NNIs, and
+ * *lenbestp and *bstackp are updated if this tree is better than any found
+ * by the island so far; *xdashp is scratch space of the same size as *xp;
+ * return LVB_TRUE if some island has found a tree of length lenmin, the
+ * least possible, so the search is over, otherwise LVB_FALSE */
+{
+    long i;				/* loop counter */
+    long root;				/* root of tree being copied */
+    long rootdash;			/* root of perturbed tree */
+    long worst = 0;			/* worst island */
+    long restart = 0;			/* replace the current tree */
+    Lvb_bool optimal = LVB_FALSE;	/* return value */
+
+    /* get a copy of this island's best tree */
+    treestack_pop(matrix, *xdashp, &root, bstackp);
+    treestack_push(matrix, bstackp, *xdashp, root);
+
+    ctreestack_push(matrix, &arch->store, *xdashp, root, *lenbestp);
+
+    #pragma omp critical (lvb_archipelago)
+    {
+	arch->island_len[island] = *lenbestp;
+
+	/* ties are broken in favour of the lowest-numbered island, so
+	 * equally poor islands are not all restarted at once */
+	for (i = 1; i < arch->cnt; i++) {
+	    if (arch->island_len[i] > arch->island_len[worst]) worst = i;
+	}
+	for (i = 0; i < arch->cnt; i++) {
+	    if (arch->island_len[i] <= lenmin) optimal = LVB_TRUE;
+	}
+    }
+    if (optimal == LVB_TRUE) return LVB_TRUE;
+
+    if ((worst == island) && (*lenbestp > ctreestack_len(&arch->store)))
+	restart = ctreestack_get(matrix, &arch->store, *xp, rootp);
+
+    if (restart == 1) {
+	for (i = 0; i < ISLAND_PERTURB; i++) {
+	    rootdash = *rootp;
+	    mutate_nni(matrix, *xdashp, *xp, *rootp);
+	    treeswap(xp, rootp, xdashp, &rootdash);
+	}
+	*lenp = getplen(*xp, *rootp, matrix->m, matrix->n, weights);
+	if (*lenp <= *lenbestp) {
+	    if (*lenp < *lenbestp) treestack_clear(bstackp);
+	    treestack_push(matrix, bstackp, *xp, *rootp);
+	    *lenbestp = *lenp;
+	}
+    }
+    return LVB_FALSE;
+
+} /* end migrate() */
+
+/* kinds of rearrangement chosen by move_choose() */
+#define MOVE_NNI 0		/* nearest-neighbour interchange */
+#define MOVE_SPR_LOCAL 1	/* SPR within SPR_RADIUS branches */
+#define MOVE_SPR 2		/* SPR to anywhere */
+#define MOVE_TBR 3		/* tree bisection and reconnection */
+#define MOVE_KINDS 4		/* number of kinds of rearrangement */
+
+typedef struct	/* record of one kind of rearrangement in a temperature band */
+{
+    double proposed;	/* rearrangements proposed */
+    double accepted;	/* rearrangements accepted */
+    double improved;	/* rearrangements giving a shorter tree */
+} Move_stats;
+
+static long move_band(const double t, const double t0)
+/* return the temperature band of temperature t, for initial temperature
+ * t0: band i holds temperatures in (t0 / 2 ** (i + 1), t0 / 2 ** i] */
+{
+    long band;	/* return value */
+
+    if (t >= t0) return 0;
+    band = (long) (log_wrapper(t0 / t) / log_wrapper(2.0));
+    return (band < MOVE_BANDS) ? band : MOVE_BANDS - 1;
+
+} /* end move_band() */
+
+static int move_choose(const Move_stats *const stats)
+/* return a kind of rearrangement chosen at random, where stats gives the
+ * record of each kind in the current temperature band; each kind is
+ * chosen with probability at least MOVE_MIN_PROB, and the remaining
+ * probability is shared in proportion to the kinds' success rates, an
+ * improvement counting MOVE_IMPROVE_WEIGHT times as much as an acceptance */
+{
+    int i;			/* loop counter */
+    double rate[MOVE_KINDS];	/* success rate of each kind */
+    double total = 0.0;		/* sum of rates */
+    double r;			/* random point on the wheel */
+
+    for (i = 0; i < MOVE_KINDS; i++) {
+	rate[i] = (stats[i].accepted + MOVE_IMPROVE_WEIGHT * stats[i].improved + 1.0)
+	    / (stats[i].proposed + 2.0);
+	total += rate[i];
+    }
+    r = uni();
+    for (i = 0; i < MOVE_KINDS - 1; i++) {
+	r -= MOVE_MIN_PROB + (1.0 - MOVE_KINDS * MOVE_MIN_PROB) * rate[i] / total;
+	if (r < 0.0) break;
+    }
+    return i;
+
+} /* end move_choose() */
+
+static long anneal_run(Dataptr matrix, Treestack *bstackp, const Branch *const inittree,
+		long root, const double t0, const long maxaccept, const long maxpropose,
 		const long maxfail, FILE *const lenfp, const long *weights, long *current_iter,
-		const int cooling_schedule, Lvb_bool log_progress)
-/* seek parsimonious tree from initial tree in inittree (of root root)
- * with initial temperature t0, and subsequent temperatures obtained by
- * multiplying the current temperature by (t1 / t0) ** n * t0 where n is
- * the ordinal number of this temperature, after at least maxaccept changes
- * have been accepted or maxpropose changes have been proposed, whichever is
- * sooner;
- * return the length of the best tree(s) found after maxfail consecutive
- * temperatures have led to no new accepted solution;
- * lenfp is for output of current tree length and associated details;
- * *current_iter should give the iteration number at the start of this call and
- * will be used in any statistics sent to lenfp, and will be updated on
- * return */
+		const int cooling_schedule, const Lvb_bool adaptive_moves,
+		Lvb_bool log_progress, Archipelago *arch, const long island)
+/* anneal(), as island number island of the archipelago arch, if arch is
+ * not NULL */
 {
     long accepted = 0;		/* changes accespted */
     Lvb_bool dect;		/* should decrease temperature */
@@ -116,7 +496,6 @@ long anneal(Dataptr matrix, Treestack *bstackp, const Branch *const inittree, lo
     long failedcnt = 0; 	/* "failed count" for temperatures */
     long iter = 0;		/* iteration of mutate/evaluate loop */
     long len;			/* length of current tree */
-    long prev_len = UNSET;	/* length of previous tree */
     long lenbest;		/* bet length found so far */
     long lendash;		/* length of proposed new tree */
     long lenmin;		/* minimum length for any tree */
@@ -131,6 +510,20 @@ long anneal(Dataptr matrix, Treestack *bstackp, const Branch *const inittree, lo
     double t = t0;		/* current temperature */
     double grad_geom = 0.99;		/* "gradient" of the geometric schedule */
     double grad_linear = 3.64 * LVB_EPS; /* gradient of the linear schedule */
+    double energy;		/* energy of current tree */
+    double e_sum = 0.0;		/* sum of energies at this temperature */
+    double e_sumsq = 0.0;	/* sum of squared energies at this temp. */
+    double e_sd;		/* std. deviation of energy at this temp. */
+    long e_cnt = 0;		/* energies summed at this temperature */
+    double ratio;		/* t(n+1) / t(n) for adaptive schedule */
+    long uphill_proposed = 0;	/* changes for the worse proposed */
+    long uphill_accepted = 0;	/* changes for the worse accepted */
+    Lvb_bool frozen;		/* system considered frozen */
+    Move_stats stats[MOVE_BANDS][MOVE_KINDS];	/* record of rearrangements */
+    long band = 0;		/* current temperature band */
+    long new_band;		/* temperature band after cooling */
+    int move = MOVE_NNI;	/* kind of current rearrangement */
+    int i;			/* loop counter */
     Branch *x;			/* current configuration */
     Branch *xdash;		/* proposed new configuration */
 
@@ -152,14 +545,19 @@ long anneal(Dataptr matrix, Treestack *bstackp, const Branch *const inittree, lo
         fprintf(lenfp, "\nTemperature:   Rearrangement: Length:\n");
     }
 
-    lenmin = getminlen(matrix);
+    lenmin = getminlen(matrix, weights);
     r_lenmin = (double) lenmin;
 
-    while (1) {
+    for (i = 0; i < MOVE_KINDS; i++) {
+	stats[0][i].proposed = 0.0;
+	stats[0][i].accepted = 0.0;
+	stats[0][i].improved = 0.0;
+    }
+
+    while (lenbest > lenmin) {	/* until frozen, or no tree can be shorter */
         if ((log_progress == LVB_TRUE) && ((*current_iter % STAT_LOG_INTERVAL) == 0)) {
         	lenlog(lenfp, *current_iter, len, t);
         }
-		prev_len = len;
 		*current_iter += 1;
 
 		/* occasionally re-root, to prevent influence from root position */
@@ -170,21 +568,26 @@ long anneal(Dataptr matrix, Treestack *bstackp, const Branch *const inittree, lo
 		newtree = LVB_FALSE;
 		probaccd = LVB_FALSE;
 
-		/* mutation: alternate between the two mutation functions */
-		if (iter % 2){
-			rootdash = root;
-			mutate_spr(matrix, xdash, x, root);	/* global change */
-		}
-		else {
-			rootdash = root;
+		/* mutation: choose adaptively, or alternate between NNI and SPR */
+		if (adaptive_moves == LVB_TRUE)
+			move = move_choose(stats[band]);
+		else
+			move = (iter % 2) ? MOVE_SPR : MOVE_NNI;
+		rootdash = root;
+		if (move == MOVE_NNI)
 			mutate_nni(matrix, xdash, x, root);	/* local change */
-		}
+		else if (move == MOVE_SPR_LOCAL)
+			mutate_spr_local(matrix, xdash, x, root, SPR_RADIUS);
+		else if (move == MOVE_SPR)
+			mutate_spr(matrix, xdash, x, root);	/* global change */
+		else
+			mutate_tbr(matrix, xdash, x, root);	/* global change */
 
 		lendash = getplen(xdash, rootdash, matrix->m, matrix->n, weights);
 		lvb_assert (lendash >= 1L);
 		deltalen = lendash - len;
 		deltah = (r_lenmin / (double) len) - (r_lenmin / (double) lendash);
-		if (deltah > 1.0)	/* getminlen() problem with ambiguous sites */
+		if (deltah > 1.0)	/* cannot happen while lenmin <= len */
 			deltah = 1.0;
 		if (deltalen <= 0)	/* accept the change */
 		{
@@ -195,7 +598,6 @@ long anneal(Dataptr matrix, Treestack *bstackp, const Branch *const inittree, lo
 				newtree = LVB_TRUE;	/* new */
 			}
 			/* update current tree and its stats */
-			prev_len = len;
 			len = lendash;
 			treeswap(&x, &root, &xdash, &rootdash);
 
@@ -223,6 +625,7 @@ long anneal(Dataptr matrix, Treestack *bstackp, const Branch *const inittree, lo
 			 * than eps and ln eps is going to have greater
 			 * magnitude than eps, underflow when calculating
 			 * T * ln eps is not possible. */
+			uphill_proposed++;
 			if (-deltah < t * log_wrapper(LVB_EPS))
 			{
 				pacc = 0.0;
@@ -242,11 +645,22 @@ long anneal(Dataptr matrix, Treestack *bstackp, const Branch *const inittree, lo
 				}
 			}
 			if (probaccd == LVB_TRUE){
-				prev_len = len;
 				len = lendash;
+				uphill_accepted++;
 			}
 		}
 		proposed++;
+		stats[band][move].proposed += 1.0;
+		if ((deltalen <= 0) || (probaccd == LVB_TRUE))
+			stats[band][move].accepted += 1.0;
+		if (deltalen < 0)
+			stats[band][move].improved += 1.0;
+
+		/* energy statistics for the adaptive schedule */
+		energy = -r_lenmin / (double) len;
+		e_sum += energy;
+		e_sumsq += energy * energy;
+		e_cnt++;
 		if (newtree == LVB_TRUE)
 			accepted++;
 
@@ -259,7 +673,12 @@ long anneal(Dataptr matrix, Treestack *bstackp, const Branch *const inittree, lo
 		else if (proposed >= maxpropose)	/* enough proposals */
 		{
 			failedcnt++;
-			if (failedcnt >= maxfail && t < FROZEN_T)	/* system frozen */
+			if (cooling_schedule == 2)	/* adaptive freezing */
+				frozen = (uphill_accepted < ADAPTIVE_FROZEN * uphill_proposed)
+					? LVB_TRUE : LVB_FALSE;
+			else
+				frozen = (t < FROZEN_T) ? LVB_TRUE : LVB_FALSE;
+			if (failedcnt >= maxfail && frozen == LVB_TRUE)	/* system frozen */
 			{
 				/* Preliminary experiments yielded that the freezing
 				 * criterion used in previous versions of LVB is not
@@ -288,24 +707,571 @@ long anneal(Dataptr matrix, Treestack *bstackp, const Branch *const inittree, lo
 				else   /* decrease the temperature */
 					t = pow_wrapper(grad_geom, (double) t_n) * t0;
 			}
-			else /* Linear cooling */
+			else if (cooling_schedule == 1) /* Linear cooling */
 			{
 				t = t0 - grad_linear * t_n;
 				/* Make sure t doesn't go out of bounce */
 				if (t < DBL_EPSILON || t <= LVB_EPS)
 					t = LVB_EPS;
 			}
+			else /* Adaptive cooling */
+			{
+				/* t(n+1) = t(n) * exp(-lambda * t(n) / sd), where sd is
+				 * the standard deviation of the energy at t(n) (Huang,
+				 * Romeo and Sangiovanni-Vincentelli 1986), so cooling is
+				 * slow where the energy varies most */
+				e_sd = e_sumsq / e_cnt - (e_sum / e_cnt) * (e_sum / e_cnt);
+				e_sd = (e_sd > 0.0) ? sqrt(e_sd) : 0.0;
+				if (e_sd * -log_wrapper(ADAPTIVE_MIN_RATIO) < ADAPTIVE_LAMBDA * t)
+					ratio = ADAPTIVE_MIN_RATIO;
+				else
+					ratio = exp_wrapper(-ADAPTIVE_LAMBDA * t / e_sd);
+				if (ratio > ADAPTIVE_MAX_RATIO)
+					ratio = ADAPTIVE_MAX_RATIO;
+				t *= ratio;
+				if (t < LVB_EPS)
+					t = LVB_EPS;
+			}
+			/* a new band starts with half the record of the last */
+			new_band = move_band(t, t0);
+			for (; band < new_band; band++) {
+				for (i = 0; i < MOVE_KINDS; i++) {
+					stats[band + 1][i].proposed = stats[band][i].proposed / 2.0;
+					stats[band + 1][i].accepted = stats[band][i].accepted / 2.0;
+					stats[band + 1][i].improved = stats[band][i].improved / 2.0;
+				}
+			}
 			proposed = 0;
 			accepted = 0;
+			e_sum = 0.0;
+			e_sumsq = 0.0;
+			e_cnt = 0;
+			uphill_proposed = 0;
+			uphill_accepted = 0;
 			dect = LVB_FALSE;
+
+			if ((arch != NULL) && ((t_n % MIGRATION_INTERVAL) == 0)
+			    && (migrate(matrix, arch, island, bstackp, &x, &root, &xdash, &len,
+					&lenbest, weights, lenmin) == LVB_TRUE))
+				break;	/* another island has an optimal tree */
 		}
 		iter++;
     }
 
+    if (lenbest <= lenmin) {	/* no tree can be shorter */
+	if (log_progress == LVB_TRUE)
+	    lenlog(lenfp, *current_iter, lenbest, t);
+	if (arch != NULL) {
+	    #pragma omp critical (lvb_archipelago)
+	    arch->island_len[island] = lenbest;
+	}
+    }
+
     /* free "local" dynamic heap memory */
     free(x);
     free(xdash);
 
     return lenbest;
 
+} /* end anneal_run() */
+
+long anneal(Dataptr matrix, Treestack *bstackp, const Branch *const inittree, long root,
+		const double t0, const long maxaccept, const long maxpropose,
+		const long maxfail, FILE *const lenfp, const long *weights, long *current_iter,
+		const int cooling_schedule, const Lvb_bool adaptive_moves,
+		Lvb_bool log_progress)
+/* seek parsimonious tree from initial tree in inittree (of root root)
+ * with initial temperature t0, and subsequent temperatures obtained by
+ * multiplying the current temperature by (t1 / t0) ** n * t0 where n is
+ * the ordinal number of this temperature, after at least maxaccept changes
+ * have been accepted or maxpropose changes have been proposed, whichever is
+ * sooner;
+ * return the length of the best tree(s) found after maxfail consecutive
+ * temperatures have led to no new accepted solution, or as soon as a tree
+ * of the least length possible, from getminlen(), is found;
+ * lenfp is for output of current tree length and associated details;
+ * *current_iter should give the iteration number at the start of this call and
+ * will be used in any statistics sent to lenfp, and will be updated on
+ * return; if adaptive_moves is LVB_TRUE, the rearrangement is chosen
+ * by move_choose(), otherwise NNI and SPR alternate */
+{
+    return anneal_run(matrix, bstackp, inittree, root, t0, maxaccept, maxpropose,
+	maxfail, lenfp, weights, current_iter, cooling_schedule, adaptive_moves,
+	log_progress, NULL, 0);
+
 } /* end anneal() */
+
+long anneal_islands(Dataptr matrix, Treestack *bstackp, const Branch *const inittree,
+		long root, const double t0, const long maxaccept, const long maxpropose,
+		const long maxfail, FILE *const lenfp, const long *weights, long *current_iter,
+		const int cooling_schedule, const Lvb_bool adaptive_moves,
+		Lvb_bool log_progress, const long islands)
+/* as anneal(), but run islands independent annealing searches, each with its
+ * own random number stream, concurrently if compiled with OpenMP; island 0
+ * starts from inittree and the others from random trees; every
+ * MIGRATION_INTERVAL temperatures each island publishes its best tree, and
+ * the worst island continues from a globally best tree; only island 0 logs
+ * its progress; once any island finds a tree of the least length possible,
+ * the others stop at their next migration; the best trees of all islands
+ * are pushed onto *bstackp and *current_iter is increased by the
+ * iterations of all islands;
+ * N.B. with more than one thread, migration depends on timing, so results
+ * are not exactly reproducible */
+{
+    long i;				/* loop counter */
+    long lenbest = LONG_MAX;		/* best length of any island */
+    long iter0 = *current_iter;		/* iteration number on entry */
+    long next_seed;			/* seed for caller's stream afterwards */
+    long *seed;				/* element i: seed for island i */
+    long *island_len;			/* element i: best length of island i */
+    long *island_iter;			/* element i: iterations of island i */
+    Branch **start;			/* element i: start tree of island i */
+    Treestack *island_stack;		/* element i: best trees of island i */
+    Archipelago arch;			/* state shared by islands */
+
+    lvb_assert(islands >= 1);
+
+    /* "local" dynamic heap memory */
+    seed = alloc(islands * sizeof(long), "island seeds");
+    island_len = alloc(islands * sizeof(long), "island lengths");
+    island_iter = alloc(islands * sizeof(long), "island iterations");
+    start = alloc(islands * sizeof(Branch *), "island start trees");
+    island_stack = alloc(islands * sizeof(Treestack), "island tree stacks");
+    arch.store = ctreestack_new(CTREESTACK_SLOTS);
+    arch.island_len = alloc(islands * sizeof(long), "island best lengths");
+    arch.cnt = islands;
+
+    /* random choices are made here, in the caller's stream, so results with
+     * one thread depend only on the caller's seed */
+    for (i = 0; i < islands; i++) {
+	seed[i] = randpint(MAX_SEED);
+	island_iter[i] = *current_iter;
+	island_stack[i] = treestack_new();
+	arch.island_len[i] = LONG_MAX;
+	start[i] = treealloc(matrix);
+	if (i == 0) treecopy(matrix, start[i], inittree);
+	else {
+	    randtree(matrix, start[i]);
+	    copy_leaves(matrix, start[i], inittree);
+	}
+    }
+    next_seed = randpint(MAX_SEED);
+
+    #pragma omp parallel for schedule(static, 1)
+    for (i = 0; i < islands; i++) {
+	rinit((int) seed[i]);
+	island_len[i] = anneal_run(matrix, &island_stack[i], start[i],
+	    (i == 0) ? root : 0, t0, maxaccept, maxpropose, maxfail, lenfp,
+	    weights, &island_iter[i], cooling_schedule, adaptive_moves,
+	    (log_progress == LVB_TRUE) && (i == 0), &arch, i);
+    }
+    rinit((int) next_seed);
+
+    for (i = 0; i < islands; i++) {
+	if (island_len[i] < lenbest) lenbest = island_len[i];
+	*current_iter += island_iter[i] - iter0;
+    }
+    lvb_assert(lenbest <= ctreestack_len(&arch.store));
+
+    for (i = 0; i < islands; i++) {
+	if (island_len[i] == lenbest)
+	    treestack_transfer(matrix, bstackp, &island_stack[i]);
+	treestack_free(&island_stack[i]);
+	free(start[i]);
+    }
+
+    /* free "local" dynamic heap memory */
+    ctreestack_free(&arch.store);
+    free(arch.island_len);
+    free(island_stack);
+    free(start);
+    free(island_iter);
+    free(island_len);
+    free(seed);
+
+    return lenbest;
+
+} /* end anneal_islands() */
+
+typedef struct	/* a sector of a tree, for sectorial search */
+{
+    long top;			/* branch at the top of the sector */
+    long cnt;			/* subtrees hanging from the sector */
+    long leaf[SECTOR_SIZE];	/* element i: top branch of subtree i */
+    long node[SECTOR_SIZE];	/* element j: internal branch j of sector */
+    long seed;			/* seed for the search of the sector */
+    long iter;			/* iterations of the search of the sector */
+    Lvb_bool improved;		/* LVB_TRUE if sub is a shorter sector */
+    Branch *sub;		/* reduced tree for the sector */
+} Sector;
+
+static void up_sets(Dataptr matrix, const Branch *const tree, const long root,
+    unsigned char *const up)
+/* fill up, which has matrix->m elements for every branch, so that those for
+ * internal branch b of tree (of root root) are the Fitch state sets of the
+ * tree with the clade of b taken away, as seen from b; tree must be clean */
+{
+    const long m = matrix->m;	/* characters */
+    const long n = matrix->n;	/* objects */
+    long *todo;			/* stack of branches to visit */
+    long cnt = 0;		/* branches in todo */
+    long b;			/* current branch */
+    long left;			/* left child of b */
+    long right;			/* right child of b */
+
+    /* "local" dynamic heap memory */
+    todo = alloc(n * sizeof(long), "branches to visit");
+
+    left = tree[root].left;
+    right = tree[root].right;
+    fitch_sets(up + left * m, tree[root].sset, tree[right].sset, m);
+    fitch_sets(up + right * m, tree[root].sset, tree[left].sset, m);
+    todo[cnt++] = left;
+    todo[cnt++] = right;
+    while (cnt > 0) {
+	b = todo[--cnt];
+	if (b < n) continue;
+	left = tree[b].left;
+	right = tree[b].right;
+	fitch_sets(up + left * m, up + b * m, tree[right].sset, m);
+	fitch_sets(up + right * m, up + b * m, tree[left].sset, m);
+	todo[cnt++] = left;
+	todo[cnt++] = right;
+    }
+
+    free(todo);
+
+} /* end up_sets() */
+
+static Lvb_bool sector_grow(Dataptr matrix, const Branch *const tree,
+    Lvb_bool *const owner, const long top, Sector *const sp)
+/* make *sp the sector of tree with top branch top, growing it by random
+ * internal branches of its frontier until SECTOR_SIZE subtrees hang from
+ * it; element i of owner is LVB_TRUE for each internal branch i already in
+ * a sector, and is updated; return LVB_FALSE, leaving owner unchanged, if
+ * top is in another sector or fewer than SECTOR_MIN subtrees would hang
+ * from it, otherwise LVB_TRUE */
+{
+    long i;		/* loop counter */
+    long open;		/* frontier branches that may join the sector */
+    long pick;		/* choice of frontier branch */
+    long x;		/* branch joining the sector */
+    long ncnt = 0;	/* internal branches of sector below top */
+
+    if (owner[top] == LVB_TRUE) return LVB_FALSE;
+    owner[top] = LVB_TRUE;
+    sp->top = top;
+    sp->leaf[0] = tree[top].left;
+    sp->leaf[1] = tree[top].right;
+    sp->cnt = 2;
+
+    while (sp->cnt < SECTOR_SIZE) {
+	open = 0;
+	for (i = 0; i < sp->cnt; i++)
+	    if ((sp->leaf[i] >= matrix->n) && (owner[sp->leaf[i]] == LVB_FALSE)) open++;
+	if (open == 0) break;
+	pick = randpint(open - 1);
+	for (i = 0; pick >= 0; i++)
+	    if ((sp->leaf[i] >= matrix->n) && (owner[sp->leaf[i]] == LVB_FALSE)) pick--;
+	x = sp->leaf[i - 1];
+	owner[x] = LVB_TRUE;
+	sp->node[ncnt++] = x;
+	sp->leaf[i - 1] = tree[x].left;
+	sp->leaf[sp->cnt++] = tree[x].right;
+    }
+
+    if (sp->cnt < SECTOR_MIN) {
+	owner[top] = LVB_FALSE;
+	for (i = 0; i < ncnt; i++) owner[sp->node[i]] = LVB_FALSE;
+	return LVB_FALSE;
+    }
+    lvb_assert(ncnt == sp->cnt - 2);
+    return LVB_TRUE;
+
+} /* end sector_grow() */
+
+static long sector_id(const Sector *const sp, const long branch)
+/* return the number in the reduced tree for sector *sp of branch branch,
+ * which must be the top, an internal branch or a subtree of the sector */
+{
+    long i;	/* loop counter */
+
+    if (branch == sp->top) return 0;
+    for (i = 0; i < sp->cnt; i++) if (sp->leaf[i] == branch) return i + 1;
+    for (i = 0; i < sp->cnt - 2; i++) if (sp->node[i] == branch) return sp->cnt + 1 + i;
+    lvb_assert(0);
+    return UNSET;
+
+} /* end sector_id() */
+
+static long sector_branch(const Sector *const sp, const long id)
+/* return the branch of the full tree for number id in the reduced tree for
+ * sector *sp; the inverse of sector_id() */
+{
+    if (id == 0) return sp->top;
+    else if (id <= sp->cnt) return sp->leaf[id - 1];
+    else return sp->node[id - sp->cnt - 1];
+
+} /* end sector_branch() */
+
+static void sector_search(Dataptr matrix, const Branch *const tree,
+    const unsigned char *const up, const long *weights, Sector *const sp)
+/* search for a shorter arrangement of sector *sp of tree, whose up-pass
+ * state sets are in up, as a reduced tree whose leaves are the sector's
+ * subtrees, with their down-pass state sets, and the rest of the tree, with
+ * the up-pass state sets of the top; only characters that vary over these
+ * leaves are kept; if a shorter reduced tree is found, it is left in
+ * sp->sub and sp->improved is set, otherwise sp->sub is NULL; uses the
+ * random number stream seeded with sp->seed */
+{
+    const long m = matrix->m;		/* characters of full tree */
+    const long n_red = sp->cnt + 1;	/* objects of reduced tree */
+    long i;				/* loop counter */
+    long k;				/* loop counter */
+    long m_red = 0;			/* characters of reduced tree */
+    long len;				/* length of sector as it is */
+    long lenbest;			/* length of best reduced tree */
+    long root = 0;			/* root of reduced tree */
+    long x;				/* current branch of full tree */
+    long *w_red;			/* weights of reduced tree */
+    unsigned char ss;			/* intersection of state sets */
+    unsigned char **enc_red;		/* leaf state sets of reduced tree */
+    const unsigned char **src;		/* leaf state sets in full tree */
+    DataStructure reduced;		/* reduced data matrix */
+    Treestack found;			/* best reduced trees */
+
+    sp->sub = NULL;
+    sp->improved = LVB_FALSE;
+    sp->iter = 0;
+    rinit((int) sp->seed);
+
+    /* "local" dynamic heap memory */
+    src = alloc(n_red * sizeof(unsigned char *), "sector state sets");
+    enc_red = alloc(n_red * sizeof(unsigned char *), "reduced state sets");
+    w_red = alloc(m * sizeof(long), "reduced weights");
+    for (i = 0; i < n_red; i++) enc_red[i] = alloc(m, "reduced state sets");
+
+    /* keep characters that vary over the sector's leaves */
+    src[0] = up + sp->top * m;
+    for (i = 1; i < n_red; i++) src[i] = tree[sp->leaf[i - 1]].sset;
+    for (k = 0; k < m; k++) {
+	if (weights[k] == 0) continue;
+	ss = src[0][k];
+	for (i = 1; (i < n_red) && (ss != 0U); i++) ss &= src[i][k];
+	if (ss != 0U) continue;
+	for (i = 0; i < n_red; i++) enc_red[i][m_red] = src[i][k];
+	w_red[m_red++] = weights[k];
+    }
+
+    if (m_red > 0) {
+	reduced.row = (char **) enc_red;
+	reduced.rowtitle = NULL;
+	reduced.minsteps = NULL;
+	reduced.rowblock = NULL;
+	reduced.m = m_red;
+	reduced.n = n_red;
+	minsteps_init(&reduced);
+	sp->sub = treealloc(&reduced);
+
+	/* the reduced tree has the sector's shape, with the rest of the tree
+	 * as its root and the top as the junction below it */
+	sp->sub[0].parent = UNSET;
+	sp->sub[0].left = sector_id(sp, tree[sp->top].left);
+	sp->sub[0].right = sector_id(sp, tree[sp->top].right);
+	for (i = 1; i < brcnt(n_red); i++) {
+	    x = sector_branch(sp, i);
+	    sp->sub[i].parent = sector_id(sp, tree[x].parent);
+	    if (i < n_red) {
+		sp->sub[i].left = UNSET;
+		sp->sub[i].right = UNSET;
+	    }
+	    else {
+		sp->sub[i].left = sector_id(sp, tree[x].left);
+		sp->sub[i].right = sector_id(sp, tree[x].right);
+	    }
+	    sp->sub[i].changes = 0;
+	}
+	sp->sub[0].changes = 0;
+	ss_init(sp->sub, enc_red, brcnt(n_red), m_red);
+	len = getplen(sp->sub, root, m_red, n_red, w_red);
+
+	found = treestack_new();
+	lenbest = ratchet_run(&reduced, &found, sp->sub, root, NULL, w_red,
+	    &sp->iter, LVB_FALSE, SECTOR_ITERATIONS, SECTOR_STALL);
+	if (lenbest < len) {
+	    treestack_pop(&reduced, sp->sub, &root, &found);
+	    lvb_assert(root == 0);
+	    sp->improved = LVB_TRUE;
+	}
+	treestack_free(&found);
+    }
+
+    if (sp->improved == LVB_FALSE) {
+	free(sp->sub);
+	sp->sub = NULL;
+    }
+
+    /* free "local" dynamic heap memory */
+    if (m_red > 0) free(reduced.minsteps);
+    for (i = 0; i < n_red; i++) free(enc_red[i]);
+    free(enc_red);
+    free(src);
+    free(w_red);
+
+} /* end sector_search() */
+
+static void sector_dirty(Dataptr matrix, Branch *const tree, const long root,
+    const Sector *const sp)
+/* mark dirty the internal branches of sector *sp of tree (of root root), its
+ * top and all the top's ancestors */
+{
+    long i;	/* loop counter */
+    long x;	/* current branch */
+
+    for (i = 0; i < sp->cnt - 2; i++) tree[sp->node[i]].sset[0] = 0U;
+    for (x = sp->top; x != root; x = tree[x].parent) tree[x].sset[0] = 0U;
+
+} /* end sector_dirty() */
+
+static Lvb_bool sector_splice(Dataptr matrix, Branch *const tree, const long root,
+    const Sector *const sp, long *const lenp, const long *weights)
+/* replace sector *sp of tree (of root root and length *lenp) with the
+ * arrangement in sp->sub, keeping it and updating *lenp if the whole tree is
+ * then shorter; return LVB_TRUE if kept, otherwise LVB_FALSE */
+{
+    long i;				/* loop counter */
+    long x;				/* current branch of full tree */
+    long len;				/* length with new arrangement */
+    long top_left = tree[sp->top].left;		/* old left child of top */
+    long top_right = tree[sp->top].right;	/* old right child of top */
+    Branch node_old[SECTOR_SIZE];	/* old links of internal branches */
+    long leaf_parent[SECTOR_SIZE];	/* old parents of subtrees */
+
+    for (i = 0; i < sp->cnt - 2; i++) node_old[i] = tree[sp->node[i]];
+    for (i = 0; i < sp->cnt; i++) leaf_parent[i] = tree[sp->leaf[i]].parent;
+
+    tree[sp->top].left = sector_branch(sp, sp->sub[0].left);
+    tree[sp->top].right = sector_branch(sp, sp->sub[0].right);
+    for (i = 1; i < brcnt(sp->cnt + 1); i++) {
+	x = sector_branch(sp, i);
+	tree[x].parent = sector_branch(sp, sp->sub[i].parent);
+	if (i > sp->cnt) {
+	    tree[x].left = sector_branch(sp, sp->sub[i].left);
+	    tree[x].right = sector_branch(sp, sp->sub[i].right);
+	}
+    }
+    sector_dirty(matrix, tree, root, sp);
+    len = getplen(tree, root, matrix->m, matrix->n, weights);
+    if (len < *lenp) {
+	*lenp = len;
+	return LVB_TRUE;
+    }
+
+    /* no better: put back the old arrangement */
+    tree[sp->top].left = top_left;
+    tree[sp->top].right = top_right;
+    for (i = 0; i < sp->cnt - 2; i++) {
+	tree[sp->node[i]].parent = node_old[i].parent;
+	tree[sp->node[i]].left = node_old[i].left;
+	tree[sp->node[i]].right = node_old[i].right;
+    }
+    for (i = 0; i < sp->cnt; i++) tree[sp->leaf[i]].parent = leaf_parent[i];
+    sector_dirty(matrix, tree, root, sp);
+    len = getplen(tree, root, matrix->m, matrix->n, weights);
+    lvb_assert(len == *lenp);
+    return LVB_FALSE;
+
+} /* end sector_splice() */
+
+long sectorial(Dataptr matrix, Treestack *bstackp, const Branch *const inittree,
+    long root, FILE *const lenfp, const long *weights, long *current_iter,
+    Lvb_bool log_progress)
+/* improve the tree in inittree (of root root) by sectorial search
+ * (Goloboff 1999): in each round, cut the tree into disjoint sectors of up
+ * to SECTOR_SIZE subtrees, search each sector as a reduced data set by the
+ * parsimony ratchet, concurrently if compiled with OpenMP, and put back
+ * every sector arrangement that shortens the whole tree; stop after
+ * SECTORIAL_STALL rounds without a shorter tree; if a shorter tree than
+ * inittree is found, it replaces the contents of *bstackp, otherwise
+ * *bstackp is unchanged; return the length of the tree; lenfp is for
+ * output of progress if log_progress is LVB_TRUE; *current_iter should give
+ * the iteration number at the start of this call and will be updated on
+ * return */
+{
+    const long n = matrix->n;		/* objects */
+    const long nbranches = brcnt(n);	/* branches per tree */
+    long i;				/* loop counter */
+    long round;				/* current round */
+    long stall = 0;			/* rounds without improvement */
+    long tries;				/* sector tops to try per round */
+    long cnt;				/* sectors in current round */
+    long len;				/* current length */
+    long len0;				/* length of inittree */
+    long next_seed;			/* seed for caller's stream afterwards */
+    Lvb_bool improved;			/* shorter tree found this round */
+    Lvb_bool *owner;			/* LVB_TRUE for branches in a sector */
+    unsigned char *up;			/* up-pass state sets */
+    Sector *sector;			/* sectors of current round */
+    Branch *x;				/* current tree */
+
+    /* "local" dynamic heap memory */
+    x = treealloc(matrix);
+    up = alloc(nbranches * matrix->m, "up-pass state sets");
+    owner = alloc(nbranches * sizeof(Lvb_bool), "sector membership");
+    tries = n / SECTOR_SIZE + 1;
+    sector = alloc(tries * sizeof(Sector), "sectors");
+
+    treecopy(matrix, x, inittree);
+    len0 = len = getplen(x, root, matrix->m, n, weights);
+    if (log_progress == LVB_TRUE) {
+	fprintf(lenfp, "\nSectorial:     Rearrangement: Length:\n");
+	fprintf(lenfp, "%-15ld%-15ld%-15ld\n", 0L, *current_iter, len);
+    }
+
+    for (round = 1; stall < SECTORIAL_STALL; round++) {
+	up_sets(matrix, x, root, up);
+
+	/* random choices are made here, in the caller's stream, so results
+	 * do not depend on the number of threads */
+	for (i = 0; i < nbranches; i++) owner[i] = LVB_FALSE;
+	cnt = 0;
+	for (i = 0; i < tries; i++) {
+	    if (sector_grow(matrix, x, owner, n + randpint(n - 4), &sector[cnt]) == LVB_TRUE)
+		sector[cnt++].seed = randpint(MAX_SEED);
+	}
+	next_seed = randpint(MAX_SEED);
+
+	#pragma omp parallel for schedule(dynamic)
+	for (i = 0; i < cnt; i++)
+	    sector_search(matrix, x, up, weights, &sector[i]);
+	rinit((int) next_seed);
+
+	improved = LVB_FALSE;
+	for (i = 0; i < cnt; i++) {
+	    *current_iter += sector[i].iter;
+	    if (sector[i].improved == LVB_TRUE) {
+		if (sector_splice(matrix, x, root, &sector[i], &len, weights) == LVB_TRUE)
+		    improved = LVB_TRUE;
+		free(sector[i].sub);
+	    }
+	}
+	if (improved == LVB_TRUE) stall = 0;
+	else stall++;
+	if (log_progress == LVB_TRUE)
+	    fprintf(lenfp, "%-15ld%-15ld%-15ld\n", round, *current_iter, len);
+    }
+
+    if (len < len0) {
+	treestack_clear(bstackp);
+	treestack_push(matrix, bstackp, x, root);
+    }
+
+    /* free "local" dynamic heap memory */
+    free(sector);
+    free(owner);
+    free(up);
+    free(x);
+
+    return len;
+
+} /* end sectorial() */
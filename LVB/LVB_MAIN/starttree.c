@@ -0,0 +1,583 @@
+/* LVB
+ * (c) Copyright 2003-2012 by Daniel Barker.
+ * (c) Copyright 2013, 2014 by Daniel Barker and Maximilian Strobl.
+ * Permission is granted to copy and use this program provided that no fee is
+ * charged for it and provided that this copyright notice is not removed. */
+
+/**********
+
+=head1 NAME
+
+starttree.c - starting trees for the search
+
+=head1 DESCRIPTION
+
+Builds starting trees that are better than random ones, so less of the
+annealing schedule is spent improving a very poor tree.
+
+=cut
+
+**********/
+
+#include "lvb.h"
+
+/**********
+
+=head1 addtree - GET TREE BY STEPWISE ADDITION
+
+=head2 SYNOPSIS
+
+    void addtree(Dataptr matrix, Branch *const barray,
+    unsigned char **enc_mat, const long *weights);
+
+=head2 DESCRIPTION
+
+Fills C<barray> with a tree built by adding the objects one by one, in
+random order, each to the branch where it increases the tree length
+least. Ties go to the branch met first. The tree is in the same form as
+one from C<randtree()>: object I<i> is at branch I<i>, the root is branch
+0, and its state sets must be set by C<ss_init()> before it is scored.
+
+The increase in length for each branch is found from two sets of Fitch
+state sets: those of the clade below the branch, from the usual pass up
+from the leaves, and those of the rest of the tree, from a second pass
+down from the root. So every branch is tried in one pass over the tree
+rather than one scoring of the tree per branch. If compiled with OpenMP
+and there are at least C<ADDTREE_PARALLEL_MIN> states to compare, the
+branches are tried by several threads.
+
+=head2 PARAMETERS
+
+=head3 INPUT
+
+=over 4
+
+=item matrix
+
+The data matrix.
+
+=item enc_mat
+
+The state sets of the objects, as from C<dna_makebin()>.
+
+=item weights
+
+Weights of the characters.
+
+=back
+
+=head3 OUTPUT
+
+=over 4
+
+=item barray
+
+The new tree, which must have been allocated with C<treealloc()>.
+
+=back
+
+=cut
+
+**********/
+
+void addtree(Dataptr matrix, Branch *const barray, unsigned char **enc_mat,
+    const long *weights)
+{
+    const long n = matrix->n;		/* objects */
+    const long m = matrix->m;		/* characters */
+    long *order;			/* order of addition of objects */
+    long *node;				/* branches so far, parents first */
+    long *cost;				/* element i: cost of joining node[i] */
+    unsigned char *down;		/* state sets of clade below each branch */
+    unsigned char *up;			/* state sets of rest of tree */
+    long cnt;				/* branches so far */
+    long best;				/* index in node of cheapest branch */
+    long i;				/* loop counter */
+    long j;				/* loop counter */
+    long tmp;				/* for swapping */
+    long b;				/* current branch */
+    long p;				/* its parent */
+    long sib;				/* its sister */
+    long obj;				/* object being added */
+    long next = n;			/* next unused internal branch */
+    long root;				/* first object, the root */
+
+    lvb_assert(n >= MIN_N);
+
+    /* "local" dynamic heap memory */
+    order = alloc(n * sizeof(long), "addition order");
+    node = alloc(brcnt(n) * sizeof(long), "branches in order");
+    cost = alloc(brcnt(n) * sizeof(long), "addition costs");
+    down = alloc(brcnt(n) * m, "state sets of clades");
+    up = alloc(brcnt(n) * m, "state sets of rest of tree");
+
+    for (i = 0; i < n; i++) order[i] = i;
+    for (i = n - 1; i > 0; i--) {
+	j = randpint(i);
+	tmp = order[i];
+	order[i] = order[j];
+	order[j] = tmp;
+    }
+
+    /* start with tree of 3 objects */
+    treeclear(matrix, barray);
+    root = order[0];
+    barray[root].left = order[1];
+    barray[root].right = order[2];
+    barray[order[1]].parent = root;
+    barray[order[2]].parent = root;
+    memcpy(down + root * m, enc_mat[root], m);
+
+    for (i = 3; i < n; i++) {
+	obj = order[i];
+
+	/* list the branches, each after its parent */
+	cnt = 0;
+	node[cnt++] = root;
+	for (j = 0; j < cnt; j++) {
+	    b = node[j];
+	    if (barray[b].left != UNSET) {
+		node[cnt++] = barray[b].left;
+		node[cnt++] = barray[b].right;
+	    }
+	}
+
+	/* state sets of clades, working up from the leaves */
+	for (j = cnt - 1; j > 0; j--) {
+	    b = node[j];
+	    if (barray[b].left == UNSET) memcpy(down + b * m, enc_mat[b], m);
+	    else fitch_sets(down + b * m, down + barray[b].left * m,
+		down + barray[b].right * m, m);
+	}
+
+	/* state sets of the rest of the tree, working down from the root;
+	 * for the root, the rest of the tree is both its children */
+	fitch_sets(up + root * m, down + barray[root].left * m,
+	    down + barray[root].right * m, m);
+	for (j = 1; j < cnt; j++) {
+	    b = node[j];
+	    p = barray[b].parent;
+	    sib = (barray[p].left == b) ? barray[p].right : barray[p].left;
+	    fitch_sets(up + b * m, (p == root) ? down + root * m : up + p * m,
+		down + sib * m, m);
+	}
+
+	#pragma omp parallel for if (cnt * m >= ADDTREE_PARALLEL_MIN)
+	for (j = 0; j < cnt; j++) {
+	    cost[j] = insert_cost(down + node[j] * m, up + node[j] * m, enc_mat[obj],
+		m, weights);
+	}
+	best = 0;
+	for (j = 1; j < cnt; j++) if (cost[j] < cost[best]) best = j;
+
+	/* join obj to the branch above node[best] */
+	b = node[best];
+	if (b == root) {
+	    barray[next].left = barray[root].left;
+	    barray[next].right = barray[root].right;
+	    barray[barray[root].left].parent = next;
+	    barray[barray[root].right].parent = next;
+	    barray[root].left = next;
+	    barray[root].right = obj;
+	    barray[next].parent = root;
+	    barray[obj].parent = root;
+	}
+	else {
+	    p = barray[b].parent;
+	    if (barray[p].left == b) barray[p].left = next;
+	    else barray[p].right = next;
+	    barray[next].parent = p;
+	    barray[next].left = b;
+	    barray[next].right = obj;
+	    barray[b].parent = next;
+	    barray[obj].parent = next;
+	}
+	next++;
+    }
+    lvb_assert(next == brcnt(n));
+
+    if (root != 0) lvb_reroot(barray, root, 0);
+
+    /* free "local" dynamic heap memory */
+    free(order);
+    free(node);
+    free(cost);
+    free(down);
+    free(up);
+
+} /* end addtree() */
+
+#define STATE_BITS 5	/* bits used in state sets, A_BIT to O_BIT */
+#define WORD_BITS (CHAR_BIT * sizeof(unsigned long))	/* bits per word */
+
+#define DIST(d, i, j) ((i) > (j) ? (d)[i][j] : (d)[j][i])	/* distance of
+							 * i and j, i != j */
+
+static long tri_block_end(const long n, const long start, size_t *const bytesp)
+/* return the row after the last of a block of rows of an n-row lower-
+ * triangular matrix of floats starting at row start, taking as many rows
+ * as fit in MAX_ALLOC bytes, and set *bytesp to the block's size */
+{
+    long i;	/* loop counter */
+
+    *bytesp = 0;
+    for (i = start; (i < n) && (*bytesp + i * sizeof(float) <= MAX_ALLOC); i++)
+	*bytesp += i * sizeof(float);
+    return i;
+
+} /* end tri_block_end() */
+
+static float **tri_alloc(const long n)
+/* return a new n-row lower-triangular matrix of floats, as an array of
+ * rows, row i having i elements; rows are allocated in blocks, so no
+ * single allocation exceeds MAX_ALLOC bytes */
+{
+    float **row;	/* return value */
+    float *block;	/* current block of rows */
+    size_t bytes;	/* size of current block */
+    long start;		/* first row of current block */
+    long end;		/* row after current block */
+    long i;		/* loop counter */
+
+    row = alloc(n * sizeof(float *), "distance matrix rows");
+    row[0] = NULL;
+    for (start = 1; start < n; start = end) {
+	end = tri_block_end(n, start, &bytes);
+	lvb_assert(end > start);
+	block = alloc(bytes, "distance matrix");
+	for (i = start; i < end; i++) {
+	    row[i] = block;
+	    block += i;
+	}
+    }
+    return row;
+
+} /* end tri_alloc() */
+
+static void tri_free(float **row, const long n)
+/* free the n-row matrix row, from tri_alloc() */
+{
+    size_t bytes;	/* size of current block */
+    long start;		/* first row of current block */
+
+    for (start = 1; start < n; start = tri_block_end(n, start, &bytes))
+	free(row[start]);
+    free(row);
+
+} /* end tri_free() */
+
+static float **p_distances(Dataptr matrix, unsigned char **enc_mat)
+/* return a new lower-triangular matrix, from tri_alloc(), of the
+ * p-distances of the objects,
+ * the proportion of characters whose state sets do not overlap, for the
+ * state sets in enc_mat; to use all of each word, the state sets are
+ * first recast as one bit per character for each state, so the sites at
+ * which two objects overlap are found by ANDing and ORing words, and
+ * counted by popcount() */
+{
+    const long n = matrix->n;		/* objects */
+    const long m = matrix->m;		/* characters */
+    const long words = (m + WORD_BITS - 1) / WORD_BITS;	/* words per state */
+    unsigned long **plane;		/* bits for object i, state s in
+					 * words from s * words of plane[i] */
+    const unsigned long *a;		/* bits for first object */
+    const unsigned long *b;		/* bits for second object */
+    unsigned long overlap;		/* sites where states overlap */
+    float **d;				/* return value */
+    long i;				/* loop counter */
+    long j;				/* loop counter */
+    long k;				/* loop counter */
+    long s;				/* loop counter */
+    long same;				/* sites where states overlap */
+
+    plane = alloc(n * sizeof(unsigned long *), "state bit pointers");
+    for (i = 0; i < n; i++) {
+	plane[i] = alloc(STATE_BITS * words * sizeof(unsigned long), "state bits");
+	for (k = 0; k < STATE_BITS * words; k++) plane[i][k] = 0UL;
+	for (k = 0; k < m; k++) {
+	    for (s = 0; s < STATE_BITS; s++) {
+		if (enc_mat[i][k] & (1U << s))
+		    plane[i][s * words + k / WORD_BITS] |= 1UL << (k % WORD_BITS);
+	    }
+	}
+    }
+
+    d = tri_alloc(n);
+    #pragma omp parallel for schedule(dynamic) private(j, k, s, a, b, overlap, same)
+    for (i = 1; i < n; i++) {
+	for (j = 0; j < i; j++) {
+	    a = plane[i];
+	    b = plane[j];
+	    same = 0;
+	    for (k = 0; k < words; k++) {
+		overlap = 0UL;
+		for (s = 0; s < STATE_BITS; s++)
+		    overlap |= a[s * words + k] & b[s * words + k];
+		same += popcount(overlap);
+	    }
+	    d[i][j] = (float) (m - same) / (float) m;
+	}
+    }
+
+    for (i = 0; i < n; i++) free(plane[i]);
+    free(plane);
+    return d;
+
+} /* end p_distances() */
+
+static void nj_link(long *const nbr, long *const deg, const long a, const long b)
+/* record that nodes a and b of an unrooted tree are neighbours, where
+ * nbr holds up to 3 neighbours of each node and deg their number */
+{
+    lvb_assert((deg[a] < 3) && (deg[b] < 3));
+    nbr[a * 3 + deg[a]++] = b;
+    nbr[b * 3 + deg[b]++] = a;
+
+} /* end nj_link() */
+
+static void nj_to_branches(Dataptr matrix, Branch *const barray, const long *const nbr)
+/* fill barray with the unrooted tree whose nodes have neighbours given by
+ * nbr, as from nj_link(), where nodes 0..n-1 are objects, in randtree()'s
+ * layout, rooted on object 0 */
+{
+    const long n = matrix->n;		/* objects */
+    long *stack;			/* nodes still to visit */
+    long *from;				/* element i: node before node i */
+    long *br;				/* element i: branch of node i */
+    long cnt = 0;			/* nodes on stack */
+    long next = n;			/* next unused internal branch */
+    long junction;			/* neighbour of object 0 */
+    long v;				/* current node */
+    long w;				/* neighbour of current node */
+    long i;				/* loop counter */
+
+    /* "local" dynamic heap memory */
+    stack = alloc((2 * n - 2) * sizeof(long), "nodes to visit");
+    from = alloc((2 * n - 2) * sizeof(long), "previous nodes");
+    br = alloc((2 * n - 2) * sizeof(long), "branches of nodes");
+
+    treeclear(matrix, barray);
+
+    /* object 0's neighbour lies outside the data structure, so its other
+     * neighbours are the root's children */
+    junction = nbr[0];
+    for (i = 0; i < 3; i++) {
+	w = nbr[junction * 3 + i];
+	if (w != 0) {
+	    br[w] = (w < n) ? w : next++;
+	    from[w] = junction;
+	    stack[cnt++] = w;
+	    if (barray[0].left == UNSET) barray[0].left = br[w];
+	    else barray[0].right = br[w];
+	    barray[br[w]].parent = 0;
+	}
+    }
+
+    while (cnt > 0) {
+	v = stack[--cnt];
+	if (v < n) continue;	/* object, so leaf */
+	for (i = 0; i < 3; i++) {
+	    w = nbr[v * 3 + i];
+	    if (w != from[v]) {
+		br[w] = (w < n) ? w : next++;
+		from[w] = v;
+		stack[cnt++] = w;
+		if (barray[br[v]].left == UNSET) barray[br[v]].left = br[w];
+		else barray[br[v]].right = br[w];
+		barray[br[w]].parent = br[v];
+	    }
+	}
+    }
+    lvb_assert(next == brcnt(n));
+
+    /* free "local" dynamic heap memory */
+    free(stack);
+    free(from);
+    free(br);
+
+} /* end nj_to_branches() */
+
+/**********
+
+=head1 njtree - GET TREE BY NEIGHBOUR-JOINING
+
+=head2 SYNOPSIS
+
+    void njtree(Dataptr matrix, Branch *const barray,
+    unsigned char **enc_mat);
+
+=head2 DESCRIPTION
+
+Fills C<barray> with a neighbour-joining tree (Saitou and Nei 1987) of
+the p-distances of the objects, the proportion of characters at which
+their state sets do not overlap. The tree is in the same form as one
+from C<randtree()>: object I<i> is at branch I<i>, the root is branch 0,
+and its state sets must be set by C<ss_init()> before it is scored.
+
+Up to C<NJ_EXACT_MAX> objects, each step joins the pair of nodes that
+minimizes the neighbour-joining criterion, taking time proportional to
+the cube of the number of objects. For more objects, a relaxed version
+is used: each step finds the best partner of every node, and joins
+every pair of nodes that are each other's best partner. This usually
+joins a sizeable fraction of the nodes at once; if rounding leaves no
+such pair, the next step joins only the best pair overall, as the exact
+version does. If compiled with
+OpenMP, the distances and best partners are found by several threads.
+
+The distances are kept as single-precision numbers in a triangular
+matrix, so memory use is about twice the square of the number of
+objects, in bytes. The rows are allocated in blocks, so that no single
+allocation is too large for alloc().
+
+=head2 PARAMETERS
+
+=head3 INPUT
+
+=over 4
+
+=item matrix
+
+The data matrix.
+
+=item enc_mat
+
+The state sets of the objects, as from C<dna_makebin()>.
+
+=back
+
+=head3 OUTPUT
+
+=over 4
+
+=item barray
+
+The new tree, which must have been allocated with C<treealloc()>.
+
+=back
+
+=cut
+
+**********/
+
+void njtree(Dataptr matrix, Branch *const barray, unsigned char **enc_mat)
+{
+    const long n = matrix->n;		/* objects */
+    const Lvb_bool relaxed = (n > NJ_EXACT_MAX) ? LVB_TRUE : LVB_FALSE;
+    float **d;				/* distances between slots */
+    double *r;				/* element i: sum of distances of slot i */
+    long *node;				/* element i: node in slot i */
+    long *slot;				/* active slots */
+    long *partner;			/* element i: best partner of slot i */
+    double *q;				/* element i: criterion for partner */
+    long *nbr;				/* neighbours of each node */
+    long *deg;				/* number of neighbours of each node */
+    long active = n;			/* number of active slots */
+    long next = n;			/* next unused internal node */
+    long i;				/* loop counter */
+    long j;				/* loop counter */
+    long k;				/* loop counter */
+    long a;				/* slot of first node joined */
+    long b;				/* slot of second node joined */
+    long best;				/* best slot so far */
+    long joined;			/* pairs joined in current pass */
+    Lvb_bool stalled = LVB_FALSE;	/* last pass joined no pair */
+    double qij;				/* criterion for current pair */
+    double dab;				/* distance of joined nodes */
+    float dnew;				/* distance from new node */
+
+    /* "local" dynamic heap memory */
+    d = p_distances(matrix, enc_mat);
+    r = alloc(n * sizeof(double), "sums of distances");
+    node = alloc(n * sizeof(long), "nodes of slots");
+    slot = alloc(n * sizeof(long), "active slots");
+    partner = alloc(n * sizeof(long), "best partners");
+    q = alloc(n * sizeof(double), "criteria of best partners");
+    nbr = alloc((2 * n - 2) * 3 * sizeof(long), "neighbours");
+    deg = alloc((2 * n - 2) * sizeof(long), "numbers of neighbours");
+
+    for (i = 0; i < 2 * n - 2; i++) deg[i] = 0;
+    for (i = 0; i < n; i++) {
+	node[i] = i;
+	slot[i] = i;
+	r[i] = 0.0;
+	for (j = 0; j < n; j++) if (j != i) r[i] += DIST(d, i, j);
+    }
+
+    while (active > 3) {
+	/* best partner of each active slot */
+	#pragma omp parallel for schedule(dynamic) private(j, best, qij)
+	for (i = 0; i < active; i++) {
+	    best = UNSET;
+	    for (j = 0; j < active; j++) {
+		if (j == i) continue;
+		qij = (active - 2) * (double) DIST(d, slot[i], slot[j])
+		    - r[slot[i]] - r[slot[j]];
+		if ((best == UNSET) || (qij < q[slot[i]])) {
+		    best = slot[j];
+		    q[slot[i]] = qij;
+		}
+	    }
+	    partner[slot[i]] = best;
+	}
+	if ((relaxed == LVB_FALSE) || (stalled == LVB_TRUE)) {
+	    /* join only the best pair overall */
+	    best = slot[0];
+	    for (i = 1; i < active; i++) if (q[slot[i]] < q[best]) best = slot[i];
+	    for (i = 0; i < active; i++)
+		if ((slot[i] != best) && (slot[i] != partner[best])) partner[slot[i]] = UNSET;
+	    partner[partner[best]] = best;
+	}
+
+	/* join pairs that are each other's best partner; rounding can leave
+	 * none, and then the next pass joins the best pair overall */
+	joined = 0;
+	for (i = 0; (i < active) && (active > 3); i++) {
+	    a = slot[i];
+	    b = partner[a];
+	    if ((b == UNSET) || (partner[b] != a)) continue;
+	    partner[a] = UNSET;
+	    partner[b] = UNSET;
+
+	    /* new node replaces a's node in slot a */
+	    nj_link(nbr, deg, next, node[a]);
+	    nj_link(nbr, deg, next, node[b]);
+	    node[a] = next++;
+	    dab = DIST(d, a, b);
+	    r[a] = 0.0;
+	    for (k = 0; k < active; k++) {
+		j = slot[k];
+		if ((j == a) || (j == b)) continue;
+		dnew = (float) ((DIST(d, a, j) + DIST(d, b, j) - dab) / 2.0);
+		r[j] += dnew - DIST(d, a, j) - DIST(d, b, j);
+		r[a] += dnew;
+		if (a > j) d[a][j] = dnew;
+		else d[j][a] = dnew;
+	    }
+
+	    /* remove slot b, keeping the order of the others */
+	    for (k = 0; slot[k] != b; k++);
+	    for (; k < active - 1; k++) slot[k] = slot[k + 1];
+	    active--;
+	    joined++;
+	}
+	stalled = (joined == 0) ? LVB_TRUE : LVB_FALSE;
+    }
+
+    /* join the last three nodes */
+    for (i = 0; i < 3; i++) nj_link(nbr, deg, next, node[slot[i]]);
+    next++;
+    lvb_assert(next == 2 * n - 2);
+
+    nj_to_branches(matrix, barray, nbr);
+
+    /* free "local" dynamic heap memory */
+    tri_free(d, n);
+    free(r);
+    free(node);
+    free(slot);
+    free(partner);
+    free(q);
+    free(nbr);
+    free(deg);
+
+} /* end njtree() */
@@ -0,0 +1,77 @@
+/* LVB
+ * (c) Copyright 2003-2012 by Daniel Barker.
+ * (c) Copyright 2013, 2014 by Daniel Barker and Maximilian Strobl.
+ * Permission is granted to copy and use this program provided that no fee is
+ * charged for it and provided that this copyright notice is not removed. */
+
+#include <lvb.h>
+
+/* Test for addtree(). Makes data for objects in GROUPS groups, each
+ * object differing from its group's sequence at a few sites, and checks
+ * the tree from stepwise addition has object i at branch i, root 0, is
+ * well formed, and is shorter than any of a number of random trees. */
+
+#define N 40L		/* objects */
+#define M 60L		/* characters */
+#define GROUPS 4L	/* groups of similar objects */
+#define TREES 20L	/* random trees to compare */
+
+int main(void)
+{
+    extern Dataptr matrix;	/* data matrix */
+    static unsigned char *enc_mat[N];	/* encoded data matrix */
+    static unsigned char group[GROUPS][M];	/* state sets of groups */
+    static long weights[M];	/* weights for sites */
+    Branch *tree;		/* current tree */
+    long i;			/* loop counter */
+    long k;			/* loop counter */
+    long p;			/* current branch */
+    long len;			/* length of tree by stepwise addition */
+    Lvb_bool ok = LVB_TRUE;	/* test passed so far */
+
+    lvb_initialize();
+    rinit(42);
+
+    matrix = matalloc(N);
+    matrix->n = N;
+    matrix->m = M;
+    for (i = 0; i < GROUPS; i++)
+	for (k = 0; k < M; k++) group[i][k] = 1U << randpint(3);
+    for (i = 0; i < N; i++) {
+	enc_mat[i] = alloc(M, "state sets");
+	for (k = 0; k < M; k++) {
+	    if (randpint(9) == 0) enc_mat[i][k] = 1U << randpint(3);
+	    else enc_mat[i][k] = group[i % GROUPS][k];
+	}
+    }
+    for (k = 0; k < M; k++) weights[k] = 1;
+
+    tree = treealloc(matrix);
+    addtree(matrix, tree, enc_mat, weights);
+    if (tree[0].parent != UNSET) ok = LVB_FALSE;
+    for (i = 1; i < brcnt(N); i++) {
+	p = tree[i].parent;
+	if ((p == UNSET) || ((tree[p].left != i) && (tree[p].right != i)))
+	    ok = LVB_FALSE;
+	if ((i < N) && (tree[i].left != UNSET)) ok = LVB_FALSE;
+	if ((i >= N) && ((tree[i].left == UNSET) || (tree[i].right == UNSET)))
+	    ok = LVB_FALSE;
+    }
+    ss_init(tree, enc_mat, brcnt(N), M);
+    len = getplen(tree, 0, M, N, weights);
+
+    for (i = 0; i < TREES; i++) {
+	randtree(matrix, tree);
+	ss_init(tree, enc_mat, brcnt(N), M);
+	if (getplen(tree, 0, M, N, weights) <= len) ok = LVB_FALSE;
+    }
+
+    if (ok == LVB_TRUE) {
+	printf("test passed\n");
+	return EXIT_SUCCESS;
+    }
+    else {
+	printf("test failed\n");
+	return EXIT_FAILURE;
+    }
+}
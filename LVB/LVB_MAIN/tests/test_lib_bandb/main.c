@@ -0,0 +1,112 @@
+/* LVB
+ * (c) Copyright 2003-2012 by Daniel Barker.
+ * (c) Copyright 2013, 2014 by Daniel Barker and Maximilian Strobl.
+ * Permission is granted to copy and use this program provided that no fee is
+ * charged for it and provided that this copyright notice is not removed. */
+
+#include <lvb.h>
+
+/* Test for bandb(). Makes random weighted data with ambiguous states for N
+ * objects and checks that no random tree is shorter than the trees found,
+ * and that these have the length returned. Then checks that for 5 objects
+ * where each character has one object differing from the rest, all 15
+ * trees are found. */
+
+#define N 8L		/* objects */
+#define M 30L		/* characters */
+#define SAMPLES 20000L	/* random trees to compare */
+
+static Lvb_bool check_stack(Dataptr matrix, Treestack *sp,
+    unsigned char **enc_mat, const long *weights, const long len)
+/* return LVB_TRUE if every tree in sp is well formed and of length len,
+ * emptying sp */
+{
+    const long n = matrix->n;	/* objects */
+    Branch *tree;		/* current tree */
+    long i;			/* loop counter */
+    long p;			/* current parent */
+    long root;			/* root of current tree */
+    Lvb_bool ok = LVB_TRUE;	/* return value */
+
+    tree = treealloc(matrix);
+    while (treestack_cnt(*sp) > 0) {
+	treestack_pop(matrix, tree, &root, sp);
+	if (tree[root].parent != UNSET) ok = LVB_FALSE;
+	for (i = 0; i < brcnt(n); i++) {
+	    p = tree[i].parent;
+	    if ((i != root) && ((p == UNSET) || ((tree[p].left != i) && (tree[p].right != i))))
+		ok = LVB_FALSE;
+	    if ((i >= n) && ((tree[i].left == UNSET) || (tree[i].right == UNSET)))
+		ok = LVB_FALSE;
+	}
+	ss_init(tree, enc_mat, brcnt(n), matrix->m);
+	if (getplen(tree, root, matrix->m, n, weights) != len) ok = LVB_FALSE;
+    }
+    free(tree);
+    return ok;
+}
+
+int main(void)
+{
+    extern Dataptr matrix;	/* data matrix */
+    static unsigned char *enc_mat[N];	/* encoded data matrix */
+    static long weights[M];	/* weights for sites */
+    Branch *tree;		/* current tree */
+    Treestack stack;		/* trees found */
+    long i;			/* loop counter */
+    long k;			/* loop counter */
+    long iter = 0;		/* partial trees tried */
+    long len;			/* length of shortest trees */
+    long total = 0;		/* sum of weights */
+    Lvb_bool finished;		/* search finished */
+    Lvb_bool ok = LVB_TRUE;	/* test passed so far */
+
+    lvb_initialize();
+    rinit(42);
+
+    matrix = matalloc(N);
+    matrix->n = N;
+    matrix->m = M;
+    for (i = 0; i < N; i++) {
+	enc_mat[i] = alloc(M, "state sets");
+	for (k = 0; k < M; k++) {
+	    if (randpint(5) == 0) enc_mat[i][k] = (unsigned char) (1U + randpint(14));
+	    else enc_mat[i][k] = 1U << randpint(3);
+	}
+    }
+    for (k = 0; k < M; k++) weights[k] = 1 + randpint(2);
+
+    stack = treestack_new();
+    len = bandb(matrix, &stack, enc_mat, stdout, weights, &iter, LVB_FALSE, &finished);
+    if (finished != LVB_TRUE) ok = LVB_FALSE;
+    if ((treestack_cnt(stack) < 1) || (iter < 1)) ok = LVB_FALSE;
+
+    tree = treealloc(matrix);
+    for (i = 0; i < SAMPLES; i++) {
+	randtree(matrix, tree);
+	ss_init(tree, enc_mat, brcnt(N), M);
+	if (getplen(tree, 0, M, N, weights) < len) ok = LVB_FALSE;
+    }
+    if (check_stack(matrix, &stack, enc_mat, weights, len) != LVB_TRUE)
+	ok = LVB_FALSE;
+
+    /* one change per character in any tree: all are most parsimonious */
+    matrix->n = 5;
+    for (i = 0; i < 5; i++)
+	for (k = 0; k < M; k++) enc_mat[i][k] = (k % 5 == i) ? 2U : 1U;
+    for (k = 0; k < M; k++) total += weights[k];
+    len = bandb(matrix, &stack, enc_mat, stdout, weights, &iter, LVB_FALSE, &finished);
+    if (finished != LVB_TRUE) ok = LVB_FALSE;
+    if ((len != total) || (treestack_cnt(stack) != 15)) ok = LVB_FALSE;
+    if (check_stack(matrix, &stack, enc_mat, weights, len) != LVB_TRUE)
+	ok = LVB_FALSE;
+
+    if (ok == LVB_TRUE) {
+	printf("test passed\n");
+	return EXIT_SUCCESS;
+    }
+    else {
+	printf("test failed\n");
+	return EXIT_FAILURE;
+    }
+}
@@ -0,0 +1,89 @@
+/* LVB
+ * (c) Copyright 2003-2012 by Daniel Barker.
+ * (c) Copyright 2013, 2014 by Daniel Barker and Maximilian Strobl.
+ * Permission is granted to copy and use this program provided that no fee is
+ * charged for it and provided that this copyright notice is not removed. */
+
+#include <lvb.h>
+
+/* Test for treehash() and the concurrent tree stack. Checks that hashes
+ * do not depend on the root and agree with treecmp(), then has many
+ * threads push the same random trees, of three different lengths, in
+ * different orders, and checks the concurrent stack ends up holding the
+ * same trees as an ordinary tree stack given the shortest trees only. */
+
+#define N 7L		/* objects, so random trees often coincide */
+#define M 1L		/* characters */
+#define TREES 600L	/* random trees */
+#define THREADS 64	/* threads pushing at once */
+
+int main(void)
+{
+    extern Dataptr matrix;	/* data matrix */
+    static Branch *tree[TREES];	/* random trees */
+    static unsigned long hash[TREES];	/* their hashes */
+    Branch *copy;		/* re-rooted tree */
+    Treestack expected;		/* shortest trees, pushed serially */
+    Treestack got;		/* trees from concurrent stack */
+    Ctreestack store;		/* concurrent stack */
+    long i;			/* loop counter */
+    long j;			/* loop counter */
+    long newroot;		/* root after re-rooting */
+    Lvb_bool ok = LVB_TRUE;	/* test passed so far */
+
+    lvb_initialize();
+    rinit(42);
+
+    matrix = matalloc(N);
+    matrix->n = N;
+    matrix->m = M;
+
+    copy = treealloc(matrix);
+    for (i = 0; i < TREES; i++) {
+	tree[i] = treealloc(matrix);
+	randtree(matrix, tree[i]);
+	hash[i] = treehash(matrix, tree[i], 0);
+	treecopy(matrix, copy, tree[i]);
+	newroot = 1 + randpint(N - 2);
+	lvb_reroot(copy, 0, newroot);
+	if (treehash(matrix, copy, newroot) != hash[i]) ok = LVB_FALSE;
+    }
+    for (i = 0; i < TREES; i++) {
+	for (j = 0; j < i; j++) {
+	    if ((hash[i] == hash[j])
+		!= (treecmp(matrix, tree[i], 0, tree[j], 0) == 0)) ok = LVB_FALSE;
+	}
+    }
+
+    /* tree i has length 10 + i % 3 */
+    expected = treestack_new();
+    for (i = 0; i < TREES; i += 3) treestack_push(matrix, &expected, tree[i], 0);
+
+    store = ctreestack_new(CTREESTACK_SLOTS);
+#ifdef _OPENMP
+    #pragma omp parallel num_threads(THREADS) private(i, j)
+    {
+	j = omp_get_thread_num();
+	for (i = 0; i < TREES; i++)
+	    ctreestack_push(matrix, &store, tree[(TREES - 1 - i + 37 * j) % TREES], 0,
+		10 + ((TREES - 1 - i + 37 * j) % TREES) % 3);
+    }
+#else
+    for (i = 0; i < TREES; i++)
+	ctreestack_push(matrix, &store, tree[TREES - 1 - i], 0, 10 + (TREES - 1 - i) % 3);
+#endif
+    if (ctreestack_len(&store) != 10) ok = LVB_FALSE;
+    got = treestack_new();
+    if (ctreestack_transfer(matrix, &got, &store) != treestack_cnt(expected)) ok = LVB_FALSE;
+    if (treestack_transfer(matrix, &got, &expected) != 0) ok = LVB_FALSE;
+    if (ctreestack_len(&store) != LONG_MAX) ok = LVB_FALSE;
+
+    if (ok == LVB_TRUE) {
+	printf("test passed\n");
+	return EXIT_SUCCESS;
+    }
+    else {
+	printf("test failed\n");
+	return EXIT_FAILURE;
+    }
+}
@@ -0,0 +1,84 @@
+/* LVB
+ * (c) Copyright 2003-2012 by Daniel Barker.
+ * (c) Copyright 2013, 2014 by Daniel Barker and Maximilian Strobl.
+ * Permission is granted to copy and use this program provided that no fee is
+ * charged for it and provided that this copyright notice is not removed. */
+
+#include <lvb.h>
+
+/* Test for minsteps_init() and getminlen(). Each column of a small matrix
+ * of state sets has a known least number of changes, allowing for
+ * ambiguity codes and gaps. Checks the values kept with the matrix, the
+ * unweighted and weighted bounds, and that getminlen() gives the same
+ * bound for a matrix without them and does not keep them. */
+
+#define N 5L		/* objects */
+#define M 9L		/* characters */
+#define MIN_LEN 13L	/* least length with weight 1 */
+#define MIN_LEN_W 77L	/* least length with weight k + 1 for column k */
+
+#define A A_BIT
+#define C C_BIT
+#define G G_BIT
+#define T T_BIT
+#define O O_BIT
+#define K (G_BIT | T_BIT)
+#define M_ (A_BIT | C_BIT)
+#define N_ (A_BIT | C_BIT | G_BIT | T_BIT)
+#define R (A_BIT | G_BIT)
+#define W (A_BIT | T_BIT)
+#define Y (C_BIT | T_BIT)
+
+int main(void)
+{
+    extern Dataptr matrix;	/* data matrix */
+    static const char col[M][N] = {	/* state sets of each column */
+	{ A, A, N_, A, A },
+	{ A, C, M_, A, C },
+	{ A, C, G, T, T },
+	{ M_, R, W, A, A },
+	{ M_, K, M_, K, K },
+	{ R, Y, A, C, A },
+	{ A, C, G, T, O },
+	{ N_, N_, N_, N_, N_ },
+	{ A, C, G, T, N_ }
+    };
+    static const long steps[M] = { 0, 1, 3, 0, 1, 1, 4, 0, 3 };	/* answers */
+    static long weights[M];	/* weights of columns */
+    long i;			/* loop counter */
+    long k;			/* loop counter */
+    Lvb_bool ok = LVB_TRUE;	/* test passed so far */
+
+    lvb_initialize();
+
+    matrix = matalloc(N);
+    matrix->n = N;
+    matrix->m = M;
+    for (i = 0; i < N; i++) {
+	matrix->row[i] = alloc(M + 1, "row");
+	for (k = 0; k < M; k++) matrix->row[i][k] = col[k][i];
+	matrix->row[i][M] = '\0';
+    }
+    for (k = 0; k < M; k++) weights[k] = k + 1;
+
+    /* without minsteps_init() */
+    if (getminlen(matrix, NULL) != MIN_LEN) ok = LVB_FALSE;
+    if (getminlen(matrix, weights) != MIN_LEN_W) ok = LVB_FALSE;
+    if (matrix->minsteps != NULL) ok = LVB_FALSE;
+
+    /* with minsteps_init() */
+    minsteps_init(matrix);
+    for (k = 0; k < M; k++)
+	if (matrix->minsteps[k] != steps[k]) ok = LVB_FALSE;
+    if (getminlen(matrix, NULL) != MIN_LEN) ok = LVB_FALSE;
+    if (getminlen(matrix, weights) != MIN_LEN_W) ok = LVB_FALSE;
+
+    rowfree(matrix);
+    if (matrix->minsteps != NULL) ok = LVB_FALSE;
+    free(matrix->rowtitle);
+    free(matrix);
+
+    if (ok == LVB_TRUE) printf("test passed\n");
+    else printf("test failed\n");
+    exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,67 @@
+/* LVB
+ * (c) Copyright 2003-2012 by Daniel Barker.
+ * (c) Copyright 2013, 2014 by Daniel Barker and Maximilian Strobl.
+ * Permission is granted to copy and use this program provided that no fee is
+ * charged for it and provided that this copyright notice is not removed. */
+
+#include <lvb.h>
+
+/* Test for getplen() on fully dirty trees. Scores random trees on random
+ * data after re-rooting, which marks every internal branch dirty, and checks
+ * the length agrees with the length before re-rooting. If compiled with
+ * OpenMP, the re-rooted trees are scored with several threads, so the
+ * task-parallel path is compared against the serial path. */
+
+#define N 3000L		/* objects, enough to exceed PARALLEL_FITCH_MIN */
+#define M 40L		/* characters */
+#define TREES 20L	/* random trees to try */
+
+int main(void)
+{
+    extern Dataptr matrix;	/* data matrix */
+    static unsigned char *enc_mat[N];	/* encoded data matrix */
+    static long weights[M];	/* weights for sites */
+    Branch *tree;		/* current tree */
+    long i;			/* loop counter */
+    long k;			/* loop counter */
+    long len;			/* length before re-rooting */
+    long newroot;		/* root after re-rooting */
+    Lvb_bool all_same = LVB_TRUE;	/* lengths agree */
+
+    lvb_initialize();
+    rinit(42);
+
+    matrix = matalloc(N);
+    matrix->n = N;
+    matrix->m = M;
+    for (i = 0; i < N; i++) {
+	enc_mat[i] = alloc(M, "state sets");
+	for (k = 0; k < M; k++) enc_mat[i][k] = 1U << randpint(3);
+    }
+    for (k = 0; k < M; k++) weights[k] = 1 + randpint(2);
+
+    tree = treealloc(matrix);
+    for (i = 0; i < TREES; i++) {
+	randtree(matrix, tree);
+	ss_init(tree, enc_mat, brcnt(N), M);
+#ifdef _OPENMP
+	omp_set_num_threads(1);
+#endif
+	len = getplen(tree, 0, M, N, weights);
+	newroot = 1 + randpint(N - 2);
+	lvb_reroot(tree, 0, newroot);
+#ifdef _OPENMP
+	omp_set_num_threads(4);
+#endif
+	if (getplen(tree, newroot, M, N, weights) != len) all_same = LVB_FALSE;
+    }
+
+    if (all_same == LVB_TRUE) {
+	printf("test passed\n");
+	return EXIT_SUCCESS;
+    }
+    else {
+	printf("test failed\n");
+	return EXIT_FAILURE;
+    }
+}
@@ -0,0 +1,160 @@
+/* LVB
+ * (c) Copyright 2003-2012 by Daniel Barker.
+ * (c) Copyright 2013, 2014 by Daniel Barker and Maximilian Strobl.
+ * Permission is granted to copy and use this program provided that no fee is
+ * charged for it and provided that this copyright notice is not removed. */
+
+#include <lvb.h>
+
+int read_matrix_cache(char *cache_name, char *file_name, long options, long max_length,
+    DataStructure *p_lvbmat, long *p_counts, long *p_length_full);
+int write_matrix_cache(char *cache_name, char *file_name, long options, DataStructure *p_lvbmat,
+    const long *p_counts, long length_full);
+
+/* Test for write_matrix_cache() and read_matrix_cache(). Writes the cache
+ * of a small matrix for a small data file, checks the names, rows, site
+ * counts and number of columns read back are those written, then checks
+ * the cache is refused once one byte of the data file has changed, when
+ * the options differ, and once the cache has lost its last byte. */
+
+#define N 5L		/* objects */
+#define M 7L		/* characters kept */
+#define M_FULL 12L	/* characters in the data file */
+#define OPTIONS 3L	/* options the cache is made with */
+#define SOURCE "source.phy"	/* data file */
+#define CACHE "source.phy.lvbcache"	/* its cache */
+
+static const char *text = "5 12\n"	/* contents of the data file */
+    "alpha     ACGTACGTACGT\n"
+    "beta      ACGTACGTACGA\n"
+    "gamma     ACGTACGTACCA\n"
+    "delta     ACGTACGTTCCA\n"
+    "epsilon   ACGTACGATCCA\n";
+
+static void write_bytes(const char *name, const char *bytes, const long cnt)
+/* make file name hold the cnt bytes in bytes */
+{
+    FILE *fp;	/* the file */
+
+    fp = clnopen(name, "wb");
+    if (fwrite(bytes, 1, (size_t) cnt, fp) != (size_t) cnt)
+	crash("cannot write to file '%s'", name);
+    clnclose(fp, name);
+
+} /* end write_bytes() */
+
+static Lvb_bool refused(const long options)
+/* return LVB_TRUE if the cache is not read with options options, and
+ * leaves the matrix read into untouched, otherwise LVB_FALSE */
+{
+    DataStructure back;		/* matrix read back */
+    long count[M];		/* site counts read back */
+    long m_full = 0;		/* characters in file read back */
+
+    back.n = 0;
+    back.m = 0;
+    if (read_matrix_cache(CACHE, SOURCE, options, MAX_M, &back, count, &m_full) != 0)
+	return LVB_FALSE;
+    return ((back.n == 0) && (back.m == 0) && (m_full == 0)) ? LVB_TRUE : LVB_FALSE;
+
+} /* end refused() */
+
+static Lvb_bool same(const Dataptr matrix, const long *count)
+/* return LVB_TRUE if the cache is read with options OPTIONS, giving matrix,
+ * count and M_FULL, otherwise LVB_FALSE */
+{
+    DataStructure back;		/* matrix read back */
+    long count_back[M];		/* site counts read back */
+    long m_full = 0;		/* characters in file read back */
+    long i;			/* loop counter */
+    long k;			/* loop counter */
+    Lvb_bool val = LVB_TRUE;	/* return value */
+
+    if (read_matrix_cache(CACHE, SOURCE, OPTIONS, MAX_M, &back, count_back, &m_full) != 1)
+	return LVB_FALSE;
+    if ((back.n != matrix->n) || (back.m != matrix->m) || (m_full != M_FULL))
+	val = LVB_FALSE;
+    else {
+	for (i = 0; i < N; i++) {
+	    if (strcmp(back.rowtitle[i], matrix->rowtitle[i]) != 0) val = LVB_FALSE;
+	    if (strcmp(back.row[i], matrix->row[i]) != 0) val = LVB_FALSE;
+	}
+	for (k = 0; k < M; k++)
+	    if (count_back[k] != count[k]) val = LVB_FALSE;
+    }
+
+    for (i = 0; i < back.n; i++) free(back.rowtitle[i]);
+    free(back.rowtitle);
+    free(back.row);
+    free(back.rowblock);
+    return val;
+
+} /* end same() */
+
+int main(void)
+{
+    extern Dataptr matrix;	/* data matrix */
+    static long count[M] = { 1, 2, 1, 3, 1, 1, 2 };	/* site counts */
+    static const char *name[N] = {	/* object names */
+	"alpha", "beta", "gamma", "delta", "epsilon" };
+    static char cached[4096];	/* contents of the cache */
+    char *changed;		/* data file with one byte changed */
+    long cache_bytes;		/* bytes in the cache */
+    long i;			/* loop counter */
+    long k;			/* loop counter */
+    FILE *fp;			/* cache file */
+    Lvb_bool ok = LVB_TRUE;	/* test passed so far */
+
+    lvb_initialize();
+
+    /* state sets are never 0, so rows are strings */
+    matrix = matalloc(N);
+    matrix->n = N;
+    matrix->m = M;
+    for (i = 0; i < N; i++) {
+	matrix->rowtitle[i] = alloc(strlen(name[i]) + 1, "row title");
+	strcpy(matrix->rowtitle[i], name[i]);
+	matrix->row[i] = alloc(M + 1, "row");
+	for (k = 0; k < M; k++) matrix->row[i][k] = (char) (1 + (i + k) % 31);
+	matrix->row[i][M] = '\0';
+    }
+
+    /* the matrix written is the matrix read */
+    write_bytes(SOURCE, text, (long) strlen(text));
+    if (write_matrix_cache(CACHE, SOURCE, OPTIONS, matrix, count, M_FULL) != 1)
+	ok = LVB_FALSE;
+    if (same(matrix, count) != LVB_TRUE) ok = LVB_FALSE;
+
+    /* not for a data file of the same size with one byte changed, but
+     * again once it is changed back */
+    changed = alloc(strlen(text) + 1, "changed data file");
+    strcpy(changed, text);
+    changed[strlen(text) - 2] = 'G';
+    write_bytes(SOURCE, changed, (long) strlen(changed));
+    if (refused(OPTIONS) != LVB_TRUE) ok = LVB_FALSE;
+    write_bytes(SOURCE, text, (long) strlen(text));
+    if (same(matrix, count) != LVB_TRUE) ok = LVB_FALSE;
+
+    /* not with other options */
+    if (refused(OPTIONS + 1) != LVB_TRUE) ok = LVB_FALSE;
+
+    /* not once truncated */
+    fp = clnopen(CACHE, "rb");
+    cache_bytes = (long) fread(cached, 1, sizeof(cached), fp);
+    clnclose(fp, CACHE);
+    lvb_assert((cache_bytes > 0) && (cache_bytes < (long) sizeof(cached)));
+    write_bytes(CACHE, cached, cache_bytes - 1);
+    if (refused(OPTIONS) != LVB_TRUE) ok = LVB_FALSE;
+
+    clnremove(CACHE);
+    clnremove(SOURCE);
+    free(changed);
+    for (i = 0; i < N; i++) free(matrix->rowtitle[i]);
+    rowfree(matrix);
+    free(matrix->rowtitle);
+    free(matrix);
+
+    if (ok == LVB_TRUE) printf("test passed\n");
+    else printf("test failed\n");
+    exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,104 @@
+/* LVB
+ * (c) Copyright 2003-2012 by Daniel Barker.
+ * (c) Copyright 2013, 2014 by Daniel Barker and Maximilian Strobl.
+ * Permission is granted to copy and use this program provided that no fee is
+ * charged for it and provided that this copyright notice is not removed. */
+
+#include <lvb.h>
+
+/* Test for merge_patterns() and get_bootstrap_weights() with site counts.
+ * Makes a matrix whose columns are copies of PATTERNS different columns,
+ * checks they are merged, first occurrences first, with the right counts,
+ * and are kept by rowpack(), and checks bootstrap weights for the merged
+ * columns add up to the original number of sites, and are the same as for
+ * unmerged data when every count is 1. */
+
+#define N 6L		/* objects */
+#define PATTERNS 5L	/* different columns */
+#define COPIES 4L	/* copies of each */
+#define M (PATTERNS * COPIES)	/* characters */
+#define REPS 2000L	/* bootstrap resamples */
+
+int main(void)
+{
+    extern Dataptr matrix;	/* data matrix */
+    static char pattern[PATTERNS][N];	/* state sets of different columns */
+    static long count[M];	/* columns per merged column */
+    static long ones[M];	/* counts of 1 */
+    static long weights[M];	/* bootstrap weights */
+    static long weights2[M];	/* bootstrap weights for comparison */
+    static double total[PATTERNS];	/* sum of weights over resamples */
+    long i;			/* loop counter */
+    long k;			/* loop counter */
+    long rep;			/* loop counter */
+    long sum;			/* sum of weights */
+    Lvb_bool ok = LVB_TRUE;	/* test passed so far */
+
+    lvb_initialize();
+    rinit(7);
+
+    /* column j differs from the others at object j */
+    for (k = 0; k < PATTERNS; k++)
+	for (i = 0; i < N; i++) pattern[k][i] = (i == k) ? 2 : 1;
+
+    /* copies in the order 0 1 2 3 4 0 1 2 3 4 ... */
+    matrix = matalloc(N);
+    matrix->n = N;
+    matrix->m = M;
+    for (i = 0; i < N; i++) {
+	matrix->row[i] = alloc(M + 1, "row");
+	for (k = 0; k < M; k++) matrix->row[i][k] = pattern[k % PATTERNS][i];
+	matrix->row[i][M] = '\0';
+    }
+
+    if (merge_patterns(matrix, count) != M - PATTERNS) ok = LVB_FALSE;
+    if (matrix->m != PATTERNS) ok = LVB_FALSE;
+    for (k = 0; k < PATTERNS; k++) {
+	if (count[k] != COPIES) ok = LVB_FALSE;
+	for (i = 0; i < N; i++)
+	    if (matrix->row[i][k] != pattern[k][i]) ok = LVB_FALSE;
+    }
+    for (i = 0; i < N; i++)
+	if (matrix->row[i][PATTERNS] != '\0') ok = LVB_FALSE;
+
+    /* the merged rows are the same in one block */
+    rowpack(matrix);
+    for (i = 0; i < N; i++) {
+	if (matrix->row[i] != matrix->rowblock + i * (PATTERNS + 1)) ok = LVB_FALSE;
+	for (k = 0; k < PATTERNS; k++)
+	    if (matrix->row[i][k] != pattern[k][i]) ok = LVB_FALSE;
+	if (matrix->row[i][PATTERNS] != '\0') ok = LVB_FALSE;
+    }
+
+    /* resamples of merged columns have the original number of sites, and
+     * on average give each its number of copies */
+    for (rep = 0; rep < REPS; rep++) {
+	get_bootstrap_weights(weights, count, PATTERNS, 0);
+	sum = 0;
+	for (k = 0; k < PATTERNS; k++) {
+	    sum += weights[k];
+	    total[k] += (double) weights[k];
+	}
+	if (sum != M) ok = LVB_FALSE;
+    }
+    for (k = 0; k < PATTERNS; k++)
+	if ((total[k] / REPS < COPIES - 0.5) || (total[k] / REPS > COPIES + 0.5))
+	    ok = LVB_FALSE;
+
+    /* counts of 1 are the same as no counts */
+    for (k = 0; k < M; k++) ones[k] = 1;
+    rinit(11);
+    get_bootstrap_weights(weights, ones, M, 7);
+    rinit(11);
+    get_bootstrap_weights(weights2, NULL, M, 7);
+    for (k = 0; k < M; k++)
+	if (weights[k] != weights2[k]) ok = LVB_FALSE;
+
+    rowfree(matrix);
+    free(matrix->rowtitle);
+    free(matrix);
+
+    if (ok == LVB_TRUE) printf("test passed\n");
+    else printf("test failed\n");
+    exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,97 @@
+/* LVB
+ * (c) Copyright 2003-2012 by Daniel Barker.
+ * (c) Copyright 2013, 2014 by Daniel Barker and Maximilian Strobl.
+ * Permission is granted to copy and use this program provided that no fee is
+ * charged for it and provided that this copyright notice is not removed. */
+
+#include <lvb.h>
+
+/* Test for mutate_tbr() and mutate_spr_local(). Applies a long chain of
+ * random rearrangements to a random tree on random data, and after each
+ * checks the tree is well formed and that its length, found from the
+ * branches the rearrangement marked dirty, agrees with its length when
+ * every internal branch is dirty. */
+
+#define N 20L		/* objects */
+#define M 30L		/* characters */
+#define MOVES 2000L	/* rearrangements to try */
+
+static Lvb_bool well_formed(const Branch *const tree, const long root)
+/* return LVB_TRUE if each branch of tree (of root root) is a child of its
+ * parent and the objects are all reachable, LVB_FALSE otherwise */
+{
+    long i;		/* loop counter */
+    long p;		/* current branch */
+    long steps;		/* branches passed on way to root */
+
+    if (tree[root].parent != UNSET) return LVB_FALSE;
+    for (i = 0; i < brcnt(N); i++) {
+	if (i == root) continue;
+	p = tree[i].parent;
+	if ((p == UNSET) || ((tree[p].left != i) && (tree[p].right != i)))
+	    return LVB_FALSE;
+	if ((i >= N) && ((tree[i].left == UNSET) || (tree[i].right == UNSET)))
+	    return LVB_FALSE;
+	for (steps = 0, p = i; p != root; p = tree[p].parent)
+	    if (++steps > brcnt(N)) return LVB_FALSE;
+    }
+    return LVB_TRUE;
+}
+
+int main(void)
+{
+    extern Dataptr matrix;	/* data matrix */
+    static unsigned char *enc_mat[N];	/* encoded data matrix */
+    static long weights[M];	/* weights for sites */
+    Branch *x;			/* current tree */
+    Branch *xdash;		/* rearranged tree */
+    Branch *copy;		/* re-rooted copy */
+    long i;			/* loop counter */
+    long k;			/* loop counter */
+    long len;			/* length from dirty branches */
+    long newroot;		/* root after re-rooting */
+    Lvb_bool ok = LVB_TRUE;	/* test passed so far */
+
+    lvb_initialize();
+    rinit(42);
+
+    matrix = matalloc(N);
+    matrix->n = N;
+    matrix->m = M;
+    for (i = 0; i < N; i++) {
+	enc_mat[i] = alloc(M, "state sets");
+	for (k = 0; k < M; k++) enc_mat[i][k] = 1U << randpint(3);
+    }
+    for (k = 0; k < M; k++) weights[k] = 1;
+
+    x = treealloc(matrix);
+    xdash = treealloc(matrix);
+    copy = treealloc(matrix);
+    randtree(matrix, x);
+    ss_init(x, enc_mat, brcnt(N), M);
+    (void) getplen(x, 0, M, N, weights);
+
+    for (i = 0; i < MOVES; i++) {
+	if (i % 2) mutate_tbr(matrix, xdash, x, 0);
+	else mutate_spr_local(matrix, xdash, x, 0, 1 + randpint(3));
+	if (well_formed(xdash, 0) == LVB_FALSE) {
+	    ok = LVB_FALSE;
+	    break;
+	}
+	len = getplen(xdash, 0, M, N, weights);
+	treecopy(matrix, copy, xdash);
+	newroot = 1 + randpint(N - 2);
+	lvb_reroot(copy, 0, newroot);
+	if (getplen(copy, newroot, M, N, weights) != len) ok = LVB_FALSE;
+	treecopy(matrix, x, xdash);
+    }
+
+    if (ok == LVB_TRUE) {
+	printf("test passed\n");
+	return EXIT_SUCCESS;
+    }
+    else {
+	printf("test failed\n");
+	return EXIT_FAILURE;
+    }
+}
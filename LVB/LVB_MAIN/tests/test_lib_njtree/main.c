@@ -0,0 +1,77 @@
+/* LVB
+ * (c) Copyright 2003-2012 by Daniel Barker.
+ * (c) Copyright 2013, 2014 by Daniel Barker and Maximilian Strobl.
+ * Permission is granted to copy and use this program provided that no fee is
+ * charged for it and provided that this copyright notice is not removed. */
+
+#include <lvb.h>
+
+/* Test for njtree(). Makes a random tree and data with one change on each
+ * of its branches, so that the p-distances are additive on that tree, and
+ * checks that neighbour-joining recovers it exactly, both with few enough
+ * objects for exact neighbour-joining and with enough for the relaxed
+ * version. */
+
+#define N_EXACT 60L	/* objects for exact neighbour-joining */
+#define N_RELAXED 600L	/* objects for relaxed neighbour-joining */
+
+static Lvb_bool recovers(Dataptr matrix, const long n)
+/* return LVB_TRUE if njtree() recovers a random tree of n objects from
+ * data additive on it, otherwise LVB_FALSE */
+{
+    unsigned char **enc_mat;	/* encoded data matrix */
+    Branch *known;		/* tree the data are made from */
+    Branch *tree;		/* neighbour-joining tree */
+    long i;			/* loop counter */
+    long k;			/* loop counter */
+    long p;			/* current branch */
+    Lvb_bool ok;		/* return value */
+
+    matrix->n = n;
+    matrix->m = brcnt(n) - 1;	/* one character per branch but the root */
+    known = treealloc(matrix);
+    tree = treealloc(matrix);
+    randtree(matrix, known);
+
+    /* character p - 1 has state G in the objects below branch p, A
+     * elsewhere */
+    enc_mat = alloc(n * sizeof(unsigned char *), "encoded matrix");
+    for (i = 0; i < n; i++) {
+	enc_mat[i] = alloc(matrix->m, "state sets");
+	for (k = 0; k < matrix->m; k++) enc_mat[i][k] = A_BIT;
+	for (p = i; p != 0; p = known[p].parent) enc_mat[i][p - 1] = G_BIT;
+    }
+
+    njtree(matrix, tree, enc_mat);
+    ok = (treecmp(matrix, known, 0, tree, 0) == 0) ? LVB_TRUE : LVB_FALSE;
+
+    for (i = 0; i < n; i++) free(enc_mat[i]);
+    free(enc_mat);
+    free(known);
+    free(tree);
+    return ok;
+}
+
+int main(void)
+{
+    extern Dataptr matrix;	/* data matrix */
+    Lvb_bool ok = LVB_TRUE;	/* test passed so far */
+
+    lvb_initialize();
+    rinit(42);
+
+    lvb_assert(N_EXACT <= NJ_EXACT_MAX);
+    lvb_assert(N_RELAXED > NJ_EXACT_MAX);
+    matrix = matalloc(N_RELAXED);
+    if (recovers(matrix, N_EXACT) != LVB_TRUE) ok = LVB_FALSE;
+    if (recovers(matrix, N_RELAXED) != LVB_TRUE) ok = LVB_FALSE;
+
+    if (ok == LVB_TRUE) {
+	printf("test passed\n");
+	return EXIT_SUCCESS;
+    }
+    else {
+	printf("test failed\n");
+	return EXIT_FAILURE;
+    }
+}
@@ -0,0 +1,88 @@
+/* LVB
+ * (c) Copyright 2003-2012 by Daniel Barker.
+ * (c) Copyright 2013, 2014 by Daniel Barker and Maximilian Strobl.
+ * Permission is granted to copy and use this program provided that no fee is
+ * charged for it and provided that this copyright notice is not removed. */
+
+#include <lvb.h>
+
+/* Test for sectorial(). Makes data from a random tree, each character
+ * marking the objects below one of its branches, with some noise, then
+ * runs sectorial search from a random tree and again from its result,
+ * and checks each time that the length returned is no more than that of
+ * the tree searched from, and that the tree on top of the stack has the
+ * length returned. */
+
+#define N 120L		/* objects, enough for sectorial search */
+#define M 300L		/* characters */
+#define NOISE 10L	/* one in NOISE states is random */
+
+int main(void)
+{
+    extern Dataptr matrix;	/* data matrix */
+    static unsigned char *enc_mat[N];	/* encoded data matrix */
+    static long weights[M];	/* weights for sites */
+    Branch *model;		/* tree the data are made from */
+    Branch *tree;		/* tree to search from, then result */
+    Treestack stack;		/* trees found */
+    long i;			/* loop counter */
+    long k;			/* loop counter */
+    long p;			/* branch marked by current character */
+    long b;			/* branch on path from object to root */
+    long run;			/* loop counter */
+    long root = 0;		/* root of tree */
+    long iter = 0;		/* iterations of search */
+    long len;			/* length of tree searched from */
+    long found;			/* length returned */
+    Lvb_bool ok = LVB_TRUE;	/* test passed so far */
+
+    lvb_initialize();
+    rinit(42);
+
+    matrix = matalloc(N);
+    matrix->n = N;
+    matrix->m = M;
+    lvb_assert(N >= SECTORIAL_MIN_N);
+    model = treealloc(matrix);
+    randtree(matrix, model);
+    for (i = 0; i < N; i++) {
+	enc_mat[i] = alloc(M, "state sets");
+	for (k = 0; k < M; k++) enc_mat[i][k] = A_BIT;
+    }
+    for (k = 0; k < M; k++) {
+	p = 1 + randpint(brcnt(N) - 2);
+	for (i = 0; i < N; i++) {
+	    if (randpint(NOISE - 1) == 0)
+		enc_mat[i][k] = 1U << randpint(3);
+	}
+	for (i = 0; i < N; i++)
+	    for (b = i; b != 0; b = model[b].parent)
+		if (b == p) enc_mat[i][k] = G_BIT;
+	weights[k] = 1;
+    }
+
+    tree = treealloc(matrix);
+    stack = treestack_new();
+    randtree(matrix, tree);
+    for (run = 0; run < 2; run++) {
+	ss_init(tree, enc_mat, brcnt(N), M);
+	len = getplen(tree, root, M, N, weights);
+	treestack_clear(&stack);
+	treestack_push(matrix, &stack, tree, root);
+	found = sectorial(matrix, &stack, tree, root, stdout, weights, &iter,
+	    LVB_FALSE);
+	if (found > len) ok = LVB_FALSE;
+	treestack_pop(matrix, tree, &root, &stack);
+	ss_init(tree, enc_mat, brcnt(N), M);
+	if (getplen(tree, root, M, N, weights) != found) ok = LVB_FALSE;
+    }
+
+    if (ok == LVB_TRUE) {
+	printf("test passed\n");
+	return EXIT_SUCCESS;
+    }
+    else {
+	printf("test failed\n");
+	return EXIT_FAILURE;
+    }
+}
@@ -0,0 +1,111 @@
+/* LVB
+ * (c) Copyright 2003-2012 by Daniel Barker.
+ * (c) Copyright 2013, 2014 by Daniel Barker and Maximilian Strobl.
+ * Permission is granted to copy and use this program provided that no fee is
+ * charged for it and provided that this copyright notice is not removed. */
+
+#include <lvb.h>
+
+/* Test for treefuse(). Fuses TREES random trees, first for random data,
+ * then for data in which every character changes in one object only, so
+ * that all trees are of the same length and fusing cannot make a shorter
+ * one. Checks each time that the length returned is no more than that of
+ * the shortest tree fused and is the length of the tree on top of the
+ * stack, and, when it is not shorter, that every tree fused is still on
+ * the stack. */
+
+#define N 60L		/* objects */
+#define M 80L		/* characters */
+#define TREES 16L	/* trees to fuse */
+
+static Lvb_bool fuses(Dataptr matrix, unsigned char **enc_mat, const long *weights,
+    Lvb_bool *const shorter)
+/* return LVB_TRUE if fusing TREES random trees for data enc_mat passes the
+ * checks, otherwise LVB_FALSE; *shorter is set to LVB_TRUE if the fused
+ * tree is shorter than all of them, otherwise LVB_FALSE */
+{
+    static Branch *input[TREES];	/* trees to fuse */
+    static Lvb_bool kept[TREES];	/* input tree is still on the stack */
+    Branch *tree;			/* tree taken off the stack */
+    Treestack stack;			/* trees being fused */
+    long i;				/* loop counter */
+    long root;				/* root of tree */
+    long len;				/* length of current tree */
+    long lenbest = LONG_MAX;		/* length of shortest tree fused */
+    long fused;				/* length returned */
+    Lvb_bool ok = LVB_TRUE;		/* return value */
+
+    tree = treealloc(matrix);
+    stack = treestack_new();
+    for (i = 0; i < TREES; i++) {
+	input[i] = treealloc(matrix);
+	randtree(matrix, input[i]);
+	ss_init(input[i], enc_mat, brcnt(N), M);
+	len = getplen(input[i], 0, M, N, weights);
+	if (len < lenbest) lenbest = len;
+	treestack_push(matrix, &stack, input[i], 0);
+	kept[i] = LVB_FALSE;
+    }
+
+    fused = treefuse(matrix, &stack, weights);
+    if (fused > lenbest) ok = LVB_FALSE;
+    *shorter = (fused < lenbest) ? LVB_TRUE : LVB_FALSE;
+
+    treestack_pop(matrix, tree, &root, &stack);
+    treestack_push(matrix, &stack, tree, root);
+    ss_init(tree, enc_mat, brcnt(N), M);
+    if (getplen(tree, root, M, N, weights) != fused) ok = LVB_FALSE;
+
+    if (*shorter == LVB_FALSE) {
+	while (treestack_pop(matrix, tree, &root, &stack) == 1)
+	    for (i = 0; i < TREES; i++)
+		if (treecmp(matrix, input[i], 0, tree, root) == 0) kept[i] = LVB_TRUE;
+	for (i = 0; i < TREES; i++)
+	    if (kept[i] != LVB_TRUE) ok = LVB_FALSE;
+    }
+
+    for (i = 0; i < TREES; i++) free(input[i]);
+    treestack_free(&stack);
+    free(tree);
+    return ok;
+
+} /* end fuses() */
+
+int main(void)
+{
+    extern Dataptr matrix;	/* data matrix */
+    static unsigned char *enc_mat[N];	/* encoded data matrix */
+    static long weights[M];	/* weights for sites */
+    long i;			/* loop counter */
+    long k;			/* loop counter */
+    Lvb_bool shorter;		/* fused tree shorter than all fused */
+    Lvb_bool ok = LVB_TRUE;	/* test passed so far */
+
+    lvb_initialize();
+    rinit(42);
+
+    matrix = matalloc(N);
+    matrix->n = N;
+    matrix->m = M;
+    for (i = 0; i < N; i++) enc_mat[i] = alloc(M, "state sets");
+    for (k = 0; k < M; k++) weights[k] = 1;
+
+    for (i = 0; i < N; i++)
+	for (k = 0; k < M; k++) enc_mat[i][k] = 1U << randpint(3);
+    if (fuses(matrix, enc_mat, weights, &shorter) != LVB_TRUE) ok = LVB_FALSE;
+
+    /* character k changes in object k % N only, so every tree is M long */
+    for (i = 0; i < N; i++)
+	for (k = 0; k < M; k++) enc_mat[i][k] = (i == k % N) ? G_BIT : A_BIT;
+    if (fuses(matrix, enc_mat, weights, &shorter) != LVB_TRUE) ok = LVB_FALSE;
+    if (shorter != LVB_FALSE) ok = LVB_FALSE;
+
+    if (ok == LVB_TRUE) {
+	printf("test passed\n");
+	return EXIT_SUCCESS;
+    }
+    else {
+	printf("test failed\n");
+	return EXIT_FAILURE;
+    }
+}
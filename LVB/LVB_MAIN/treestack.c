@@ -52,13 +52,15 @@ static void upsize(Dataptr matrix, Treestack *sp)
  
 } /* end upsize() */
 
-static void dopush(Dataptr matrix, Treestack *sp, const Branch *const barray, const long root)
-/* push tree in barray (of root root) on to stack *sp */
+static void dopush(Dataptr matrix, Treestack *sp, const Branch *const barray, const long root,
+    const unsigned long hash)
+/* push tree in barray (of root root and topology hash hash) on to stack *sp */
 {
     lvb_assert(sp->next <= sp->size);
     if (sp->next == sp->size) upsize(matrix, sp);
     treecopy(matrix, sp->stack[sp->next].tree, barray);
     sp->stack[sp->next].root = root;
+    sp->stack[sp->next].hash = hash;
     sp->next++;
  
 } /* end dopush() */
@@ -149,8 +151,10 @@ Treestack treestack_new(void)
 =head2 DESCRIPTION
 
 Push copy of a tree onto an existing tree stack. Will not push if its
-topology is already present on the stack. The stack will increase its
-own memory allocation if necessary.
+topology is already present on the stack. Topologies are compared by
+their hashes from C<treehash()> first, so C<treecmp()> is only needed
+when hashes are equal. The stack will increase its own memory allocation
+if necessary.
 
 =head2 PARAMETERS
 
@@ -191,17 +195,20 @@ long treestack_push(Dataptr matrix, Treestack *sp, const Branch *const barray, c
     long i;			/* loop counter */
     Branch *stacktree = NULL;	/* current tree on stack */
     long stackroot;		/* root of current tree */
+    unsigned long hash;		/* topology hash of tree to push */
 
     /* return before push if not a new topology */
     /* check backwards as similar trees may be discovered together */
+    hash = treehash(matrix, barray, root);
     for (i = sp->next - 1; i >= 0; i--) {
+        if (sp->stack[i].hash != hash) continue;
         stacktree = sp->stack[i].tree;
         stackroot = sp->stack[i].root;
         if (treecmp(matrix, stacktree, stackroot, barray, root) == 0) return 0;
     }
 
     /* topology is new so must be pushed */
-    dopush(matrix, sp, barray, root);
+    dopush(matrix, sp, barray, root, hash);
     return 1;
 
 } /* end treestack_push() */
@@ -24,18 +24,18 @@ static void cr_chaf(const Branch *const barray, const long destination,
  const long newchild);
 static void cr_uxe(FILE *const stream, const char *const msg);
 static void fillsets(Objset *const sstruct, const Branch *const tree,
- const long root);
+ const long root, const long n);
 static void getobjs(const Branch *const barray, const long root,
- long *const objarr, long *const cnt);
+ long *const objarr, long *const cnt, const long n);
 static long getsister(const Branch *const barray, const long branch);
-static long makesets(const Branch *const tree_1, const long root_1,
+static long makesets(Dataptr matrix, const Branch *const tree_1, const long root_1,
  const Branch *const tree_2, const long root_2);
 static int objnocmp(const void *o1, const void *o2);
 static int osetcmp(const void *oset1, const void *oset2);
 static long *randleaf(Dataptr, Branch *const barray,
  const Lvb_bool *const leafmask, const long objs);
 static void realgetobjs(const Branch *const barray, const long root,
- long *const objarr, long *const cnt);
+ long *const objarr, long *const cnt, const long n);
 static Lvb_bool *randtopology(Dataptr, Branch *const barray, const long nobjs);
 static long setstcmp(Objset *const oset_1, Objset *const oset_2, const long nels);
 static void sort(Objset *const oset, const long nels);
@@ -44,10 +44,18 @@ static void tree_make_canonical(Dataptr, Branch *const barray, long *objnos);
 static void ur_print(Dataptr, FILE *const stream, const Branch *const barray, const long root);
 
 /* object sets for tree 1 in comparison */
-static Objset sset_1[MAX_N - 3] = { { NULL, 0 } };
+static Objset *sset_1 = NULL;
 
 /* object sets for tree 2 in comparison */
-static Objset sset_2[MAX_N - 3] = { { NULL, 0 } };
+static Objset *sset_2 = NULL;
+
+/* sets allocated in each of sset_1 and sset_2 */
+static long sset_cnt = 0;
+
+/* each thread compares trees in its own object sets */
+#ifdef _OPENMP
+#pragma omp threadprivate(sset_1, sset_2, sset_cnt)
+#endif
 
 void nodeclear(Branch *const barray, const long brnch)
 /* Initialize all scalars in branch brnch to UNSET or zero as appropriate,
@@ -254,43 +262,23 @@ from ancestor, LVB_FALSE otherwise */
 
 } /* end is_descendant() */
 
-void mutate_spr(Dataptr matrix, Branch *const desttree, const Branch *const sourcetree, long root)
-/* make a copy of the tree sourcetree (of root root) in desttree,
- * with a random change in topology, the change being caused by subtree
- * pruning and regrafting (SPR) rearrangement */
+static void spr_move(Dataptr matrix, Branch *const tree, const long root,
+    const long src, const long dest)
+/* move the clade at branch src of tree (of root root) to branch dest,
+ * which must not be src or its parent, sister or descendant or the root */
 {
-    long src;				/* branch to move */
-    long dest;				/* destination of branch to move */
     long dest_parent;			/* parent of destination branch */
     long src_parent;			/* parent of branch to move */
     long excess_br;			/* branch temporarily excised */
     long orig_child = UNSET;		/* original child of destination */
     long parents_par;			/* parent of parent of br. to move */
     long src_sister;			/* sister of branch to move */
-    Branch *tree;			/* destination tree */
-    long nbranches = brcnt(matrix->n);	/* branches in tree */
-
-    /* for ease of reading, make alias of desttree, tree */
-    tree = desttree;
-    treecopy(matrix, tree, sourcetree);
-
-    /* get random branch but not root and not root's immediate descendant */
-    do {
-    	src = randpint(nbranches - 1);
-    } while ((src == root) || (src == tree[root].left) || (src == tree[root].right));
 
     src_parent = tree[src].parent;
     lvb_assert(src_parent != UNSET);
     src_sister = getsister(tree, src);
     lvb_assert(src_sister != UNSET);
 
-    /* get destination that is not source or its parent, sister or descendant
-     * or the root */
-    do {
-    	dest = randpint(nbranches - 1);
-    } while ((dest == src) || (dest == src_parent) || (dest == src_sister)
-       || (dest == root) || is_descendant(tree, root, src, dest));
-
     /* excise source branch, leaving a damaged data structure */
     if (tree[src_parent].left == src) {
     	tree[src_parent].left = UNSET;
@@ -346,8 +334,255 @@ void mutate_spr(Dataptr matrix, Branch *const desttree, const Branch *const sour
     	make_dirty_below(matrix, tree, parents_par);
     }
 
+} /* end spr_move() */
+
+static long random_src(Dataptr matrix, const Branch *const tree, const long root)
+/* return a random branch of tree (of root root) that may be moved by SPR:
+ * not the root and not the root's immediate descendant */
+{
+    long nbranches = brcnt(matrix->n);	/* branches in tree */
+    long src;				/* return value */
+
+    do {
+    	src = randpint(nbranches - 1);
+    } while ((src == root) || (src == tree[root].left) || (src == tree[root].right));
+    return src;
+
+} /* end random_src() */
+
+static long random_dest(Dataptr matrix, Branch *const tree, const long root,
+    const long src)
+/* return a random destination for the clade at branch src of tree (of root
+ * root) that is not src or its parent, sister or descendant or the root */
+{
+    long nbranches = brcnt(matrix->n);	/* branches in tree */
+    long src_parent = tree[src].parent;	/* parent of branch to move */
+    long src_sister;			/* sister of branch to move */
+    long dest;				/* return value */
+
+    src_sister = getsister(tree, src);
+    lvb_assert(src_sister != UNSET);
+    do {
+    	dest = randpint(nbranches - 1);
+    } while ((dest == src) || (dest == src_parent) || (dest == src_sister)
+       || (dest == root) || is_descendant(tree, root, src, dest));
+    return dest;
+
+} /* end random_dest() */
+
+void mutate_spr(Dataptr matrix, Branch *const desttree, const Branch *const sourcetree, long root)
+/* make a copy of the tree sourcetree (of root root) in desttree,
+ * with a random change in topology, the change being caused by subtree
+ * pruning and regrafting (SPR) rearrangement */
+{
+    long src;				/* branch to move */
+    long dest;				/* destination of branch to move */
+    Branch *tree;			/* destination tree */
+
+    /* for ease of reading, make alias of desttree, tree */
+    tree = desttree;
+    treecopy(matrix, tree, sourcetree);
+
+    /* get random branch but not root and not root's immediate descendant */
+    src = random_src(matrix, tree, root);
+
+    /* get destination that is not source or its parent, sister or descendant
+     * or the root */
+    dest = random_dest(matrix, tree, root, src);
+
+    spr_move(matrix, tree, root, src, dest);
+
 } /* end mutate_spr() */
 
+/* "local" static heap memory for mutate_spr_local() and mutate_tbr(), one
+ * set per thread - do not free! */
+static long *scratch_br = NULL;		/* branches found */
+static long *scratch_stamp = NULL;	/* element i: visit mark of branch i */
+static long *scratch_depth = NULL;	/* element i: distance of found br. i */
+static long scratch_size = 0;		/* elements in each array */
+static long scratch_visit = 0;		/* current visit mark */
+#ifdef _OPENMP
+#pragma omp threadprivate(scratch_br, scratch_stamp, scratch_depth, scratch_size, scratch_visit)
+#endif
+
+static void scratch_init(Dataptr matrix)
+/* make the scratch arrays big enough for trees of matrix, and start a new
+ * visit, in which no branch is yet marked */
+{
+    long nbranches = brcnt(matrix->n);	/* branches in tree */
+    long i;				/* loop counter */
+
+    if (scratch_size < nbranches) {
+	free(scratch_br);
+	free(scratch_stamp);
+	free(scratch_depth);
+	scratch_br = alloc(nbranches * sizeof(long), "found branches");
+	scratch_stamp = alloc(nbranches * sizeof(long), "branch marks");
+	scratch_depth = alloc(nbranches * sizeof(long), "branch distances");
+	for (i = 0; i < nbranches; i++) scratch_stamp[i] = 0;
+	scratch_size = nbranches;
+	scratch_visit = 0;
+    }
+    scratch_visit++;
+
+} /* end scratch_init() */
+
+static long near_dests(Dataptr matrix, const Branch *const tree, const long root,
+    const long src, const long radius)
+/* fill scratch_br with the destinations for the clade at branch src of
+ * tree (of root root) that are at most radius branches from its present
+ * position, not counting its parent and sister, and return their number */
+{
+    long src_parent = tree[src].parent;	/* parent of branch to move */
+    long src_sister;			/* sister of branch to move */
+    long near[4];			/* neighbours of current branch */
+    long head = 0;			/* next branch found to visit */
+    long cnt = 0;			/* branches found */
+    long dests = 0;			/* destinations found */
+    long br;				/* current branch */
+    long par;				/* parent of current branch */
+    long i;				/* loop counter */
+
+    src_sister = getsister(tree, src);
+    scratch_init(matrix);
+    scratch_stamp[src] = scratch_visit;		/* never enter the clade */
+    scratch_stamp[src_parent] = scratch_visit;
+    scratch_stamp[src_sister] = scratch_visit;
+    scratch_br[cnt] = src_parent;
+    scratch_depth[cnt++] = 0;
+    scratch_br[cnt] = src_sister;
+    scratch_depth[cnt++] = 0;
+
+    /* breadth-first search of the branches, which are adjacent if they meet
+     * at a node; the branches found are kept in visiting order, so the
+     * destinations found can overwrite those already visited */
+    while (head < cnt) {
+	br = scratch_br[head];
+	if (scratch_depth[head] > 0) scratch_br[dests++] = br;
+	if (scratch_depth[head] < radius) {
+	    par = tree[br].parent;
+	    near[0] = getsister(tree, br);
+	    near[1] = (par == root) ? UNSET : par;
+	    near[2] = tree[br].left;
+	    near[3] = tree[br].right;
+	    for (i = 0; i < 4; i++) {
+		if ((near[i] != UNSET) && (scratch_stamp[near[i]] != scratch_visit)) {
+		    scratch_stamp[near[i]] = scratch_visit;
+		    scratch_br[cnt] = near[i];
+		    scratch_depth[cnt++] = scratch_depth[head] + 1;
+		}
+	    }
+	}
+	head++;
+    }
+
+    return dests;
+
+} /* end near_dests() */
+
+void mutate_spr_local(Dataptr matrix, Branch *const desttree,
+    const Branch *const sourcetree, long root, const long radius)
+/* make a copy of the tree sourcetree (of root root) in desttree,
+ * with a random change in topology, the change being caused by SPR
+ * rearrangement to a destination at most radius branches away */
+{
+    long src;				/* branch to move */
+    long cnt;				/* possible destinations */
+    Branch *tree;			/* destination tree */
+
+    /* for ease of reading, make alias of desttree, tree */
+    tree = desttree;
+    treecopy(matrix, tree, sourcetree);
+
+    do {
+	src = random_src(matrix, tree, root);
+	cnt = near_dests(matrix, tree, root, src, radius);
+    } while (cnt == 0);
+
+    spr_move(matrix, tree, root, src, scratch_br[randpint(cnt - 1)]);
+
+} /* end mutate_spr_local() */
+
+static long reroot_clade(Branch *const tree, const long top, const long target)
+/* re-root the clade at branch top of tree so that its attachment point
+ * lies on branch target, a descendant of top, keeping its unrooted
+ * topology; the internal branches changed are put in scratch_br and their
+ * number is returned */
+{
+    long a;		/* child of top on the path to target */
+    long a1 = UNSET;	/* child of a on the path to target */
+    long a2;		/* other child of a */
+    long b;		/* other child of top */
+    long cnt = 0;	/* internal branches changed */
+
+    while (tree[target].parent != top) {
+	/* top{a{a1, a2}, b} becomes top{a1, a{a2, b}}, which moves the
+	 * attachment point one branch nearer target */
+	for (a = target; tree[a].parent != top; a = tree[a].parent) a1 = a;
+	b = (tree[top].left == a) ? tree[top].right : tree[top].left;
+	a2 = (tree[a].left == a1) ? tree[a].right : tree[a].left;
+	tree[top].left = a1;
+	tree[top].right = a;
+	tree[a1].parent = top;
+	tree[a].left = a2;
+	tree[a].right = b;
+	tree[b].parent = a;
+	scratch_br[cnt++] = a;
+    }
+
+    return cnt;
+
+} /* end reroot_clade() */
+
+void mutate_tbr(Dataptr matrix, Branch *const desttree, const Branch *const sourcetree,
+    long root)
+/* make a copy of the tree sourcetree (of root root) in desttree,
+ * with a random change in topology, the change being caused by tree
+ * bisection and reconnection (TBR) rearrangement: a clade is pruned as
+ * for SPR, re-rooted on a random branch within it and regrafted */
+{
+    long src;				/* branch to move */
+    long dest;				/* destination of branch to move */
+    long target;			/* new attachment point in clade */
+    long cnt = 0;			/* branches in clade */
+    long head = 0;			/* next branch in clade to visit */
+    long changed;			/* internal branches changed */
+    long i;				/* loop counter */
+    Branch *tree;			/* destination tree */
+
+    /* for ease of reading, make alias of desttree, tree */
+    tree = desttree;
+    treecopy(matrix, tree, sourcetree);
+
+    src = random_src(matrix, tree, root);
+    dest = random_dest(matrix, tree, root, src);
+
+    /* find the branches of the clade below src */
+    scratch_init(matrix);
+    if (tree[src].left != UNSET) {
+	scratch_br[cnt++] = tree[src].left;
+	scratch_br[cnt++] = tree[src].right;
+    }
+    while (head < cnt) {
+	i = scratch_br[head++];
+	if (tree[i].left != UNSET) {
+	    scratch_br[cnt++] = tree[i].left;
+	    scratch_br[cnt++] = tree[i].right;
+	}
+    }
+
+    if (cnt == 0) changed = 0;	/* a leaf: TBR is SPR */
+    else {
+	target = scratch_br[randpint(cnt - 1)];
+	changed = reroot_clade(tree, src, target);
+    }
+    spr_move(matrix, tree, root, src, dest);
+
+    /* ensure recalculation of lengths where necessary */
+    for (i = 0; i < changed; i++) make_dirty_below(matrix, tree, scratch_br[i]);
+
+} /* end mutate_tbr() */
+
 long lvb_reroot(Branch *const barray, const long oldroot, const long newroot)
 /* Change the root of the tree in barray from oldroot to newroot, which
  * must not be the same. Mark all internal nodes (everything but the leaves
@@ -359,13 +594,24 @@ long lvb_reroot(Branch *const barray, const long oldroot, const long newroot)
     long previous;		/* previous branch */
     extern Dataptr matrix;	/* data matrix */
     long nbranches = brcnt(matrix->n);		/* branches in tree */
-    static long oldparent[MAX_BRANCHES];	/* element i was old
+    static long *oldparent = NULL;		/* element i was old
 						 * parent of i */
+    static long oldparent_size = 0;		/* elements in oldparent */
+#ifdef _OPENMP
+    #pragma omp threadprivate(oldparent, oldparent_size)
+#endif
 
     /* check new root is a leaf but not the current root */
     lvb_assert(newroot < matrix->n);
     lvb_assert(newroot != oldroot);
 
+    /* "local" static heap memory, one array per thread - do not free! */
+    if (oldparent_size < nbranches) {
+	free(oldparent);
+	oldparent = alloc(nbranches * sizeof(long), "old parents");
+	oldparent_size = nbranches;
+    }
+
     /* create record of parents as they are now */
     for (current = 0; current < nbranches; current++)
 	oldparent[current] = barray[current].parent;
@@ -891,25 +1137,104 @@ long treecmp(Dataptr matrix, const Branch *const tree_1, const long root_1,
     static long prev_m = 0;		/* m on previous call */
     static long prev_n = 0;		/* n on previous call */
     long nsets;				/* elements per set array */
-
-    /* allocate "local" static heap memory - static - do not free! */
-    if (copy_2 == NULL) {
+#ifdef _OPENMP
+    #pragma omp threadprivate(copy_2, prev_m, prev_n)
+#endif
+
+    /* allocate "local" static heap memory - static - do not free! - again
+     * if the matrix has changed size, e.g. for a sector of a larger tree */
+    if ((copy_2 == NULL) || (prev_m != matrix->m) || (prev_n != matrix->n)) {
+		free(copy_2);
 		copy_2 = treealloc(matrix);
 		prev_m = matrix->m;
 		prev_n = matrix->n;
     }
-    lvb_assert((prev_m == matrix->m) && (prev_n == matrix->n));
 
     treecopy(matrix, copy_2, tree_2);
     lvb_assert(root_1 < matrix->n);
     if(root_1 != root_2) lvb_reroot(copy_2, root_2, root_1);
     root_2 = root_1;
-    nsets = makesets(tree_1, root_1, copy_2, root_2);
+    nsets = makesets(matrix, tree_1, root_1, copy_2, root_2);
 
     return setstcmp(sset_1, sset_2, nsets);
 
 } /* end treecmp() */
 
+unsigned long hashmix(unsigned long x)
+/* return a well-mixed function of x (finalizer of the SplitMix64 generator) */
+{
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9UL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebUL;
+    x ^= x >> 31;
+    return x;
+
+} /* end hashmix() */
+
+unsigned long treehash(Dataptr matrix, const Branch *const barray, const long root)
+/* return a hash of the unrooted topology of the tree in barray, of root
+ * root; it is independent of the root and of the order of children, so
+ * trees that treecmp() finds the same have the same hash, and trees with
+ * different hashes are certainly different */
+{
+    static unsigned long *clade = NULL;	/* element i: hash of objs below i */
+    static long *order = NULL;		/* branches in preorder */
+    static long *todo = NULL;		/* stack of branches to visit */
+    static long size = 0;		/* elements in each array */
+    long nbranches = brcnt(matrix->n);	/* branches in tree */
+    long cnt = 0;			/* branches in order */
+    long top = 0;			/* branches in todo */
+    long branch;			/* current branch */
+    long i;				/* loop counter */
+    unsigned long total = 0;		/* hash of all objects */
+    unsigned long split;		/* hash of smaller side of a split */
+    unsigned long hash = 0;		/* return value */
+#ifdef _OPENMP
+    #pragma omp threadprivate(clade, order, todo, size)
+#endif
+
+    /* "local" static heap memory, one set per thread - do not free! */
+    if (size < nbranches) {
+	free(clade);
+	free(order);
+	free(todo);
+	clade = alloc(nbranches * sizeof(unsigned long), "clade hashes");
+	order = alloc(nbranches * sizeof(long), "branch order");
+	todo = alloc(nbranches * sizeof(long), "branch stack");
+	size = nbranches;
+    }
+
+    todo[top++] = root;
+    while (top > 0) {
+	branch = todo[--top];
+	order[cnt++] = branch;
+	if (barray[branch].left != UNSET) {
+	    todo[top++] = barray[branch].left;
+	    todo[top++] = barray[branch].right;
+	}
+    }
+    lvb_assert(cnt == nbranches);
+
+    /* each object has a random key and each clade the sum of its objects'
+     * keys; a split has the same hash whichever side of it is taken, and
+     * the tree hash is a sum over its non-trivial splits */
+    for (i = 0; i < matrix->n; i++) total += hashmix((unsigned long) i + 1UL);
+    for (i = cnt - 1; i > 0; i--) {
+	branch = order[i];
+	if (branch < matrix->n) clade[branch] = hashmix((unsigned long) branch + 1UL);
+	else {
+	    clade[branch] = clade[barray[branch].left] + clade[barray[branch].right];
+	    split = clade[branch];
+	    if (total - split < split) split = total - split;
+	    hash += hashmix(split);
+	}
+    }
+
+    return hash;
+
+} /* end treehash() */
+
 static long setstcmp(Objset *const oset_1, Objset *const oset_2, const long nels)
 /* return 0 if the same sets of objects are in oset_1 and oset_2,
  * and non-zero otherwise */
@@ -995,7 +1320,7 @@ static int osetcmp(const void *oset1, const void *oset2)
 
 } /* end osetcmp() */
 
-static long makesets(const Branch *const tree_1, const long root_1,
+static long makesets(Dataptr matrix, const Branch *const tree_1, const long root_1,
  const Branch *const tree_2, const long root_2)
 /* fill static sset_1 and static sset_2 with arrays of object sets for
  * tree_1 and tree_2 (of root_1 and root_2 respectively), and return
@@ -1003,17 +1328,26 @@ static long makesets(const Branch *const tree_1, const long root_1,
  * the trees must have the same object in the root branch;
  * arrays will be overwritten on subsequent calls */
 {
-    extern Dataptr matrix;		/* data matrix */
     const long nsets = matrix->n - 3;	/* sets per tree */
     const long mssz = matrix->n - 2;	/* maximum objects per set */
+    long i;				/* loop counter */
 
-    if (sset_1[0].set == NULL)	/* first call, allocate memory */
+    if (sset_cnt < nsets)	/* first call or bigger matrix, allocate memory */
     {
+	for (i = 0; i < sset_cnt; i++) {
+	    free(sset_1[i].set);
+	    free(sset_2[i].set);
+	}
+	free(sset_1);
+	free(sset_2);
+	sset_1 = alloc(nsets * sizeof(Objset), "object set array");
+	sset_2 = alloc(nsets * sizeof(Objset), "object set array");
 	ssarralloc(sset_1, nsets, mssz);
 	ssarralloc(sset_2, nsets, mssz);
+	sset_cnt = nsets;
     }
-	fillsets(sset_1, tree_1, root_1);
-	fillsets(sset_2, tree_2, root_2);
+	fillsets(sset_1, tree_1, root_1, matrix->n);
+	fillsets(sset_2, tree_2, root_2, matrix->n);
 	return nsets;
 
 } /* end makesets() */
@@ -1038,62 +1372,62 @@ static void ssarralloc(Objset *nobjset, const long nsets,
 } /* end ssarralloc() */
 
 static void fillsets(Objset *const sstruct, const Branch *const tree,
- const long root)
-/* fill object sets in sstruct with all sets of objects in tree tree,
- * descended from but not including root and not including sets of one
- * object */
+ const long root, const long n)
+/* fill object sets in sstruct with all sets of objects in tree tree of n
+ * objects, descended from but not including root and not including sets
+ * of one object */
 {
-    extern Dataptr matrix;	/* data matrix */
     static long i = UNSET;	/* current set being filled */
+#ifdef _OPENMP
+    #pragma omp threadprivate(i)
+#endif
 
     if (i == UNSET)	/* not a recursive call */
     {
 	i = 0;
 
 	/* avoid generating sets for true root and leaves */
-	if (tree[root].left >= matrix->n)	/* interior */
-	    fillsets(sstruct, tree, tree[root].left);
-	if (tree[root].right >= matrix->n)	/* interior */
-	    fillsets(sstruct, tree, tree[root].right);
+	if (tree[root].left >= n)	/* interior */
+	    fillsets(sstruct, tree, tree[root].left, n);
+	if (tree[root].right >= n)	/* interior */
+	    fillsets(sstruct, tree, tree[root].right, n);
 
 	i = UNSET;	/* clean up for next non-recursive call */
 	return;
     }
     if (tree[root].left != UNSET)	/* not leaf */
     {
-	getobjs(tree, root, sstruct[i].set, &sstruct[i].cnt);
+	getobjs(tree, root, sstruct[i].set, &sstruct[i].cnt, n);
 	i++;
-	fillsets(sstruct, tree, tree[root].left);
-	fillsets(sstruct, tree, tree[root].right);
+	fillsets(sstruct, tree, tree[root].left, n);
+	fillsets(sstruct, tree, tree[root].right, n);
 	return;
     }
 
 } /* end fillsets */
 
 static void getobjs(const Branch *const barray, const long root,
- long *const objarr, long *const cnt)
+ long *const objarr, long *const cnt, const long n)
 /* fill objarr (which must be large enough) with numbers of all objects
- * in the tree in barray in the clade starting at branch root;
+ * in the tree of n objects in barray in the clade starting at branch root;
  * fill the number pointed to by cnt with the number of objects found
  * (i.e. the number of elements written to objarr) */
 {
     *cnt = 0;
-    realgetobjs(barray, root, objarr, cnt);
+    realgetobjs(barray, root, objarr, cnt, n);
 
 } /* end getobjs() */
 
 static void realgetobjs(const Branch *const barray, const long root,
- long *const objarr, long *const cnt)
+ long *const objarr, long *const cnt, const long n)
 /* fill objarr (which must be large enough) with numbers of all objects
- * in the tree in barray in the clade starting at branch root;
+ * in the tree of n objects in barray in the clade starting at branch root;
  * fill the number pointed to by cnt, which must initially be zero,
  * with the number of objects found (i.e. the number of elements
  * written to objarr); this function should not be called from anywhere
  * except getobjs(), which is a safer interface */
 {
-    extern Dataptr matrix;	/* data matrix */
-
-    if (root < matrix->n)
+    if (root < n)
     {
 	objarr[*cnt] = root;
 	++(*cnt);
@@ -1101,9 +1435,9 @@ static void realgetobjs(const Branch *const barray, const long root,
     else
     {
 	if (barray[root].left != UNSET)
-	    realgetobjs(barray, barray[root].left, objarr, cnt);
+	    realgetobjs(barray, barray[root].left, objarr, cnt, n);
 	if (barray[root].right != UNSET)
-	    realgetobjs(barray, barray[root].right, objarr, cnt);
+	    realgetobjs(barray, barray[root].right, objarr, cnt, n);
     }
 
 } /* end realgetobjs() */
@@ -1131,12 +1465,12 @@ void ss_init(Branch *tree, unsigned char **enc_mat, long nbranches, long m)
  *   * no. n in the tree; non-leaf branches in the tree are marked "dirty"; the
  *    * root branch struct is marked "clean" since it is also a terminal */
 {
-    extern Dataptr matrix;      /* data matrix */
+    const long n = (nbranches + 3) / 2;	/* objects, as brcnt(n) == nbranches */
     long i;                     /* loop counter */
 
-    for (i = 0; i < matrix->n; i++)
+    for (i = 0; i < n; i++)
         memcpy(tree[i].sset, enc_mat[i], m);
-    for (i = matrix->n; i < nbranches; i++)
+    for (i = n; i < nbranches; i++)
             tree[i].sset[0] = 0U;
 
 } /* end ss_init() */
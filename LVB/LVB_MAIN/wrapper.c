@@ -18,6 +18,11 @@ wrapper.c - LVB to PHYLIP interface
 
 void read_file(char *file_name, DataStructure *p_lvbmat);
 void phylip_mat_dims_in_external(char *file_name, long *species_ptr, long *sites_ptr);
+void read_file_encoded(char *file_name, DataStructure *p_lvbmat, const unsigned char *lut, char **p_varies);
+int read_matrix_cache(char *cache_name, char *file_name, long options, long max_length,
+    DataStructure *p_lvbmat, long *p_counts, long *p_length_full);
+int write_matrix_cache(char *cache_name, char *file_name, long options, DataStructure *p_lvbmat,
+    const long *p_counts, long length_full);
 
 
 /**********
@@ -33,6 +38,9 @@ void phylip_mat_dims_in_external(char *file_name, long *species_ptr, long *sites
 Read a DNA data matrix in PHYLIP 3.6 format from file. The file name is
 given by the macro MATFNAM in F<lvb.h>.
 
+The file is parsed once, and the numbers of sequences and sites are set
+in the matrix, so C<phylip_mat_dims_in()> need not be called first.
+
 =head2 PARAMETERS
 
 =head3 INPUT
@@ -70,6 +78,268 @@ void phylip_dna_matrin(char *p_file_name, Dataptr lvbmat)
 
 /**********
 
+=head1 phylip_dna_matrin_encoded - READ DNA DATA MATRIX AS STATESETS
+
+=head2 SYNOPSIS
+
+    Lvb_bool *phylip_dna_matrin_encoded(char *p_file_name, Lvb_bool fifthstate,
+    Dataptr lvbmat);
+
+=head2 DESCRIPTION
+
+As C<phylip_dna_matrin()>, but each row holds the binary-encoded
+statesets given by C<dna_lut()>, not text, so that it may be used
+directly as a row of the encoded matrix. For FASTA and PHYLIP files, the
+encoding is done by the reader as the residues are read, without a text
+copy of the matrix, and the constant columns are found in the same pass.
+
+Crashes with a message if the matrix contains a character that is not
+a valid base, ambiguity code, C<?>, C<O> or C<->.
+
+=head2 PARAMETERS
+
+=head3 INPUT
+
+=over 4
+
+=item p_file_name
+
+Name of the file holding the matrix.
+
+=item fifthstate
+
+If C<LVB_TRUE>, treat gaps indicated by C<-> as identical to C<O>. Otherwise,
+treat gaps indicated by C<-> as identical to <?>, i.e., totally ambiguous.
+
+=back
+
+=head3 OUTPUT
+
+=over 4
+
+=item lvbmat
+
+The matrix read. Its rows are C<'\0'>-terminated, since no stateset is
+empty.
+
+=back
+
+=head2 RETURN
+
+Returns a new array of C<lvbmat>C<->E<gt>C<m> elements, C<LVB_TRUE>
+where all rows have the same stateset in that column, for
+C<matchange()>. It should be freed with C<free()>.
+
+=cut
+
+**********/
+
+Lvb_bool *phylip_dna_matrin_encoded(char *p_file_name, Lvb_bool fifthstate,
+    Dataptr lvbmat)
+{
+    unsigned char lut[256];	/* stateset for each character */
+    char *varies;		/* nonzero where column is not constant */
+    Lvb_bool *isconst;		/* return value */
+    long k;			/* loop counter */
+
+    dna_lut(lut, fifthstate);
+    read_file_encoded(p_file_name, lvbmat, lut, &varies);
+
+    /* check number of sequences is in range for LVB */
+    if (lvbmat->n < MIN_N) crash("The data matrix must have at least %ld sequences.", MIN_N);
+    else if (lvbmat->n > MAX_N) crash("The data matrix must have no more than %ld sequences.", MAX_N);
+    /* check number of sites is in range for LVB */
+    else if (lvbmat->m < MIN_M) crash("The data matrix must have at least %ld sites.", MIN_M);
+    else if (lvbmat->m > MAX_M) crash("The data matrix must have no more than %ld sites.", MAX_M);
+
+    isconst = alloc(lvbmat->m * sizeof(Lvb_bool), "constant columns");
+    for (k = 0; k < lvbmat->m; k++)
+	isconst[k] = (varies[k] == 0) ? LVB_TRUE : LVB_FALSE;
+    free(varies);
+
+    return isconst;
+
+} /* end phylip_dna_matrin_encoded() */
+
+static char *cache_name(const Params rcstruct)
+/* return a new string holding the name of the matrix cache for the data
+ * file named in rcstruct, or NULL if there is to be no cache for it; the
+ * string should be freed with free() */
+{
+    FILE *fp;		/* data file */
+    long size = -1L;	/* bytes in data file */
+    char *p_name;	/* return value */
+
+    if (rcstruct.matrix_cache == LVB_FALSE)
+	return NULL;
+    fp = fopen(rcstruct.p_file_name, "rb");
+    if (fp == NULL)
+	return NULL;
+    if (fseek(fp, 0L, SEEK_END) == 0)
+	size = ftell(fp);
+    fclose(fp);
+    if (size < MATRIX_CACHE_MIN_SIZE)
+	return NULL;
+
+    p_name = alloc(strlen(rcstruct.p_file_name) + strlen(MATRIX_CACHE_SUFFIX) + 1,
+     "cache file name");
+    sprintf(p_name, "%s%s", rcstruct.p_file_name, MATRIX_CACHE_SUFFIX);
+    return p_name;
+
+} /* end cache_name() */
+
+static long cache_options(const Params rcstruct)
+/* return the options in rcstruct that change the matrix, as a number */
+{
+    return ((rcstruct.fifthstate == LVB_TRUE) ? 1L : 0L)
+     + ((rcstruct.site_patterns == LVB_TRUE) ? 2L : 0L);
+
+} /* end cache_options() */
+
+/**********
+
+=head1 matrix_cache_load - READ DATA MATRIX FROM CACHE
+
+=head2 SYNOPSIS
+
+    Lvb_bool matrix_cache_load(const Params rcstruct, Dataptr lvbmat,
+    long *counts, long *m_full);
+
+=head2 DESCRIPTION
+
+Read the data matrix, ready for the search, from the cache written by
+C<matrix_cache_save()> for the file named in C<rcstruct>, if there is one
+made from the file as it is now and with the same options. The cache is
+named after the data file, with the suffix C<MATRIX_CACHE_SUFFIX>, and is
+only used for files of at least C<MATRIX_CACHE_MIN_SIZE> bytes when
+C<rcstruct.matrix_cache> is C<LVB_TRUE>.
+
+=head2 PARAMETERS
+
+=head3 INPUT
+
+=over 4
+
+=item rcstruct
+
+Configurable parameters, giving the data file and the options used with
+it.
+
+=back
+
+=head3 OUTPUT
+
+=over 4
+
+=item lvbmat
+
+If the cache is used, the matrix, with its rows encoded as by
+C<phylip_dna_matrin_encoded()>, constant columns removed by
+C<matchange()> and, if C<rcstruct.site_patterns> is C<LVB_TRUE>,
+identical columns merged by C<merge_patterns()>.
+
+=item counts
+
+If the cache is used, its first C<lvbmat>C<->E<gt>C<m> elements are set
+to the number of original columns each column stands for. It must have
+room for C<MAX_M> elements.
+
+=item m_full
+
+If the cache is used, *C<m_full> is set to the number of columns in the
+data file.
+
+=back
+
+=head2 RETURN
+
+Returns C<LVB_TRUE> if the matrix was read from the cache, C<LVB_FALSE>
+otherwise, in which case C<lvbmat> is unchanged.
+
+=cut
+
+**********/
+
+Lvb_bool matrix_cache_load(const Params rcstruct, Dataptr lvbmat, long *counts,
+    long *m_full)
+{
+    char *p_name;		/* name of cache */
+    Lvb_bool val = LVB_FALSE;	/* return value */
+
+    p_name = cache_name(rcstruct);
+    if (p_name != NULL)
+    {
+	if (read_matrix_cache(p_name, rcstruct.p_file_name, cache_options(rcstruct),
+	 MAX_M, lvbmat, counts, m_full) == 1)
+	    val = LVB_TRUE;
+	free(p_name);
+    }
+    return val;
+
+} /* end matrix_cache_load() */
+
+/**********
+
+=head1 matrix_cache_save - WRITE DATA MATRIX TO CACHE
+
+=head2 SYNOPSIS
+
+    void matrix_cache_save(const Params rcstruct, Dataptr lvbmat,
+    const long *counts, long m_full);
+
+=head2 DESCRIPTION
+
+Write the data matrix, ready for the search, to the cache read by
+C<matrix_cache_load()>, with a checksum of the data file, if the file is
+large enough to be worth it. Failure to write the cache is not an error,
+since it only means the next run on the same file reads the file again.
+
+=head2 PARAMETERS
+
+=head3 INPUT
+
+=over 4
+
+=item rcstruct
+
+Configurable parameters, giving the data file and the options used with
+it.
+
+=item lvbmat
+
+The matrix, as for the output of C<matrix_cache_load()>.
+
+=item counts
+
+Number of original columns each column of C<lvbmat> stands for.
+
+=item m_full
+
+Number of columns in the data file.
+
+=back
+
+=cut
+
+**********/
+
+void matrix_cache_save(const Params rcstruct, Dataptr lvbmat, const long *counts,
+    long m_full)
+{
+    char *p_name;	/* name of cache */
+
+    p_name = cache_name(rcstruct);
+    if (p_name != NULL)
+    {
+	write_matrix_cache(p_name, rcstruct.p_file_name, cache_options(rcstruct),
+	 lvbmat, counts, m_full);
+	free(p_name);
+    }
+
+} /* end matrix_cache_save() */
+
+/**********
+
 =head1 phylip_mat_dims_in - READ PHYLIP MATRIX DIMENSIONS
 
 =head2 SYNOPSIS